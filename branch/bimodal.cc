@@ -1,9 +1,12 @@
-#include "ooo_cpu.h"
+#define BRANCH_PREDICTOR bimodal
+#include "module.h"
 
 #define BIMODAL_TABLE_SIZE 16384
 #define BIMODAL_PRIME 16381
 #define MAX_COUNTER 3
+namespace {
 int bimodal_table[NUM_CPUS][BIMODAL_TABLE_SIZE];
+}
 
 void O3_CPU::initialize_branch_predictor()
 {
@@ -1,12 +1,15 @@
-#include "ooo_cpu.h"
+#define BRANCH_PREDICTOR gshare
+#include "module.h"
 
 #define GLOBAL_HISTORY_LENGTH 14
 #define GLOBAL_HISTORY_MASK (1 << GLOBAL_HISTORY_LENGTH) - 1
+namespace {
 int branch_history_vector[NUM_CPUS];
 
 #define GS_HISTORY_TABLE_SIZE 16384
 int gs_history_table[NUM_CPUS][GS_HISTORY_TABLE_SIZE];
 int my_last_prediction[NUM_CPUS];
+}
 
 void O3_CPU::initialize_branch_predictor()
 {
@@ -19,6 +22,7 @@ void O3_CPU::initialize_branch_predictor()
         gs_history_table[cpu][i] = 2; // 2 is slightly taken
 }
 
+namespace {
 unsigned int gs_table_hash(uint64_t ip, int bh_vector)
 {
     unsigned int hash = ip^(ip>>GLOBAL_HISTORY_LENGTH)^(ip>>(GLOBAL_HISTORY_LENGTH*2))^bh_vector;
@@ -28,6 +32,7 @@ unsigned int gs_table_hash(uint64_t ip, int bh_vector)
 
     return hash;
 }
+}
 
 uint8_t O3_CPU::predict_branch(uint64_t ip)
 {
@@ -52,8 +52,10 @@ sources for you to plagiarize.
 #include <math.h>
 #include <stdlib.h>
 
-#include "ooo_cpu.h"
+#define BRANCH_PREDICTOR hashed_perceptron
+#include "module.h"
 
+namespace {
 // this many tables
 
 #define NTABLES	16
@@ -104,6 +106,7 @@ int
 
 // perceptron sum
 	yout[NUM_CPUS];
+}
 
 void O3_CPU::initialize_branch_predictor () {
 	// zero out the weights tables
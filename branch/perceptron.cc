@@ -55,7 +55,8 @@
  * was taken, 0 otherwise.
  */
 
-#include "ooo_cpu.h"
+#define BRANCH_PREDICTOR perceptron
+#include "module.h"
 
 /* history length for the global history shift register */
 
@@ -82,6 +83,7 @@
 
 #define NUM_UPDATE_ENTRIES	100
 
+namespace {
 /* perceptron data structure */
 
 typedef struct {
@@ -157,6 +159,7 @@ void initialize_perceptron (perceptron *p) {
 
     for (i=0; i<=PERCEPTRON_HISTORY; i++) p->weights[i] = 0;
 }
+}
 
 void O3_CPU::initialize_branch_predictor()
 {
@@ -1,19 +1,27 @@
 #!/bin/bash
 
-if [ "$#" -ne 7 ]; then
+if [ "$#" -ne 7 ] && [ "$#" -ne 1 ]; then
     echo "Illegal number of parameters"
-    echo "Usage: ./build_champsim.sh [branch_pred] [l1d_pref] [l2c_pref] [llc_pref] [llc_repl] [num_core]"
+    echo "Usage: ./build_champsim.sh [num_core]"
+    echo "       ./build_champsim.sh [branch_pred] [l1i_pref] [l1d_pref] [l2c_pref] [llc_pref] [llc_repl] [num_core]"
     exit 1
 fi
 
-# ChampSim configuration
-BRANCH=$1           # branch/*.bpred
-L1I_PREFETCHER=$2   # prefetcher/*.l1i_pref
-L1D_PREFETCHER=$3   # prefetcher/*.l1d_pref
-L2C_PREFETCHER=$4   # prefetcher/*.l2c_pref
-LLC_PREFETCHER=$5   # prefetcher/*.llc_pref
-LLC_REPLACEMENT=$6  # replacement/*.llc_repl
-NUM_CORE=$7         # tested up to 8-core system
+# Every branch predictor, prefetcher and replacement policy is linked into one binary per core count
+# and picked at run time with -branch_predictor, -l1i_prefetcher, -l1d_prefetcher, -l2c_prefetcher,
+# -llc_prefetcher and -llc_replacement (see inc/module_list.h). Given a full configuration, this script
+# only adds a launcher named after it, so existing run scripts keep working without a rebuild per config.
+if [ "$#" -eq 1 ]; then
+    NUM_CORE=$1
+else
+    BRANCH=$1           # branch/*.cc
+    L1I_PREFETCHER=$2   # prefetcher/l1i/*.cc
+    L1D_PREFETCHER=$3   # prefetcher/l1d/*.cc
+    L2C_PREFETCHER=$4   # prefetcher/l2c/*.cc
+    LLC_PREFETCHER=$5   # prefetcher/llc/*.cc
+    LLC_REPLACEMENT=$6  # replacement/*.cc
+    NUM_CORE=$7         # tested up to 8-core system
+fi
 
 ############## Some useful macros ###############
 BOLD=$(tput bold)
@@ -21,46 +29,48 @@ NORMAL=$(tput sgr0)
 #################################################
 
 # Sanity check
-if [ ! -f ./branch/${BRANCH}.bpred ]; then
-    echo "[ERROR] Cannot find branch predictor"
-	echo "[ERROR] Possible branch predictors from branch/*.bpred "
-    find branch -name "*.bpred"
-    exit 1
-fi
+if [ "$#" -eq 7 ]; then
+    if [ ! -f ./branch/${BRANCH}.cc ]; then
+        echo "[ERROR] Cannot find branch predictor"
+        echo "[ERROR] Possible branch predictors from branch/*.cc "
+        find branch -name "*.cc"
+        exit 1
+    fi
 
-if [ ! -f ./prefetcher/${L1I_PREFETCHER}.l1i_pref ]; then
-    echo "[ERROR] Cannot find L1I prefetcher"
-	echo "[ERROR] Possible L1I prefetchers from prefetcher/*.l1i_pref "
-    find prefetcher -name "*.l1i_pref"
-    exit 1
-fi
+    if [ ! -f ./prefetcher/l1i/${L1I_PREFETCHER}.cc ]; then
+        echo "[ERROR] Cannot find L1I prefetcher"
+        echo "[ERROR] Possible L1I prefetchers from prefetcher/l1i/*.cc "
+        find prefetcher/l1i -name "*.cc"
+        exit 1
+    fi
 
-if [ ! -f ./prefetcher/${L1D_PREFETCHER}.l1d_pref ]; then
-    echo "[ERROR] Cannot find L1D prefetcher"
-	echo "[ERROR] Possible L1D prefetchers from prefetcher/*.l1d_pref "
-    find prefetcher -name "*.l1d_pref"
-    exit 1
-fi
+    if [ ! -f ./prefetcher/l1d/${L1D_PREFETCHER}.cc ]; then
+        echo "[ERROR] Cannot find L1D prefetcher"
+        echo "[ERROR] Possible L1D prefetchers from prefetcher/l1d/*.cc "
+        find prefetcher/l1d -name "*.cc"
+        exit 1
+    fi
 
-if [ ! -f ./prefetcher/${L2C_PREFETCHER}.l2c_pref ]; then
-    echo "[ERROR] Cannot find L2C prefetcher"
-	echo "[ERROR] Possible L2C prefetchers from prefetcher/*.l2c_pref "
-    find prefetcher -name "*.l2c_pref"
-    exit 1
-fi
+    if [ ! -f ./prefetcher/l2c/${L2C_PREFETCHER}.cc ]; then
+        echo "[ERROR] Cannot find L2C prefetcher"
+        echo "[ERROR] Possible L2C prefetchers from prefetcher/l2c/*.cc "
+        find prefetcher/l2c -name "*.cc"
+        exit 1
+    fi
 
-if [ ! -f ./prefetcher/${LLC_PREFETCHER}.llc_pref ]; then
-    echo "[ERROR] Cannot find LLC prefetcher"
-	echo "[ERROR] Possible LLC prefetchers from prefetcher/*.llc_pref "
-    find prefetcher -name "*.llc_pref"
-    exit 1
-fi
+    if [ ! -f ./prefetcher/llc/${LLC_PREFETCHER}.cc ]; then
+        echo "[ERROR] Cannot find LLC prefetcher"
+        echo "[ERROR] Possible LLC prefetchers from prefetcher/llc/*.cc "
+        find prefetcher/llc -name "*.cc"
+        exit 1
+    fi
 
-if [ ! -f ./replacement/${LLC_REPLACEMENT}.llc_repl ]; then
-    echo "[ERROR] Cannot find LLC replacement policy"
-	echo "[ERROR] Possible LLC replacement policy from replacement/*.llc_repl"
-    find replacement -name "*.llc_repl"
-    exit 1
+    if [ ! -f ./replacement/${LLC_REPLACEMENT}.cc ]; then
+        echo "[ERROR] Cannot find LLC replacement policy"
+        echo "[ERROR] Possible LLC replacement policy from replacement/*.cc"
+        find replacement -name "*.cc"
+        exit 1
+    fi
 fi
 
 # Check num_core
@@ -70,45 +80,56 @@ if ! [[ $NUM_CORE =~ $re ]] ; then
     exit 1
 fi
 
-# Check for multi-core
-if [ "$NUM_CORE" -gt "1" ]; then
-    echo "Building multi-core ChampSim..."
-    sed -i.bak 's/\<NUM_CPUS 1\>/NUM_CPUS '${NUM_CORE}'/g' inc/champsim.h
-#	sed -i.bak 's/\<DRAM_CHANNELS 1\>/DRAM_CHANNELS 2/g' inc/champsim.h
-#	sed -i.bak 's/\<DRAM_CHANNELS_LOG2 0\>/DRAM_CHANNELS_LOG2 1/g' inc/champsim.h
-else
-    if [ "$NUM_CORE" -lt "1" ]; then
-        echo "Number of core: $NUM_CORE must be greater or equal than 1"
-        exit 1
+if [ "$NUM_CORE" -lt "1" ]; then
+    echo "Number of core: $NUM_CORE must be greater or equal than 1"
+    exit 1
+fi
+
+CORE_BINARY="champsim-${NUM_CORE}core"
+
+# Build the binary for this core count, only once when a configuration is given
+if [ "$#" -eq 1 ] || [ ! -f bin/${CORE_BINARY} ]; then
+    if [ "$NUM_CORE" -gt "1" ]; then
+        echo "Building multi-core ChampSim..."
+        sed -i.bak 's/\<NUM_CPUS 1\>/NUM_CPUS '${NUM_CORE}'/g' inc/champsim.h
     else
         echo "Building single-core ChampSim..."
     fi
-fi
-echo
-
-# Change prefetchers and replacement policy
-cp branch/${BRANCH}.bpred branch/branch_predictor.cc
-cp prefetcher/${L1I_PREFETCHER}.l1i_pref prefetcher/l1i_prefetcher.cc
-cp prefetcher/${L1D_PREFETCHER}.l1d_pref prefetcher/l1d_prefetcher.cc
-cp prefetcher/${L2C_PREFETCHER}.l2c_pref prefetcher/l2c_prefetcher.cc
-cp prefetcher/${LLC_PREFETCHER}.llc_pref prefetcher/llc_prefetcher.cc
-cp replacement/${LLC_REPLACEMENT}.llc_repl replacement/llc_replacement.cc
-
-# Build
-mkdir -p bin
-rm -f bin/champsim
-make clean
-make
+    echo
 
-# Sanity check
-echo ""
-if [ ! -f bin/champsim ]; then
-    echo "${BOLD}ChampSim build FAILED!"
+    mkdir -p bin
+    rm -f bin/champsim
+    make clean
+    make
+
+    # Restore to the default configuration
+    sed -i.bak 's/\<NUM_CPUS '${NUM_CORE}'\>/NUM_CPUS 1/g' inc/champsim.h
+
+    # Sanity check
     echo ""
-    exit 1
+    if [ ! -f bin/champsim ]; then
+        echo "${BOLD}ChampSim build FAILED!"
+        echo ""
+        exit 1
+    fi
+
+    mv bin/champsim bin/${CORE_BINARY}
+    echo "${BOLD}ChampSim is successfully built${NORMAL}"
+    echo "Cores: ${NUM_CORE}"
+    echo "Binary: bin/${CORE_BINARY}"
+    echo ""
+fi
+
+if [ "$#" -eq 1 ]; then
+    exit 0
 fi
 
-echo "${BOLD}ChampSim is successfully built"
+BINARY_NAME="${BRANCH}-${L1I_PREFETCHER}-${L1D_PREFETCHER}-${L2C_PREFETCHER}-${LLC_PREFETCHER}-${LLC_REPLACEMENT}-${NUM_CORE}core"
+echo '#!/bin/bash' > bin/${BINARY_NAME}
+echo 'exec "$(dirname "$0")/'${CORE_BINARY}'" -branch_predictor '${BRANCH}' -l1i_prefetcher '${L1I_PREFETCHER}' -l1d_prefetcher '${L1D_PREFETCHER}' -l2c_prefetcher '${L2C_PREFETCHER}' -llc_prefetcher '${LLC_PREFETCHER}' -llc_replacement '${LLC_REPLACEMENT}' "$@"' >> bin/${BINARY_NAME}
+chmod +x bin/${BINARY_NAME}
+
+echo "${BOLD}ChampSim configuration${NORMAL}"
 echo "Branch Predictor: ${BRANCH}"
 echo "L1I Prefetcher: ${L1I_PREFETCHER}"
 echo "L1D Prefetcher: ${L1D_PREFETCHER}"
@@ -116,20 +137,5 @@ echo "L2C Prefetcher: ${L2C_PREFETCHER}"
 echo "LLC Prefetcher: ${LLC_PREFETCHER}"
 echo "LLC Replacement: ${LLC_REPLACEMENT}"
 echo "Cores: ${NUM_CORE}"
-BINARY_NAME="${BRANCH}-${L1I_PREFETCHER}-${L1D_PREFETCHER}-${L2C_PREFETCHER}-${LLC_PREFETCHER}-${LLC_REPLACEMENT}-${NUM_CORE}core"
-echo "Binary: bin/${BINARY_NAME}"
+echo "Binary: bin/${BINARY_NAME} (runs bin/${CORE_BINARY})"
 echo ""
-mv bin/champsim bin/${BINARY_NAME}
-
-
-# Restore to the default configuration
-sed -i.bak 's/\<NUM_CPUS '${NUM_CORE}'\>/NUM_CPUS 1/g' inc/champsim.h
-#sed -i.bak 's/\<DRAM_CHANNELS 2\>/DRAM_CHANNELS 1/g' inc/champsim.h
-#sed -i.bak 's/\<DRAM_CHANNELS_LOG2 1\>/DRAM_CHANNELS_LOG2 0/g' inc/champsim.h
-
-cp branch/bimodal.bpred branch/branch_predictor.cc
-cp prefetcher/no.l1i_pref prefetcher/l1i_prefetcher.cc
-cp prefetcher/no.l1d_pref prefetcher/l1d_prefetcher.cc
-cp prefetcher/no.l2c_pref prefetcher/l2c_prefetcher.cc
-cp prefetcher/no.llc_pref prefetcher/llc_prefetcher.cc
-cp replacement/lru.llc_repl replacement/llc_replacement.cc
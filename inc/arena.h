@@ -0,0 +1,74 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "champsim.h"
+
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#define ARENA_HUGE_PAGE (2 << 20)          // regions are aligned to and sized in huge pages
+#define ARENA_REGION_SIZE (4*ARENA_HUGE_PAGE) // a core's buffers, queues and private caches fit in one region
+#define ARENA_ALIGN 64                     // every array starts on its own cache line
+
+class ARENA_DESTRUCTOR {
+public:
+    void (*destroy)(void *base, size_t count);
+    void *base;
+    size_t count;
+
+    ARENA_DESTRUCTOR(void (*v1)(void *, size_t), void *v2, size_t v3) : destroy(v1), base(v2), count(v3) {};
+};
+
+// ARENA
+// bump allocator over anonymous, huge page backed regions, one arena per core and one for the uncore
+// arrays are constructed in place and only go away with the arena, which destroys them in reverse
+// order of allocation and unmaps its regions, so an owner that declares its arena first tears it down last
+class ARENA {
+public:
+    vector<char *> region;
+    vector<size_t> region_size;
+    vector<ARENA_DESTRUCTOR> destructor;
+    char *next, *end;
+    int node; // memory node the regions are bound to, -1 until bind_local()
+
+    ARENA() {
+        next = NULL;
+        end = NULL;
+        node = -1;
+    };
+
+    ARENA(const ARENA &) = delete;
+    ARENA &operator=(const ARENA &) = delete;
+
+    // destructor
+    ~ARENA() {
+        release();
+    };
+
+    template <class T> static void destroy_array(void *base, size_t count) {
+        for (size_t i=count; i>0; i--)
+            ((T *)base)[i-1].~T();
+    };
+
+    // count default constructed elements, never freed on their own
+    template <class T> T *allocate(size_t count) {
+        T *array = (T *)reserve(count * sizeof(T));
+        for (size_t i=0; i<count; i++)
+            new (&array[i]) T();
+
+        if (!is_trivially_destructible<T>::value)
+            destructor.push_back(ARENA_DESTRUCTOR(&destroy_array<T>, array, count));
+
+        return array;
+    };
+
+    // functions
+    void *reserve(size_t bytes);
+    void map_region(size_t bytes),
+         bind_region(uint32_t index),
+         bind_local(),
+         release();
+};
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "champsim.h"
+
+#include <vector>
+#include <atomic>
+
+// BATCH DRIVER
+// runs every job of a manifest in one invocation: champsim -batch <manifest> [-jobs N] [-batch_output dir]
+// each manifest line is "<job name> <champsim options> -traces <trace> ...", '#' starts a comment
+// a pool of worker processes, one per host core by default, works through the jobs; every worker starts
+// with a contiguous slice of the manifest and steals from the back of the other slices once its own runs dry
+// workers fork a fresh simulation for every job, so each job gets its own ooo_cpu[], uncore and page table
+// from the pristine image and none of the global state leaks from one job into the next
+// a job writes its console output to <dir>/<name>.txt and its results to <dir>/<name>.json
+#define BATCH_DEFAULT_OUTPUT "batch_results"
+
+class BATCH_JOB {
+public:
+    string name;
+    vector<string> args;
+};
+
+// slice of the job list owned by one worker, packed as (head << 32) | tail so that
+// the owner and the thieves claim jobs with a single compare-and-swap
+class BATCH_DEQUE {
+public:
+    atomic<uint64_t> range;
+
+    // functions
+    void assign(uint32_t head, uint32_t tail);
+    int pop_front(),  // owner, returns -1 when the slice is empty
+        steal_back(); // thief, returns -1 when the slice is empty
+};
+
+class BATCH_DRIVER {
+public:
+    vector<BATCH_JOB> jobs;
+    string output_dir;
+    uint32_t num_workers;
+
+    // shared with the worker processes
+    BATCH_DEQUE *deque;
+    atomic<uint32_t> *num_failed;
+
+    // job handed to this process when it returns from run() as a simulation child
+    vector<char *> job_argv;
+    string job_name, result_path;
+
+    BATCH_DRIVER() {
+        output_dir = BATCH_DEFAULT_OUTPUT;
+        num_workers = 0;
+        deque = NULL;
+        num_failed = NULL;
+    };
+
+    // functions
+    void parse_manifest(const char *manifest),
+         write_failure(const BATCH_JOB &job, int status);
+
+    // worker_loop() and run_job() return 1 in a freshly forked simulation child, 0 in the worker
+    int next_job(uint32_t worker),
+        worker_loop(uint32_t worker, char *program),
+        run_job(uint32_t index, char *program);
+
+    // returns 1 in the child that must go on to simulate job_argv, 0 in the driver once every job is done
+    int run(int argc, char **argv);
+};
+
+extern BATCH_DRIVER batch;
+
+void write_batch_result(const char *path);
+
+#endif
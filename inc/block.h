@@ -2,6 +2,7 @@
 #define BLOCK_H
 
 #include "champsim.h"
+#include "arena.h"
 #include "instruction.h"
 #include "set.h"
 
@@ -61,6 +62,109 @@ public:
     };
 };
 
+// merged requests and kpcp metadata of a packet
+// only misses that other requests merged into and kpcp prefetches have one, so it lives out of line in a
+// per-core DEPENDS_POOL and PACKET carries a DEPENDS_REF to it
+class PACKET_DEPENDS {
+public:
+    fastset
+        rob_index_depend_on_me,
+        lq_index_depend_on_me,
+        sq_index_depend_on_me;
+
+    int delta,
+        depth,
+        signature,
+        confidence;
+
+    PACKET_DEPENDS() {
+        delta = 0;
+        depth = 0;
+        signature = 0;
+        confidence = 0;
+    };
+};
+
+#define DEPENDS_POOL_CHUNK 256 // records per allocation, records never move once handed out
+#define DEPENDS_SLOT_BITS 24   // a handle is (pool << DEPENDS_SLOT_BITS) | (slot + 1), 0 is no record
+
+// one pool per core, a packet's record comes from the pool of packet->cpu, which only that core's
+// thread (or the main thread while the cores are parked) ever touches
+class DEPENDS_POOL {
+public:
+    vector<PACKET_DEPENDS *> chunk;
+    vector<uint32_t> free_slot;
+
+    PACKET_DEPENDS *get(uint32_t slot) {
+        return &chunk[slot / DEPENDS_POOL_CHUNK][slot % DEPENDS_POOL_CHUNK];
+    };
+
+    // functions
+    uint32_t allocate();
+    void release(uint32_t slot);
+};
+
+extern DEPENDS_POOL *depends_pool;
+extern const PACKET_DEPENDS no_depends;
+
+// owning handle to a PACKET_DEPENDS, copying a packet copies its record so packets keep value semantics
+// packets without a record copy, move and reset without touching a pool
+class DEPENDS_REF {
+public:
+    uint32_t handle;
+
+    DEPENDS_REF() {
+        handle = 0;
+    };
+
+    DEPENDS_REF(const DEPENDS_REF &other) {
+        handle = 0;
+        if (other.handle)
+            copy(other);
+    };
+
+    DEPENDS_REF(DEPENDS_REF &&other) {
+        handle = other.handle;
+        other.handle = 0;
+    };
+
+    ~DEPENDS_REF() {
+        if (handle)
+            release();
+    };
+
+    DEPENDS_REF &operator=(const DEPENDS_REF &other) {
+        if (other.handle) {
+            if (this != &other)
+                copy(other);
+        }
+        else if (handle)
+            release();
+
+        return *this;
+    };
+
+    DEPENDS_REF &operator=(DEPENDS_REF &&other) {
+        if (this != &other) {
+            if (handle)
+                release();
+            handle = other.handle;
+            other.handle = 0;
+        }
+
+        return *this;
+    };
+
+    PACKET_DEPENDS *get() const {
+        return depends_pool[handle >> DEPENDS_SLOT_BITS].get((handle & ((1 << DEPENDS_SLOT_BITS) - 1)) - 1);
+    };
+
+    // functions
+    void allocate(uint32_t pool),
+         copy(const DEPENDS_REF &other),
+         release();
+};
+
 // message packet
 class PACKET {
 public:
@@ -73,24 +177,6 @@ public:
         translated,
         fetched,
         prefetched,
-        drc_tag_read;
-
-    int fill_level,
-        pf_origin_level,
-        rob_signal,
-        rob_index,
-        producer,
-        delta,
-        depth,
-        signature,
-        confidence;
-
-    uint32_t pf_metadata;
-
-    uint8_t  is_producer,
-        //rob_index_depend_on_me[ROB_SIZE], 
-        //lq_index_depend_on_me[ROB_SIZE], 
-        //sq_index_depend_on_me[ROB_SIZE], 
         instr_merged,
         load_merged,
         store_merged,
@@ -98,13 +184,18 @@ public:
         asid[2],
         type;
 
-    fastset
-        rob_index_depend_on_me,
-        lq_index_depend_on_me,
-        sq_index_depend_on_me;
+    int fill_level,
+        pf_origin_level,
+        rob_signal,
+        rob_index,
+        producer;
+
+    uint32_t pf_metadata;
 
     uint32_t cpu, data_index, lq_index, sq_index;
 
+    DEPENDS_REF depends_ref;
+
     uint64_t address,
         full_addr,
         instruction_pa,
@@ -125,7 +216,6 @@ public:
         translated = 0;
         fetched = 0;
         prefetched = 0;
-        drc_tag_read = 0;
 
         returned = 0;
         asid[0] = UINT8_MAX;
@@ -133,22 +223,13 @@ public:
         type = 0;
 
         fill_level = -1;
+        pf_origin_level = 0;
         rob_signal = -1;
         rob_index = -1;
         producer = -1;
-        delta = 0;
-        depth = 0;
-        signature = 0;
-        confidence = 0;
 
-        #if 0
-        for (uint32_t i=0; i<ROB_SIZE; i++) {
-            rob_index_depend_on_me[i] = 0;
-            lq_index_depend_on_me[i] = 0;
-            sq_index_depend_on_me[i] = 0;
-        }
-        #endif
-        is_producer = 0;
+        pf_metadata = 0;
+
         instr_merged = 0;
         load_merged = 0;
         store_merged = 0;
@@ -161,20 +242,42 @@ public:
         address = 0;
         full_addr = 0;
         instruction_pa = 0;
+        data_pa = 0;
         data = 0;
         instr_id = 0;
         ip = 0;
         event_cycle = UINT64_MAX;
         cycle_enqueued = 0;
     };
+
+    // read only view, an empty record if nothing was merged into this packet
+    const PACKET_DEPENDS &depends() const {
+        return depends_ref.handle ? *depends_ref.get() : no_depends;
+    };
+
+    // this packet's own record, allocated from its core's pool on first use
+    PACKET_DEPENDS &edit_depends() {
+        if (depends_ref.handle == 0)
+            depends_ref.allocate((cpu < NUM_CPUS) ? cpu : 0);
+        return *depends_ref.get();
+    };
 };
 
 // packet queue
+// how PACKET_QUEUE::check_queue finds a matching packet
+#define QUEUE_UNINDEXED 0     // linear scan on address
+#define QUEUE_MATCH_ADDRESS 1 // hash index on address (cache line)
+#define QUEUE_MATCH_FULL_ADDR 2 // hash index on full_addr (byte address), used by the L1D write queue
+
 class PACKET_QUEUE {
 public:
     string NAME;
     uint32_t SIZE;
 
+    // address index over the occupied entries, open addressing with linear probing
+    uint8_t match_mode;
+    uint32_t *index_table, index_mask, index_shift;
+
     uint8_t  is_RQ,
         is_WQ,
         write_mode;
@@ -202,38 +305,22 @@ public:
     PACKET *entry, processed_packet[2*MAX_READ_PER_CYCLE];
 
     // constructor
-    PACKET_QUEUE(string v1, uint32_t v2) : NAME(v1), SIZE(v2) {
-        is_RQ = 0;
-        is_WQ = 0;
-        write_mode = 0;
-
-        cpu = 0;
-        head = 0;
-        tail = 0;
-        occupancy = 0;
-        num_returned = 0;
-        next_fill_index = 0;
-        next_schedule_index = 0;
-        next_process_index = 0;
-
-        next_fill_cycle = UINT64_MAX;
-        next_schedule_cycle = UINT64_MAX;
-        next_process_cycle = UINT64_MAX;
-
-        ACCESS = 0;
-        FORWARD = 0;
-        MERGED = 0;
-        TO_CACHE = 0;
-        ROW_BUFFER_HIT = 0;
-        ROW_BUFFER_MISS = 0;
-        FULL = 0;
-
-        entry = new PACKET[SIZE];
+    PACKET_QUEUE(string v1, uint32_t v2, uint8_t v3, ARENA &v4) : NAME(v1), SIZE(v2), match_mode(v3) {
+        initialize();
+        allocate(v4);
     };
 
+    // an empty queue, NAME and SIZE are set and allocate() called by an owner that builds queues in an array
     PACKET_QUEUE() {
+        SIZE = 0;
+        match_mode = QUEUE_UNINDEXED;
+        initialize();
+    };
+
+    void initialize() {
         is_RQ = 0;
         is_WQ = 0;
+        write_mode = 0;
 
         cpu = 0;
         head = 0;
@@ -256,18 +343,27 @@ public:
         ROW_BUFFER_MISS = 0;
         FULL = 0;
 
-        //entry = new PACKET[SIZE]; 
+        entry = NULL;
+        index_table = NULL;
+        index_mask = 0;
+        index_shift = 0;
+    };
+
+    uint64_t match_key(PACKET *packet) {
+        return (match_mode == QUEUE_MATCH_FULL_ADDR) ? packet->full_addr : packet->address;
     };
 
-    // destructor
-    ~PACKET_QUEUE() {
-        delete[] entry;
+    uint32_t index_slot(uint64_t key) {
+        return (key * 0x9E3779B97F4A7C15ULL) >> index_shift;
     };
 
     // functions
     int check_queue(PACKET* packet);
-    void add_queue(PACKET* packet),
-        remove_queue(PACKET* packet);
+    void allocate(ARENA &arena),
+        add_queue(PACKET* packet),
+        remove_queue(PACKET* packet),
+        index_insert(uint32_t index),
+        index_erase(uint32_t index);
 };
 
 // reorder buffer
@@ -293,7 +389,7 @@ public:
     ooo_model_instr *entry;
 
     // constructor
-    CORE_BUFFER(string v1, uint32_t v2) : NAME(v1), SIZE(v2) {
+    CORE_BUFFER(string v1, uint32_t v2, ARENA &v3) : NAME(v1), SIZE(v2) {
         head = 0;
         tail = 0;
         occupancy = 0;
@@ -315,12 +411,7 @@ public:
         lsq_event_cycle = UINT64_MAX;
         retire_event_cycle = UINT64_MAX;
 
-        entry = new ooo_model_instr[SIZE];
-    };
-
-    // destructor
-    ~CORE_BUFFER() {
-        delete[] entry;
+        entry = v3.allocate<ooo_model_instr>(SIZE);
     };
 };
 
@@ -377,17 +468,12 @@ public:
     LSQ_ENTRY *entry;
 
     // constructor
-    LOAD_STORE_QUEUE(string v1, uint32_t v2) : NAME(v1), SIZE(v2) {
+    LOAD_STORE_QUEUE(string v1, uint32_t v2, ARENA &v3) : NAME(v1), SIZE(v2) {
         occupancy = 0;
         head = 0;
         tail = 0;
 
-        entry = new LSQ_ENTRY[SIZE];
-    };
-
-    // destructor
-    ~LOAD_STORE_QUEUE() {
-        delete[] entry;
+        entry = v3.allocate<LSQ_ENTRY>(SIZE);
     };
 };
 #endif
@@ -2,10 +2,20 @@
 #define CACHE_H
 
 #include "memory_class.h"
+#include "module_list.h"
+
+#include <functional>
 
 // PAGE
 extern uint32_t PAGE_TABLE_LATENCY, SWAP_LATENCY;
 
+// TAG STORE
+// the tags of the valid blocks of a set are kept contiguous, apart from the BLOCK metadata, so a lookup compares
+// every way at once with SSE2 (AVX2 when the build enables it), invalid and padding ways hold INVALID_TAG
+#define INVALID_TAG UINT64_MAX // cache line and page numbers never reach this value
+#define TAG_STORE_ALIGN 4 // ways per set are padded to a multiple of the widest compare
+#define TAG_STORE_CHUNK 64 // ways matched into one 64-bit mask, wider sets are matched a chunk at a time
+
 // CACHE TYPE
 #define IS_ITLB 0
 #define IS_DTLB 1
@@ -78,17 +88,25 @@ extern uint32_t PAGE_TABLE_LATENCY, SWAP_LATENCY;
 #define LLC_MSHR_SIZE NUM_CPUS*64
 #define LLC_LATENCY 20  // 4/5 (L1I or L1D) + 10 + 20 = 34/35 cycles
 
+class L1D_PREFETCHER_MODULE;
+class PREFETCHER_MODULE;
+class REPLACEMENT_MODULE;
+
 class CACHE : public MEMORY {
 public:
     uint32_t cpu;
     const string NAME;
     const uint32_t NUM_SET, NUM_WAY, NUM_LINE, WQ_SIZE, RQ_SIZE, PQ_SIZE, MSHR_SIZE;
+    const uint32_t SET_MASK; // a non power of two NUM_SET only uses its largest power of two sets
     uint32_t LATENCY;
     BLOCK **block;
+    uint64_t *tag_store;
+    uint32_t TAG_STRIDE;
     int fill_level;
     uint32_t MAX_READ, MAX_FILL;
     uint32_t reads_available_this_cycle;
     uint8_t cache_type;
+    ARENA &arena; // owner's arena, holds the blocks, tag store and queues
 
     // prefetch stats
     uint64_t pf_requested,
@@ -98,11 +116,15 @@ public:
         pf_fill;
 
     // queues
-    PACKET_QUEUE WQ{ NAME + "_WQ", WQ_SIZE }, // write queue
-        RQ{ NAME + "_RQ", RQ_SIZE }, // read queue
-        PQ{ NAME + "_PQ", PQ_SIZE }, // prefetch queue
-        MSHR{ NAME + "_MSHR", MSHR_SIZE }, // MSHR
-        PROCESSED{ NAME + "_PROCESSED", ROB_SIZE }; // processed queue
+    PACKET_QUEUE WQ{ NAME + "_WQ", WQ_SIZE, (uint8_t)((NAME == "L1D") ? QUEUE_MATCH_FULL_ADDR : QUEUE_MATCH_ADDRESS), arena }, // write queue, L1D merges stores by byte address
+        RQ{ NAME + "_RQ", RQ_SIZE, QUEUE_MATCH_ADDRESS, arena }, // read queue
+        PQ{ NAME + "_PQ", PQ_SIZE, QUEUE_MATCH_ADDRESS, arena }, // prefetch queue
+        MSHR{ NAME + "_MSHR", MSHR_SIZE, QUEUE_MATCH_ADDRESS, arena }, // MSHR, indexed by the entries add_mshr places
+        PROCESSED{ NAME + "_PROCESSED", ROB_SIZE, QUEUE_UNINDEXED, arena }; // processed queue
+
+    // MSHR bookkeeping, a bit per free entry and the returned entries ordered by (event_cycle, index) for the next fill
+    vector<uint64_t> mshr_free;
+    priority_queue<pair<uint64_t, uint32_t>, vector<pair<uint64_t, uint32_t> >, greater<pair<uint64_t, uint32_t> > > mshr_fill_order;
 
     uint64_t sim_access[NUM_CPUS][NUM_TYPES],
         sim_hit[NUM_CPUS][NUM_TYPES],
@@ -113,22 +135,38 @@ public:
 
     uint64_t total_miss_latency;
 
+    // modules picked at run time, only the ones of this cache's level are set
+    const L1D_PREFETCHER_MODULE *l1d_prefetcher_module;
+    const PREFETCHER_MODULE *l2c_prefetcher_module, *llc_prefetcher_module;
+    const REPLACEMENT_MODULE *llc_replacement_module;
+
     // constructor
-    CACHE(string v1, uint32_t v2, int v3, uint32_t v4, uint32_t v5, uint32_t v6, uint32_t v7, uint32_t v8)
-        : NAME(v1), NUM_SET(v2), NUM_WAY(v3), NUM_LINE(v4), WQ_SIZE(v5), RQ_SIZE(v6), PQ_SIZE(v7), MSHR_SIZE(v8) {
+    CACHE(string v1, uint32_t v2, int v3, uint32_t v4, uint32_t v5, uint32_t v6, uint32_t v7, uint32_t v8, ARENA &v9)
+        : NAME(v1), NUM_SET(v2), NUM_WAY(v3), NUM_LINE(v4), WQ_SIZE(v5), RQ_SIZE(v6), PQ_SIZE(v7), MSHR_SIZE(v8), SET_MASK((1 << lg2(v2)) - 1), arena(v9) {
 
         LATENCY = 0;
 
         // cache block
-        block = new BLOCK*[NUM_SET];
+        block = arena.allocate<BLOCK *>(NUM_SET);
+        block[0] = arena.allocate<BLOCK>(NUM_SET*NUM_WAY);
         for (uint32_t i=0; i<NUM_SET; i++) {
-            block[i] = new BLOCK[NUM_WAY];
+            block[i] = block[0] + i*NUM_WAY;
 
             for (uint32_t j=0; j<NUM_WAY; j++) {
                 block[i][j].lru = j;
             }
         }
 
+        mshr_free.assign((MSHR_SIZE + 63) / 64, 0);
+        for (uint32_t i=0; i<MSHR_SIZE; i++)
+            mshr_free[i >> 6] |= 1ULL << (i & 63);
+
+        // tag store
+        TAG_STRIDE = (NUM_WAY + TAG_STORE_ALIGN - 1) / TAG_STORE_ALIGN * TAG_STORE_ALIGN;
+        tag_store = arena.allocate<uint64_t>(NUM_SET*TAG_STRIDE);
+        for (uint32_t i=0; i<NUM_SET*TAG_STRIDE; i++)
+            tag_store[i] = INVALID_TAG;
+
         for (uint32_t i=0; i<NUM_CPUS; i++) {
             upper_level_icache[i] = NULL;
             upper_level_dcache[i] = NULL;
@@ -156,13 +194,11 @@ public:
         pf_useful = 0;
         pf_useless = 0;
         pf_fill = 0;
-    };
 
-    // destructor
-    ~CACHE() {
-        for (uint32_t i=0; i<NUM_SET; i++)
-            delete[] block[i];
-        delete[] block;
+        l1d_prefetcher_module = NULL;
+        l2c_prefetcher_module = NULL;
+        llc_prefetcher_module = NULL;
+        llc_replacement_module = NULL;
     };
 
     // functions
@@ -177,7 +213,9 @@ public:
     uint32_t get_occupancy(uint8_t queue_type, uint64_t address),
         get_size(uint8_t queue_type, uint64_t address);
 
-    int  check_hit(PACKET *packet),
+    uint64_t next_event_cycle(uint64_t current);
+
+    int  check_hit(PACKET *packet, uint32_t set),
         invalidate_entry(uint64_t inval_addr),
         check_mshr(PACKET *packet),
         prefetch_line(uint64_t ip, uint64_t base_addr, uint64_t pf_addr, int prefetch_fill_level, uint32_t prefetch_metadata),
@@ -189,6 +227,7 @@ public:
         handle_prefetch();
 
     void add_mshr(PACKET *packet),
+        remove_mshr(uint32_t index),
         update_fill_cycle(),
         llc_initialize_replacement(),
         update_replacement_state(uint32_t cpu, uint32_t set, uint32_t way, uint64_t full_addr, uint64_t ip, uint64_t victim_addr, uint32_t type, uint8_t hit),
@@ -217,11 +256,55 @@ public:
         l2c_prefetcher_cache_fill(uint64_t addr, uint32_t set, uint32_t way, uint8_t prefetch, uint64_t evicted_addr, uint32_t metadata_in),
         llc_prefetcher_cache_fill(uint64_t addr, uint32_t set, uint32_t way, uint8_t prefetch, uint64_t evicted_addr, uint32_t metadata_in);
 
-    uint32_t get_set(uint64_t address),
-        get_way(uint64_t address, uint32_t set),
+    uint32_t get_set(uint64_t address) {
+        return (uint32_t)(address & SET_MASK);
+    };
+
+    uint32_t get_way(uint64_t address, uint32_t set),
+        find_tag(uint32_t set, uint64_t tag),
         find_victim(uint32_t cpu, uint64_t instr_id, uint32_t set, const BLOCK *current_set, uint64_t ip, uint64_t full_addr, uint32_t type),
         llc_find_victim(uint32_t cpu, uint64_t instr_id, uint32_t set, const BLOCK *current_set, uint64_t ip, uint64_t full_addr, uint32_t type),
         lru_victim(uint32_t cpu, uint64_t instr_id, uint32_t set, const BLOCK *current_set, uint64_t ip, uint64_t full_addr, uint32_t type);
+
+    // hooks of every linked module, the generic hooks above dispatch to the selected one
+    L1D_PREFETCHER_LIST(DECLARE_L1D_PREFETCHER)
+    L2C_PREFETCHER_LIST(DECLARE_L2C_PREFETCHER)
+    LLC_PREFETCHER_LIST(DECLARE_LLC_PREFETCHER)
+    LLC_REPLACEMENT_LIST(DECLARE_LLC_REPLACEMENT)
+};
+
+class L1D_PREFETCHER_MODULE {
+public:
+    const char *name;
+    void (CACHE::*initialize)();
+    void (CACHE::*operate)(uint64_t addr, uint64_t ip, uint8_t cache_hit, uint8_t type);
+    void (CACHE::*cache_fill)(uint64_t addr, uint32_t set, uint32_t way, uint8_t prefetch, uint64_t evicted_addr, uint32_t metadata_in);
+    void (CACHE::*final_stats)();
 };
 
+// L2C and LLC prefetchers, which pass metadata along
+class PREFETCHER_MODULE {
+public:
+    const char *name;
+    void (CACHE::*initialize)();
+    uint32_t (CACHE::*operate)(uint64_t addr, uint64_t ip, uint8_t cache_hit, uint8_t type, uint32_t metadata_in);
+    uint32_t (CACHE::*cache_fill)(uint64_t addr, uint32_t set, uint32_t way, uint8_t prefetch, uint64_t evicted_addr, uint32_t metadata_in);
+    void (CACHE::*final_stats)();
+};
+
+class REPLACEMENT_MODULE {
+public:
+    const char *name;
+    void (CACHE::*initialize)();
+    uint32_t (CACHE::*find_victim)(uint32_t cpu, uint64_t instr_id, uint32_t set, const BLOCK *current_set, uint64_t ip, uint64_t full_addr, uint32_t type);
+    void (CACHE::*update_replacement_state)(uint32_t cpu, uint32_t set, uint32_t way, uint64_t full_addr, uint64_t ip, uint64_t victim_addr, uint32_t type, uint8_t hit);
+    void (CACHE::*final_stats)();
+};
+
+// look a module up by name, unknown names are fatal
+const L1D_PREFETCHER_MODULE *find_l1d_prefetcher(const char *name);
+const PREFETCHER_MODULE *find_l2c_prefetcher(const char *name),
+    *find_llc_prefetcher(const char *name);
+const REPLACEMENT_MODULE *find_llc_replacement(const char *name);
+
 #endif
@@ -54,22 +54,12 @@
 #define FILL_DRC   8
 #define FILL_DRAM 16
 
-// DRAM
-#define DRAM_CHANNELS 1      // default: assuming one DIMM per one channel 4GB * 1 => 4GB off-chip memory
-#define LOG2_DRAM_CHANNELS 0
-#define DRAM_RANKS 1         // 512MB * 8 ranks => 4GB per DIMM
-#define LOG2_DRAM_RANKS 0
-#define DRAM_BANKS 8         // 64MB * 8 banks => 512MB per rank
-#define LOG2_DRAM_BANKS 3
-#define DRAM_ROWS 65536      // 2KB * 32K rows => 64MB per bank
-#define LOG2_DRAM_ROWS 16
-#define DRAM_COLUMNS 128      // 64B * 32 column chunks (Assuming 1B DRAM cell * 8 chips * 8 transactions = 64B size of column chunks) => 2KB per row
-#define LOG2_DRAM_COLUMNS 7
-#define DRAM_ROW_SIZE (BLOCK_SIZE*DRAM_COLUMNS/1024)
-
-#define DRAM_SIZE (DRAM_CHANNELS*DRAM_RANKS*DRAM_BANKS*DRAM_ROWS*DRAM_ROW_SIZE/1024) 
-#define DRAM_PAGES ((DRAM_SIZE<<10)>>2) 
-//#define DRAM_PAGES 10
+// DRAM, the default geometry, -dram_channels, -dram_ranks, -dram_banks, -dram_rows and -dram_columns change it at run time
+#define DEFAULT_DRAM_CHANNELS 1      // default: assuming one DIMM per one channel 4GB * 1 => 4GB off-chip memory
+#define DEFAULT_DRAM_RANKS 1         // 512MB * 8 ranks => 4GB per DIMM
+#define DEFAULT_DRAM_BANKS 8         // 64MB * 8 banks => 512MB per rank
+#define DEFAULT_DRAM_ROWS 65536      // 2KB * 32K rows => 64MB per bank
+#define DEFAULT_DRAM_COLUMNS 128      // 64B * 32 column chunks (Assuming 1B DRAM cell * 8 chips * 8 transactions = 64B size of column chunks) => 2KB per row
 
 using namespace std;
 
@@ -79,7 +69,8 @@ all_warmup_complete,
 all_simulation_complete,
 MAX_INSTR_DESTINATIONS,
 knob_cloudsuite,
-knob_low_bandwidth;
+knob_low_bandwidth,
+knob_trace_thread;
 
 extern uint64_t current_core_cycle[NUM_CPUS],
 stall_cycle[NUM_CPUS],
@@ -87,8 +78,17 @@ last_drc_read_mode,
 last_drc_write_mode,
 drc_blocks;
 
+// DRAM geometry, powers of two set from the knobs by MEMORY_CONTROLLER::initialize()
+extern uint32_t DRAM_CHANNELS, LOG2_DRAM_CHANNELS,
+DRAM_RANKS, LOG2_DRAM_RANKS,
+DRAM_BANKS, LOG2_DRAM_BANKS,
+DRAM_ROWS, LOG2_DRAM_ROWS,
+DRAM_COLUMNS, LOG2_DRAM_COLUMNS,
+DRAM_SIZE; // MB
+
+extern uint64_t DRAM_PAGES;
+
 extern queue <uint64_t> page_queue;
-extern map <uint64_t, uint64_t> page_table, inverse_table, recent_page, unique_cl[NUM_CPUS];
 extern uint64_t previous_ppage, num_adjacent_page, num_cl[NUM_CPUS], allocated_pages, num_page[NUM_CPUS], minor_fault[NUM_CPUS], major_fault[NUM_CPUS];
 
 void print_stats();
@@ -99,6 +99,14 @@ va_to_pa(uint32_t cpu, uint64_t instr_id, uint64_t va, uint64_t unique_vpage, ui
 // log base 2 function from efectiu
 int lg2(int n);
 
+// folds an event due at event_cycle into next, the earliest cycle after current at which anything happens
+// events that are already due fire on the very next cycle
+inline uint64_t next_event(uint64_t next, uint64_t event_cycle, uint64_t current)
+{
+    uint64_t cycle = (event_cycle > current) ? event_cycle : (current + 1);
+    return (cycle < next) ? cycle : next;
+}
+
 // smart random number generator
 class RANDOM {
 public:
@@ -0,0 +1,221 @@
+#ifndef COMPACT_TRACE_H
+#define COMPACT_TRACE_H
+
+#include <stdint.h>
+#include <string.h>
+#include "instruction.h"
+
+// COMPACT TRACE FORMAT
+// most of a 64B input_instr is empty operand slots, so compact traces only store what is present
+//
+// file header (16B): COMPACT_TRACE_MAGIC, uint32 size of the expanded record
+//                    (sizeof(input_instr) or sizeof(cloudsuite_instr)), uint32 reserved
+// record:  uint8  flags     (COMPACT_*)
+//          uint16 operands  presence bitmap, little endian
+//                           bits [0,4) destination registers, [4,8) source registers,
+//                           [8,12) destination memory, [12,16) source memory
+//          varint ip        zigzag delta against the previous ip
+//          uint8            one register id per present register
+//          varint           one zigzag delta per present memory operand, against the previous memory operand
+//          uint8  asid[2]   only when COMPACT_ASID is set, otherwise the previous asid repeats
+
+#define COMPACT_TRACE_MAGIC "CHMPCMP1"
+#define COMPACT_TRACE_HEADER_SIZE 16
+#define COMPACT_MAX_RECORD_SIZE 128
+
+#define COMPACT_BRANCH 1
+#define COMPACT_TAKEN 2
+#define COMPACT_ASID 4
+
+#define COMPACT_DST_REG_SHIFT 0
+#define COMPACT_SRC_REG_SHIFT 4
+#define COMPACT_DST_MEM_SHIFT 8
+#define COMPACT_SRC_MEM_SHIFT 12
+
+// running state shared by the encoder and the decoder
+class COMPACT_TRACE_STATE {
+public:
+    uint64_t last_ip,
+        last_addr;
+    uint8_t asid[2];
+
+    COMPACT_TRACE_STATE() {
+        reset();
+    };
+
+    void reset() {
+        last_ip = 0;
+        last_addr = 0;
+        asid[0] = UINT8_MAX;
+        asid[1] = UINT8_MAX;
+    };
+};
+
+inline uint8_t *compact_put_varint(uint8_t *p, uint64_t value, uint64_t last)
+{
+    int64_t delta = (int64_t)(value - last);
+    uint64_t zigzag = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+
+    while (zigzag >= 0x80) {
+        *p++ = (uint8_t)(zigzag | 0x80);
+        zigzag >>= 7;
+    }
+    *p++ = (uint8_t)zigzag;
+
+    return p;
+}
+
+// returns NULL if the varint runs past end
+inline const uint8_t *compact_get_varint(const uint8_t *p, const uint8_t *end, uint64_t *value, uint64_t last)
+{
+    uint64_t zigzag = 0;
+    uint32_t shift = 0;
+
+    do {
+        if ((p == end) || (shift > 63))
+            return NULL;
+        zigzag |= (uint64_t)(*p & 0x7F) << shift;
+        shift += 7;
+    } while (*p++ & 0x80);
+
+    *value = last + (uint64_t)((zigzag >> 1) ^ (~(zigzag & 1) + 1));
+
+    return p;
+}
+
+// only cloudsuite records carry an address space id
+inline uint8_t *compact_asid(input_instr *instr) { return NULL; }
+inline uint8_t *compact_asid(cloudsuite_instr *instr) { return instr->asid; }
+
+// encode one record into p (at least COMPACT_MAX_RECORD_SIZE bytes), returns the end of the record
+template <class T>
+uint8_t *encode_compact_record(uint8_t *p, const T *instr, COMPACT_TRACE_STATE *state)
+{
+    const uint32_t num_dst = sizeof(instr->destination_registers);
+    uint8_t flags = 0;
+    uint16_t operands = 0;
+
+    if (instr->is_branch)
+        flags |= COMPACT_BRANCH;
+    if (instr->branch_taken)
+        flags |= COMPACT_TAKEN;
+
+    const uint8_t *asid = compact_asid(const_cast<T *>(instr));
+    if (asid && ((asid[0] != state->asid[0]) || (asid[1] != state->asid[1]))) {
+        flags |= COMPACT_ASID;
+        state->asid[0] = asid[0];
+        state->asid[1] = asid[1];
+    }
+
+    for (uint32_t i=0; i<num_dst; i++) {
+        if (instr->destination_registers[i])
+            operands |= 1 << (COMPACT_DST_REG_SHIFT + i);
+        if (instr->destination_memory[i])
+            operands |= 1 << (COMPACT_DST_MEM_SHIFT + i);
+    }
+    for (uint32_t i=0; i<NUM_INSTR_SOURCES; i++) {
+        if (instr->source_registers[i])
+            operands |= 1 << (COMPACT_SRC_REG_SHIFT + i);
+        if (instr->source_memory[i])
+            operands |= 1 << (COMPACT_SRC_MEM_SHIFT + i);
+    }
+
+    *p++ = flags;
+    *p++ = (uint8_t)operands;
+    *p++ = (uint8_t)(operands >> 8);
+
+    p = compact_put_varint(p, instr->ip, state->last_ip);
+    state->last_ip = instr->ip;
+
+    for (uint32_t i=0; i<num_dst; i++)
+        if (instr->destination_registers[i])
+            *p++ = instr->destination_registers[i];
+    for (uint32_t i=0; i<NUM_INSTR_SOURCES; i++)
+        if (instr->source_registers[i])
+            *p++ = instr->source_registers[i];
+
+    for (uint32_t i=0; i<num_dst; i++)
+        if (instr->destination_memory[i]) {
+            p = compact_put_varint(p, instr->destination_memory[i], state->last_addr);
+            state->last_addr = instr->destination_memory[i];
+        }
+    for (uint32_t i=0; i<NUM_INSTR_SOURCES; i++)
+        if (instr->source_memory[i]) {
+            p = compact_put_varint(p, instr->source_memory[i], state->last_addr);
+            state->last_addr = instr->source_memory[i];
+        }
+
+    if (flags & COMPACT_ASID) {
+        *p++ = asid[0];
+        *p++ = asid[1];
+    }
+
+    return p;
+}
+
+// decode one record at p into instr, returns the start of the next record or NULL if the record is truncated
+template <class T>
+const uint8_t *decode_compact_record(const uint8_t *p, const uint8_t *end, T *instr, COMPACT_TRACE_STATE *state)
+{
+    const uint32_t num_dst = sizeof(instr->destination_registers);
+
+    if (end - p < 3)
+        return NULL;
+
+    *instr = T();
+
+    uint8_t flags = *p++;
+    uint16_t operands = p[0] | (p[1] << 8);
+    p += 2;
+
+    instr->is_branch = (flags & COMPACT_BRANCH) ? 1 : 0;
+    instr->branch_taken = (flags & COMPACT_TAKEN) ? 1 : 0;
+
+    p = compact_get_varint(p, end, &state->last_ip, state->last_ip);
+    if (p == NULL)
+        return NULL;
+    instr->ip = state->last_ip;
+
+    // registers
+    if (end - p < __builtin_popcount(operands & 0xFF))
+        return NULL;
+    for (uint32_t i=0; i<num_dst; i++)
+        if (operands & (1 << (COMPACT_DST_REG_SHIFT + i)))
+            instr->destination_registers[i] = *p++;
+    for (uint32_t i=0; i<NUM_INSTR_SOURCES; i++)
+        if (operands & (1 << (COMPACT_SRC_REG_SHIFT + i)))
+            instr->source_registers[i] = *p++;
+
+    // memory operands
+    for (uint32_t i=0; i<num_dst; i++)
+        if (operands & (1 << (COMPACT_DST_MEM_SHIFT + i))) {
+            p = compact_get_varint(p, end, &state->last_addr, state->last_addr);
+            if (p == NULL)
+                return NULL;
+            instr->destination_memory[i] = state->last_addr;
+        }
+    for (uint32_t i=0; i<NUM_INSTR_SOURCES; i++)
+        if (operands & (1 << (COMPACT_SRC_MEM_SHIFT + i))) {
+            p = compact_get_varint(p, end, &state->last_addr, state->last_addr);
+            if (p == NULL)
+                return NULL;
+            instr->source_memory[i] = state->last_addr;
+        }
+
+    if (flags & COMPACT_ASID) {
+        if (end - p < 2)
+            return NULL;
+        state->asid[0] = *p++;
+        state->asid[1] = *p++;
+    }
+
+    uint8_t *asid = compact_asid(instr);
+    if (asid) {
+        asid[0] = state->asid[0];
+        asid[1] = state->asid[1];
+    }
+
+    return p;
+}
+
+#endif
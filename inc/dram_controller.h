@@ -2,6 +2,7 @@
 #define DRAM_H
 
 #include "memory_class.h"
+#include "dram_scheduler.h"
 
 // DRAM configuration
 #define DRAM_CHANNEL_WIDTH 8 // 8B
@@ -21,59 +22,235 @@ extern uint32_t DRAM_MTPS, DRAM_DBUS_RETURN_TIME;
 #define DRAM_WRITE_LOW_WM     ((DRAM_WQ_SIZE*3)>>2) // 6/8th
 #define MIN_DRAM_WRITES_PER_SWITCH (DRAM_WQ_SIZE*1/4)
 
+#define DRAM_BANKS_PER_CHANNEL (DRAM_RANKS*DRAM_BANKS)
+
+// address mappings, selected with -dram_mapping, fields from the least significant bit of the cache line address up
+#define DRAM_MAP_LINE 0 // channel, bank, column, rank, row: consecutive lines go to different channels and banks
+#define DRAM_MAP_ROW  1 // column, channel, bank, rank, row: consecutive lines stay in one row
+#define DRAM_MAP_XOR  2 // DRAM_MAP_ROW with the bank and channel XORed with the low row bits, so rows that would
+                        // conflict in one bank are spread over the banks
+#define NUM_DRAM_MAPPINGS 3
+extern const char *DRAM_MAPPING_NAME[NUM_DRAM_MAPPINGS];
+
+// timing models, selected with -dram_timing
+#define DRAM_TIMING_SIMPLE 0 // tRP, tRCD and tCAS per access, the banks are independent
+#define DRAM_TIMING_DDR4   1 // DDR4-3200 with 8Gb x8 devices, adds the rank constraints of DRAM_TIMING
+#define DRAM_TIMING_DDR5   2 // DDR5-4800 with 16Gb x8 devices, 32 banks in 8 groups unless -dram_banks is given
+#define NUM_DRAM_TIMINGS 3
+extern const char *DRAM_TIMING_NAME[NUM_DRAM_TIMINGS];
+
+// data rate in MT/s and banks per rank of a timing model, 0 keeps DRAM_IO_FREQ (with the original data bus time)
+// and the -dram_banks default
+extern const uint32_t DRAM_TIMING_MTPS[NUM_DRAM_TIMINGS], DRAM_TIMING_BANKS[NUM_DRAM_TIMINGS];
+
+// page policies, selected with -dram_page_policy, they decide whether a bank keeps its row open once a request is done
+#define DRAM_PAGE_OPEN     0 // until a request to another row
+#define DRAM_PAGE_CLOSED   1 // precharge after every request, unless a queued request hits the row
+#define DRAM_PAGE_ADAPTIVE 2 // precharge unless the bank's predictor expects the next request to hit the row
+#define NUM_DRAM_PAGE_POLICIES 3
+extern const char *DRAM_PAGE_POLICY_NAME[NUM_DRAM_PAGE_POLICIES];
+
+#define DRAM_ROW_PREDICTOR_MAX 3 // 2-bit counters, the row stays open from 2 up
+
+// row buffer outcomes, a miss finds the bank precharged and a conflict has to close another row first
+#define DRAM_ROW_HIT      0
+#define DRAM_ROW_MISS     1
+#define DRAM_ROW_CONFLICT 2
+#define NUM_DRAM_ROW_OUTCOMES 3
+
+#define DRAM_MAX_BANK_GROUPS 8
+#define DRAM_CAS_HISTORY 8
+
+// rank constraints of a DDR timing model in CPU cycles, the bank group is the low bits of the bank
+class DRAM_TIMING {
+public:
+    uint32_t tRRD_S, tRRD_L, // ACT to ACT in a different and in the same bank group
+        tFAW,                // at most four ACTs per rank in this window
+        tCCD_S, tCCD_L,      // CAS to CAS in a different and in the same bank group
+        tWR,                 // write recovery, end of write data to precharge
+        tREFI, tRFC,         // all-bank refresh interval and duration
+        bank_groups;
+};
+
+// recent commands of one rank, ACTs are issued in about the order they are scheduled, CASes are not since a row hit
+// can go ahead of a scheduled row miss, so the last few are kept to find the earliest free slot
+class DRAM_RANK_STATE {
+public:
+    uint64_t act_cycle[4], // the last four ACTs, oldest at act_head
+        group_act_cycle[DRAM_MAX_BANK_GROUPS],
+        cas_cycle[DRAM_CAS_HISTORY],
+        refresh_window; // the last refresh that closed the rank's rows
+
+    uint32_t act_head, cas_head,
+        cas_group[DRAM_CAS_HISTORY];
+};
+
+class DRAM_TIMING_STATS {
+public:
+    uint64_t refresh,
+        refresh_stall,        // cycles ACTs and CASes were pushed past a refresh
+        act_stall,            // by tRRD and tFAW
+        cas_stall,            // by tCCD
+        write_recovery_stall; // precharges that waited for tWR
+};
+
+class DRAM_CORE_STATS {
+public:
+    uint64_t reads, writes,
+        prefetches,   // reads of PREFETCH type
+        row_hits,
+        read_latency; // cycles from entering the RQ to the data return, summed over the reads
+};
+
+// DRAM coordinates of a queued request, decoded once when it enters the queue
+// prev and next link the unscheduled requests of the same bank
+class DRAM_SLOT {
+public:
+    uint32_t rank, bank, row,
+        prev, next;
+
+    uint64_t enqueued;
+    uint8_t outcome; // row buffer outcome once scheduled
+};
+
+// the unscheduled requests of one queue that map to one bank, with the oldest of them and the oldest open row hit
+// cached, stale once either may have changed through a removal or a new open row
+class DRAM_BANK_QUEUE {
+public:
+    uint32_t head, occupancy,
+        oldest, oldest_hit; // queue indices, the queue SIZE if there is none
+
+    uint8_t stale;
+};
+
+// DRAM QUEUE BANKS
+// splits a channel's RQ or WQ by bank, so FR-FCFS looks at one candidate pair per bank instead of every entry
+// requests are ordered by (event_cycle, queue index), which is the order of a scan for the oldest from index 0
+class DRAM_QUEUE_BANKS {
+public:
+    PACKET_QUEUE *queue;
+    BANK_REQUEST *bank_request; // the channel's banks, rank-major
+    DRAM_SLOT *slot;
+    DRAM_BANK_QUEUE *bank;
+
+    DRAM_QUEUE_BANKS() {
+        queue = NULL;
+        bank_request = NULL;
+        slot = NULL;
+        bank = NULL;
+    };
+
+    uint32_t bank_index(uint32_t index) {
+        return slot[index].rank*DRAM_BANKS + slot[index].bank;
+    };
+
+    uint8_t older(uint32_t a, uint32_t b) {
+        if (b == queue->SIZE)
+            return 1;
+
+        return (queue->entry[a].event_cycle < queue->entry[b].event_cycle) || ((queue->entry[a].event_cycle == queue->entry[b].event_cycle) && (a < b));
+    };
+
+    // functions
+    void initialize(PACKET_QUEUE *q, BANK_REQUEST *b, ARENA &arena),
+         insert(uint32_t index),
+         erase(uint32_t index),
+         refresh(uint32_t b);
+};
+
 // DRAM
+// the geometry is only known once the knobs are parsed, so the per-channel and per-bank state is allocated by initialize()
 class MEMORY_CONTROLLER : public MEMORY {
 public:
     const string NAME;
+    ARENA &arena;
 
-    DRAM_ARRAY dram_array[DRAM_CHANNELS][DRAM_RANKS][DRAM_BANKS];
-    uint64_t dbus_cycle_available[DRAM_CHANNELS], dbus_cycle_congested[DRAM_CHANNELS], dbus_congested[NUM_TYPES+1][NUM_TYPES+1];
-    uint64_t bank_cycle_available[DRAM_CHANNELS][DRAM_RANKS][DRAM_BANKS];
-    uint8_t  do_write, write_mode[DRAM_CHANNELS];
-    uint32_t processed_writes, scheduled_reads[DRAM_CHANNELS], scheduled_writes[DRAM_CHANNELS];
+    uint64_t *dbus_cycle_available, *dbus_cycle_congested, dbus_congested[NUM_TYPES+1][NUM_TYPES+1];
+    uint8_t  do_write, *write_mode;
+    uint32_t processed_writes, *scheduled_reads, *scheduled_writes;
     int fill_level;
 
-    BANK_REQUEST bank_request[DRAM_CHANNELS][DRAM_RANKS][DRAM_BANKS];
+    // address mapping
+    uint8_t mapping;
+    uint32_t channel_shift, rank_shift, bank_shift, row_shift, column_shift;
+
+    // timing model, the DDR models keep per rank and per bank command history
+    uint8_t timing_model;
+    DRAM_TIMING timing;
+    DRAM_RANK_STATE *rank_state; // channel and rank major
+    uint64_t *precharge_cycle;   // earliest precharge of each bank after write recovery
+    DRAM_TIMING_STATS *timing_stats;
+
+    // scheduler, prefetches go behind every demand request of a queue at least half full with prefetch_demote
+    DRAM_SCHEDULER *scheduler;
+    uint8_t prefetch_demote;
+    DRAM_CORE_STATS core_stats[NUM_CPUS];
+
+    // page policy, per bank
+    uint8_t page_policy,
+            *row_predictor;  // adaptive, whether the next request hits the row of the last one
+    uint32_t *last_row;      // row of the last request, the open row is gone once the policy closes it
+    uint64_t *activate_cycle; // earliest ACT after the policy precharged the bank
+    uint64_t row_outcome[NUM_DRAM_ROW_OUTCOMES][NUM_TYPES];
+
+    BANK_REQUEST *bank_request; // channel, rank and bank major
 
     // queues
-    PACKET_QUEUE WQ[DRAM_CHANNELS], RQ[DRAM_CHANNELS];
+    PACKET_QUEUE *WQ, *RQ;
+    DRAM_QUEUE_BANKS *WQ_banks, *RQ_banks;
 
     // constructor
-    MEMORY_CONTROLLER(string v1) : NAME(v1) {
+    MEMORY_CONTROLLER(string v1, ARENA &v2) : NAME(v1), arena(v2) {
         for (uint32_t i=0; i<NUM_TYPES+1; i++) {
             for (uint32_t j=0; j<NUM_TYPES+1; j++) {
                 dbus_congested[i][j] = 0;
             }
         }
+        dbus_cycle_available = NULL;
+        dbus_cycle_congested = NULL;
         do_write = 0;
+        write_mode = NULL;
         processed_writes = 0;
-        for (uint32_t i=0; i<DRAM_CHANNELS; i++) {
-            dbus_cycle_available[i] = 0;
-            dbus_cycle_congested[i] = 0;
-            write_mode[i] = 0;
-            scheduled_reads[i] = 0;
-            scheduled_writes[i] = 0;
-
-            for (uint32_t j=0; j<DRAM_RANKS; j++) {
-                for (uint32_t k=0; k<DRAM_BANKS; k++)
-                    bank_cycle_available[i][j][k] = 0;
-            }
+        scheduled_reads = NULL;
+        scheduled_writes = NULL;
+
+        mapping = DRAM_MAP_LINE;
+        channel_shift = 0;
+        rank_shift = 0;
+        bank_shift = 0;
+        row_shift = 0;
+        column_shift = 0;
 
-            WQ[i].NAME = "DRAM_WQ" + to_string(i);
-            WQ[i].SIZE = DRAM_WQ_SIZE;
-            WQ[i].entry = new PACKET[DRAM_WQ_SIZE];
+        timing_model = DRAM_TIMING_SIMPLE;
+        rank_state = NULL;
+        precharge_cycle = NULL;
+        timing_stats = NULL;
 
-            RQ[i].NAME = "DRAM_RQ" + to_string(i);
-            RQ[i].SIZE = DRAM_RQ_SIZE;
-            RQ[i].entry = new PACKET[DRAM_RQ_SIZE];
+        scheduler = NULL;
+        prefetch_demote = 0;
+        for (uint32_t i=0; i<NUM_CPUS; i++)
+            core_stats[i] = DRAM_CORE_STATS();
+
+        page_policy = DRAM_PAGE_OPEN;
+        row_predictor = NULL;
+        last_row = NULL;
+        activate_cycle = NULL;
+        for (uint32_t i=0; i<NUM_DRAM_ROW_OUTCOMES; i++) {
+            for (uint32_t j=0; j<NUM_TYPES; j++)
+                row_outcome[i][j] = 0;
         }
 
+        bank_request = NULL;
+        WQ = NULL;
+        RQ = NULL;
+        WQ_banks = NULL;
+        RQ_banks = NULL;
+
         fill_level = FILL_DRAM;
     };
 
-    // destructor
-    ~MEMORY_CONTROLLER() {
-
+    BANK_REQUEST *dram_bank(uint32_t channel, uint32_t rank, uint32_t bank) {
+        return &bank_request[(channel*DRAM_RANKS + rank)*DRAM_BANKS + bank];
     };
 
     // functions
@@ -88,6 +265,29 @@ public:
     uint32_t get_occupancy(uint8_t queue_type, uint64_t address),
         get_size(uint8_t queue_type, uint64_t address);
 
+    uint64_t next_event_cycle(uint64_t current);
+
+    void initialize(uint8_t map, uint8_t timing_model, uint8_t scheduler_kind, uint32_t row_hit_cap, uint8_t demote, uint8_t policy);
+
+    DRAM_QUEUE_BANKS *queue_banks(PACKET_QUEUE *queue) {
+        return queue->is_WQ ? &WQ_banks[queue - WQ] : &RQ_banks[queue - RQ];
+    };
+
+    void enqueue(PACKET_QUEUE *queue, uint32_t index),
+         open_row_changed(uint32_t channel, uint32_t rank, uint32_t bank),
+         refresh_rows(uint32_t channel, uint64_t current),
+         train_row_predictor(uint32_t channel, uint32_t rank, uint32_t bank, uint32_t row),
+         request_done(PACKET_QUEUE *queue, uint32_t index, uint32_t channel, uint32_t rank, uint32_t bank, uint64_t current),
+         policy_precharge(uint32_t channel, uint32_t rank, uint32_t bank, uint64_t current);
+
+    uint8_t row_hit_pending(uint32_t channel, uint32_t rank, uint32_t bank);
+
+    uint64_t ddr_latency(uint32_t channel, uint32_t rank, uint32_t bank, uint8_t row_buffer_hit, uint8_t is_write, uint64_t current),
+        refresh_window(uint32_t rank, uint64_t cycle),
+        after_refresh(uint32_t rank, uint64_t cycle);
+
+    int pick_request(PACKET_QUEUE *queue, uint8_t *row_buffer_hit);
+
     void schedule(PACKET_QUEUE *queue), process(PACKET_QUEUE *queue),
         update_schedule_cycle(PACKET_QUEUE *queue),
         update_process_cycle(PACKET_QUEUE *queue),
@@ -105,4 +305,8 @@ public:
     int check_dram_queue(PACKET_QUEUE *queue, PACKET *packet);
 };
 
+uint8_t find_dram_mapping(const char *name),
+        find_dram_timing(const char *name),
+        find_dram_page_policy(const char *name);
+
 #endif
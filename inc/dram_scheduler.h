@@ -0,0 +1,103 @@
+#ifndef DRAM_SCHEDULER_H
+#define DRAM_SCHEDULER_H
+
+#include "arena.h"
+#include "block.h"
+
+// DRAM SCHEDULERS
+// selected with -dram_scheduler, MEMORY_CONTROLLER::schedule() serves the pending request of an idle bank with the
+// lowest priority() and breaks ties by age, the banks are numbered within the channel, rank-major
+#define DRAM_SCHED_FRFCFS     0 // row hits first, then the oldest request
+#define DRAM_SCHED_FRFCFS_CAP 1 // FR-FCFS with at most -dram_row_hit_cap row hits in a row per bank before the oldest goes
+#define DRAM_SCHED_BLISS      2 // cores served many times in a row are blacklisted behind the others until the next clearing
+#define DRAM_SCHED_ATLAS      3 // cores with the least attained service over past quanta first, very old requests before all
+#define NUM_DRAM_SCHEDULERS 4
+extern const char *DRAM_SCHEDULER_NAME[NUM_DRAM_SCHEDULERS];
+
+#define DEFAULT_DRAM_ROW_HIT_CAP 4
+
+#define BLISS_THRESHOLD 4            // consecutive requests of one core on a channel that blacklist it
+#define BLISS_CLEARING_INTERVAL 10000 // cycles
+
+#define ATLAS_QUANTUM 1000000 // cycles
+#define ATLAS_HISTORY 0.875   // weight of the service attained before the last quantum
+#define ATLAS_AGE_THRESHOLD 100000 // cycles a request waits before it goes ahead of every rank
+
+class DRAM_SCHEDULER {
+public:
+    const uint8_t kind;
+
+    DRAM_SCHEDULER() : kind(DRAM_SCHED_FRFCFS) {};
+    DRAM_SCHEDULER(uint8_t v1) : kind(v1) {};
+    virtual ~DRAM_SCHEDULER() {};
+
+    virtual void initialize(uint32_t channels, uint32_t banks_per_channel, ARENA &arena) {};
+
+    // lower is served first
+    virtual uint64_t priority(uint32_t channel, uint32_t bank, PACKET *packet, uint8_t row_hit, uint64_t enqueued, uint64_t current) {
+        return row_hit ? 0 : 1;
+    };
+
+    // the request was picked, its bank is busy for latency cycles
+    virtual void scheduled(uint32_t channel, uint32_t bank, PACKET *packet, uint8_t row_hit, uint64_t latency, uint64_t current) {};
+};
+
+class FRFCFS_CAP_SCHEDULER : public DRAM_SCHEDULER {
+public:
+    uint32_t cap, banks_per_channel,
+             *streak; // row hits served in a row, per channel and bank
+
+    FRFCFS_CAP_SCHEDULER() : DRAM_SCHEDULER(DRAM_SCHED_FRFCFS_CAP) {
+        cap = DEFAULT_DRAM_ROW_HIT_CAP;
+        banks_per_channel = 0;
+        streak = NULL;
+    };
+
+    void initialize(uint32_t channels, uint32_t banks, ARENA &arena);
+    uint64_t priority(uint32_t channel, uint32_t bank, PACKET *packet, uint8_t row_hit, uint64_t enqueued, uint64_t current);
+    void scheduled(uint32_t channel, uint32_t bank, PACKET *packet, uint8_t row_hit, uint64_t latency, uint64_t current);
+};
+
+class BLISS_SCHEDULER : public DRAM_SCHEDULER {
+public:
+    uint8_t blacklisted[NUM_CPUS];
+    uint32_t *last_cpu, *streak; // per channel
+    uint64_t next_clearing;
+
+    BLISS_SCHEDULER() : DRAM_SCHEDULER(DRAM_SCHED_BLISS) {
+        for (uint32_t i=0; i<NUM_CPUS; i++)
+            blacklisted[i] = 0;
+        last_cpu = NULL;
+        streak = NULL;
+        next_clearing = BLISS_CLEARING_INTERVAL;
+    };
+
+    void initialize(uint32_t channels, uint32_t banks, ARENA &arena);
+    uint64_t priority(uint32_t channel, uint32_t bank, PACKET *packet, uint8_t row_hit, uint64_t enqueued, uint64_t current);
+    void scheduled(uint32_t channel, uint32_t bank, PACKET *packet, uint8_t row_hit, uint64_t latency, uint64_t current);
+};
+
+class ATLAS_SCHEDULER : public DRAM_SCHEDULER {
+public:
+    double total_service[NUM_CPUS];
+    uint64_t quantum_service[NUM_CPUS], next_quantum;
+    uint32_t rank[NUM_CPUS]; // 0 for the core with the least total service
+
+    ATLAS_SCHEDULER() : DRAM_SCHEDULER(DRAM_SCHED_ATLAS) {
+        for (uint32_t i=0; i<NUM_CPUS; i++) {
+            total_service[i] = 0;
+            quantum_service[i] = 0;
+            rank[i] = 0;
+        }
+        next_quantum = ATLAS_QUANTUM;
+    };
+
+    void end_quantum(uint64_t current);
+    uint64_t priority(uint32_t channel, uint32_t bank, PACKET *packet, uint8_t row_hit, uint64_t enqueued, uint64_t current);
+    void scheduled(uint32_t channel, uint32_t bank, PACKET *packet, uint8_t row_hit, uint64_t latency, uint64_t current);
+};
+
+uint8_t find_dram_scheduler(const char *name);
+DRAM_SCHEDULER *create_dram_scheduler(uint8_t kind, uint32_t row_hit_cap, ARENA &arena);
+
+#endif
@@ -27,6 +27,9 @@
 
 #define BAD_MAX 7
 
+// kept in their own namespace, spp_dev has classes of the same names
+namespace kpcp {
+
 class SIGNATURE_TABLE {
 public:
 
@@ -455,4 +458,6 @@ void notify_sampler(uint32_t cpu, int64_t address, int dirty, int useful)
     */
 }
 
+}
+
 #endif
@@ -22,8 +22,8 @@ public:
     // memory interface
     MEMORY *upper_level_icache[NUM_CPUS], *upper_level_dcache[NUM_CPUS], *lower_level, *extra_interface;
 
-    // empty queues
-    PACKET_QUEUE WQ{ "EMPTY", 1 }, RQ{ "EMPTY", 1 }, PQ{ "EMPTY", 1 }, MSHR{ "EMPTY", 1 };
+    // empty queues, the levels that queue requests declare their own
+    PACKET_QUEUE WQ, RQ, PQ, MSHR;
 
     // functions
     virtual int  add_rq(PACKET *packet) = 0;
@@ -0,0 +1,55 @@
+#ifndef MODULE_H
+#define MODULE_H
+
+// included first by every branch predictor, prefetcher and replacement module, see module_list.h
+// maps the hooks of the module's kind onto the per-module members declared in O3_CPU and CACHE,
+// e.g. O3_CPU::predict_branch() in branch/bimodal.cc becomes O3_CPU::bimodal_predict_branch()
+#include "ooo_cpu.h"
+
+#define MODULE_HOOK(name, hook) MODULE_HOOK_PASTE(name, hook)
+#define MODULE_HOOK_PASTE(name, hook) name##_##hook
+
+#ifdef BRANCH_PREDICTOR
+#define initialize_branch_predictor MODULE_HOOK(BRANCH_PREDICTOR, initialize_branch_predictor)
+#define predict_branch MODULE_HOOK(BRANCH_PREDICTOR, predict_branch)
+#define last_branch_result MODULE_HOOK(BRANCH_PREDICTOR, last_branch_result)
+#endif
+
+#ifdef L1I_PREFETCHER
+#define l1i_prefetcher_initialize MODULE_HOOK(L1I_PREFETCHER, l1i_prefetcher_initialize)
+#define l1i_prefetcher_branch_operate MODULE_HOOK(L1I_PREFETCHER, l1i_prefetcher_branch_operate)
+#define l1i_prefetcher_cache_operate MODULE_HOOK(L1I_PREFETCHER, l1i_prefetcher_cache_operate)
+#define l1i_prefetcher_cycle_operate MODULE_HOOK(L1I_PREFETCHER, l1i_prefetcher_cycle_operate)
+#define l1i_prefetcher_cache_fill MODULE_HOOK(L1I_PREFETCHER, l1i_prefetcher_cache_fill)
+#define l1i_prefetcher_final_stats MODULE_HOOK(L1I_PREFETCHER, l1i_prefetcher_final_stats)
+#endif
+
+#ifdef L1D_PREFETCHER
+#define l1d_prefetcher_initialize MODULE_HOOK(L1D_PREFETCHER, l1d_prefetcher_initialize)
+#define l1d_prefetcher_operate MODULE_HOOK(L1D_PREFETCHER, l1d_prefetcher_operate)
+#define l1d_prefetcher_cache_fill MODULE_HOOK(L1D_PREFETCHER, l1d_prefetcher_cache_fill)
+#define l1d_prefetcher_final_stats MODULE_HOOK(L1D_PREFETCHER, l1d_prefetcher_final_stats)
+#endif
+
+#ifdef L2C_PREFETCHER
+#define l2c_prefetcher_initialize MODULE_HOOK(L2C_PREFETCHER, l2c_prefetcher_initialize)
+#define l2c_prefetcher_operate MODULE_HOOK(L2C_PREFETCHER, l2c_prefetcher_operate)
+#define l2c_prefetcher_cache_fill MODULE_HOOK(L2C_PREFETCHER, l2c_prefetcher_cache_fill)
+#define l2c_prefetcher_final_stats MODULE_HOOK(L2C_PREFETCHER, l2c_prefetcher_final_stats)
+#endif
+
+#ifdef LLC_PREFETCHER
+#define llc_prefetcher_initialize MODULE_HOOK(LLC_PREFETCHER, llc_prefetcher_initialize)
+#define llc_prefetcher_operate MODULE_HOOK(LLC_PREFETCHER, llc_prefetcher_operate)
+#define llc_prefetcher_cache_fill MODULE_HOOK(LLC_PREFETCHER, llc_prefetcher_cache_fill)
+#define llc_prefetcher_final_stats MODULE_HOOK(LLC_PREFETCHER, llc_prefetcher_final_stats)
+#endif
+
+#ifdef LLC_REPLACEMENT
+#define llc_initialize_replacement MODULE_HOOK(LLC_REPLACEMENT, llc_initialize_replacement)
+#define llc_find_victim MODULE_HOOK(LLC_REPLACEMENT, llc_find_victim)
+#define llc_update_replacement_state MODULE_HOOK(LLC_REPLACEMENT, llc_update_replacement_state)
+#define llc_replacement_final_stats MODULE_HOOK(LLC_REPLACEMENT, llc_replacement_final_stats)
+#endif
+
+#endif
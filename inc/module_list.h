@@ -0,0 +1,64 @@
+#ifndef MODULE_LIST_H
+#define MODULE_LIST_H
+
+// RUNTIME-SELECTABLE MODULES
+// every branch predictor, prefetcher and replacement policy below is linked into the binary and picked at run time
+// with -branch_predictor, -l1i_prefetcher, -l1d_prefetcher, -l2c_prefetcher, -llc_prefetcher and -llc_replacement
+// a module still defines the usual O3_CPU/CACHE hooks, it only has to name itself before including module.h, e.g.
+//     #define BRANCH_PREDICTOR bimodal
+//     #include "module.h"
+// module.h renames its hooks to <name>_<hook> so that all modules of a kind can live side by side
+// to add a module, drop it into branch/, prefetcher/<level>/ or replacement/ and add its name to the list of its kind
+#define BRANCH_PREDICTOR_LIST(X) X(bimodal) X(gshare) X(perceptron) X(hashed_perceptron)
+#define L1I_PREFETCHER_LIST(X) X(no) X(next_line) X(fdip)
+#define L1D_PREFETCHER_LIST(X) X(no) X(next_line)
+#define L2C_PREFETCHER_LIST(X) X(no) X(next_line) X(ip_stride) X(kpcp) X(spp_dev)
+#define LLC_PREFETCHER_LIST(X) X(no) X(next_line)
+#define LLC_REPLACEMENT_LIST(X) X(lru) X(srrip) X(drrip) X(ship)
+
+#define DEFAULT_BRANCH_PREDICTOR "bimodal"
+#define DEFAULT_L1I_PREFETCHER "no"
+#define DEFAULT_L1D_PREFETCHER "no"
+#define DEFAULT_L2C_PREFETCHER "no"
+#define DEFAULT_LLC_PREFETCHER "no"
+#define DEFAULT_LLC_REPLACEMENT "lru"
+
+// hooks every module of a kind defines, declared inside O3_CPU and CACHE
+#define DECLARE_BRANCH_PREDICTOR(name) \
+    uint8_t name##_predict_branch(uint64_t ip); \
+    void name##_initialize_branch_predictor(), \
+         name##_last_branch_result(uint64_t ip, uint8_t taken);
+
+#define DECLARE_L1I_PREFETCHER(name) \
+    void name##_l1i_prefetcher_initialize(), \
+         name##_l1i_prefetcher_branch_operate(uint64_t ip, uint8_t branch_type, uint64_t branch_target), \
+         name##_l1i_prefetcher_cache_operate(uint64_t v_addr, uint8_t cache_hit, uint8_t prefetch_hit), \
+         name##_l1i_prefetcher_cycle_operate(), \
+         name##_l1i_prefetcher_cache_fill(uint64_t v_addr, uint32_t set, uint32_t way, uint8_t prefetch, uint64_t evicted_v_addr), \
+         name##_l1i_prefetcher_final_stats();
+
+#define DECLARE_L1D_PREFETCHER(name) \
+    void name##_l1d_prefetcher_initialize(), \
+         name##_l1d_prefetcher_operate(uint64_t addr, uint64_t ip, uint8_t cache_hit, uint8_t type), \
+         name##_l1d_prefetcher_cache_fill(uint64_t addr, uint32_t set, uint32_t way, uint8_t prefetch, uint64_t evicted_addr, uint32_t metadata_in), \
+         name##_l1d_prefetcher_final_stats();
+
+#define DECLARE_L2C_PREFETCHER(name) \
+    void name##_l2c_prefetcher_initialize(), \
+         name##_l2c_prefetcher_final_stats(); \
+    uint32_t name##_l2c_prefetcher_operate(uint64_t addr, uint64_t ip, uint8_t cache_hit, uint8_t type, uint32_t metadata_in), \
+             name##_l2c_prefetcher_cache_fill(uint64_t addr, uint32_t set, uint32_t way, uint8_t prefetch, uint64_t evicted_addr, uint32_t metadata_in);
+
+#define DECLARE_LLC_PREFETCHER(name) \
+    void name##_llc_prefetcher_initialize(), \
+         name##_llc_prefetcher_final_stats(); \
+    uint32_t name##_llc_prefetcher_operate(uint64_t addr, uint64_t ip, uint8_t cache_hit, uint8_t type, uint32_t metadata_in), \
+             name##_llc_prefetcher_cache_fill(uint64_t addr, uint32_t set, uint32_t way, uint8_t prefetch, uint64_t evicted_addr, uint32_t metadata_in);
+
+#define DECLARE_LLC_REPLACEMENT(name) \
+    void name##_llc_initialize_replacement(), \
+         name##_llc_update_replacement_state(uint32_t cpu, uint32_t set, uint32_t way, uint64_t full_addr, uint64_t ip, uint64_t victim_addr, uint32_t type, uint8_t hit), \
+         name##_llc_replacement_final_stats(); \
+    uint32_t name##_llc_find_victim(uint32_t cpu, uint64_t instr_id, uint32_t set, const BLOCK *current_set, uint64_t ip, uint64_t full_addr, uint32_t type);
+
+#endif
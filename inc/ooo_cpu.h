@@ -2,6 +2,8 @@
 #define OOO_CPU_H
 
 #include "cache.h"
+#include "page_table.h"
+#include "trace_reader.h"
 
 #ifdef CRC2_COMPILE
 #define STAT_PRINTING_PERIOD 1000000
@@ -26,23 +28,134 @@ using namespace std;
 //#define DECODE_LATENCY 2
 
 #define STA_SIZE (ROB_SIZE*NUM_INSTR_DESTINATIONS_SPARC)
+#define IFETCH_BUFFER_SIZE (FETCH_WIDTH*2)
+
+#define NUM_ARCH_REGISTERS 256 // a register is a byte of the trace, 0 is none
+#define ROB_REF(rob_index, instr_id) (((uint64_t)(instr_id) << 16) | (rob_index)) // a ROB entry that is only valid while instr_id holds it
+
+#if ROB_SIZE > 65536
+#error "ROB_REF needs a wider rob_index field"
+#endif
+
+// a bit per ROB entry, visited in ROB order by skipping clear words instead of walking every entry
+class ROB_BITMAP {
+public:
+    uint64_t bits[(ROB_SIZE + 63) / 64];
+
+    ROB_BITMAP() {
+        for (uint32_t i=0; i<(ROB_SIZE + 63) / 64; i++)
+            bits[i] = 0;
+    };
+
+    void set(uint32_t index) {
+        bits[index >> 6] |= 1ULL << (index & 63);
+    };
+
+    void clear(uint32_t index) {
+        bits[index >> 6] &= ~(1ULL << (index & 63));
+    };
+
+    // first set index in [begin, end), end if there is none
+    uint32_t next(uint32_t begin, uint32_t end) {
+        while (begin < end) {
+            uint64_t word = bits[begin >> 6] >> (begin & 63);
+            if (word) {
+                uint32_t index = begin + __builtin_ctzll(word);
+                return (index < end) ? index : end;
+            }
+            begin = (begin | 63) + 1;
+        }
+
+        return end;
+    };
+};
+
+// IFETCH_BUFFER entries grouped by ip >> shift, a cache line or a page, in fetch order
+// so a translation or a line fill updates the entries it covers without scanning the buffer
+class IFETCH_GROUPS {
+public:
+    ADDRESS_TABLE group; // ip >> shift => (oldest index << 32) | youngest index
+    uint32_t next[IFETCH_BUFFER_SIZE]; // next younger entry of the same group, IFETCH_BUFFER_SIZE after the youngest
+    const uint32_t shift;
+
+    IFETCH_GROUPS(uint32_t v1) : group(1, 6), shift(v1) {};
+
+    // functions
+    uint32_t first(uint64_t ip);
+    void add(uint64_t ip, uint32_t index),
+         remove_oldest(uint64_t ip, uint32_t index);
+};
+
+// FETCH TARGET QUEUE
+// decoupled front end, enabled with -ftq_size: the branch predictor runs ahead of fetch over the trace and queues
+// fetch blocks, the instructions of one cache line up to a predicted taken branch or FETCH_WIDTH of them,
+// so the L1I prefetcher sees where fetch is going before fetch gets there
+class FTQ_BLOCK {
+public:
+    uint64_t ip; // first instruction of the block
+    uint32_t num_instr,
+        next_fetch; // next instruction to move into the IFETCH_BUFFER
+    uint8_t taken, // ends with a correctly predicted taken branch, fetch stops there for the cycle
+        prefetched; // set by the L1I prefetcher once it has acted on the block
+
+    ooo_model_instr instr[FETCH_WIDTH];
+
+    FTQ_BLOCK() {
+        ip = 0;
+        num_instr = 0;
+        next_fetch = 0;
+        taken = 0;
+        prefetched = 0;
+    };
+};
+
+class FETCH_TARGET_QUEUE {
+public:
+    uint32_t SIZE, head, tail, occupancy;
+    uint8_t stalled, // the youngest block ends with a mispredicted branch, run-ahead waits until it resolves
+        has_pending, // pending was read from the trace but belongs to the next block
+        prefetcher;  // the L1I prefetcher walks the queued blocks and sets their prefetched bit
+    ooo_model_instr pending;
+    FTQ_BLOCK *block;
+
+    FETCH_TARGET_QUEUE() {
+        SIZE = 0;
+        head = 0;
+        tail = 0;
+        occupancy = 0;
+        stalled = 0;
+        has_pending = 0;
+        prefetcher = 0;
+        block = NULL;
+    };
+
+    // i-th block counted from the oldest
+    FTQ_BLOCK *at(uint32_t i) {
+        return &block[(head + i) % SIZE];
+    };
+
+    // functions
+    void initialize(uint32_t size, ARENA &arena);
+};
 
 extern uint32_t SCHEDULING_LATENCY, EXEC_LATENCY, DECODE_LATENCY;
 
+class BRANCH_PREDICTOR_MODULE;
+class L1I_PREFETCHER_MODULE;
+
 // cpu
 class O3_CPU {
 public:
     uint32_t cpu;
 
     // trace
-    FILE *trace_file;
+    TRACE_READER trace_reader;
+    DECODED_TRACE_CACHE decoded_trace;
     char trace_string[1024];
-    char gunzip_command[1024];
 
     // instruction
     input_instr next_instr;
     input_instr current_instr;
-    cloudsuite_instr current_cloudsuite_instr;
     uint64_t instr_unique_id, completed_executions,
         begin_sim_cycle, begin_sim_instr,
         last_sim_cycle, last_sim_instr,
@@ -52,11 +165,19 @@ public:
     uint32_t inflight_reg_executions, inflight_mem_executions, num_searched;
     uint32_t next_ITLB_fetch;
 
+    // backs the buffers, queues and caches below, declared before them so it is torn down after them
+    ARENA arena;
+
     // reorder buffer, load/store queue, register file
-    CORE_BUFFER IFETCH_BUFFER{ "IFETCH_BUFFER", FETCH_WIDTH*2 };
-    CORE_BUFFER DECODE_BUFFER{ "DECODE_BUFFER", DECODE_WIDTH*3 };
-    CORE_BUFFER ROB{ "ROB", ROB_SIZE };
-    LOAD_STORE_QUEUE LQ{ "LQ", LQ_SIZE }, SQ{ "SQ", SQ_SIZE };
+    CORE_BUFFER IFETCH_BUFFER{ "IFETCH_BUFFER", IFETCH_BUFFER_SIZE, arena };
+    CORE_BUFFER DECODE_BUFFER{ "DECODE_BUFFER", DECODE_WIDTH*3, arena };
+    CORE_BUFFER ROB{ "ROB", ROB_SIZE, arena };
+    LOAD_STORE_QUEUE LQ{ "LQ", LQ_SIZE, arena }, SQ{ "SQ", SQ_SIZE, arena };
+
+    IFETCH_GROUPS ifetch_line{ 6 }, ifetch_page{ LOG2_PAGE_SIZE };
+
+    // filled by run_ahead() when the front end is decoupled, SIZE is 0 otherwise
+    FETCH_TARGET_QUEUE ftq;
 
     // store array, this structure is required to properly handle store instructions
     uint64_t STA[STA_SIZE], STA_head, STA_tail;
@@ -73,22 +194,29 @@ public:
     uint32_t RTS0[SQ_SIZE], RTS0_head, RTS0_tail,
         RTS1[SQ_SIZE], RTS1_head, RTS1_tail;
 
+    // wakeup bookkeeping, so per-cycle work follows the instructions that change state rather than the ROB size
+    ROB_BITMAP rob_inflight, // executed is INFLIGHT, checked by update_rob()
+        rob_memory;          // memory instructions in the ROB, the only ones schedule_memory_instruction() looks at
+    vector<uint32_t> reg_writers[NUM_ARCH_REGISTERS]; // scheduled writers of each register that have not executed, oldest first
+    ADDRESS_TABLE youngest_store{ 1, 8 }; // store address => ROB_REF of the youngest store to it in the ROB
+    uint64_t older_store[ROB_SIZE][NUM_INSTR_DESTINATIONS_SPARC]; // ROB_REF of the next older store to the same address
+
     // branch
     int branch_mispredict_stall_fetch; // flag that says that we should stall because a branch prediction was wrong
     int mispredicted_branch_iw_index; // index in the instruction window of the mispredicted branch.  fetch resumes after the instruction at this index executes
     uint8_t  fetch_stall;
     uint64_t fetch_resume_cycle;
     uint64_t num_branch, branch_mispredictions;
-    uint64_t total_rob_occupancy_at_branch_mispredict;
+    uint64_t total_rob_occupancy_at_branch_mispredict; // taken when fetch reaches the mispredicted branch
     uint64_t total_branch_types[8];
 
     // TLBs and caches
-    CACHE ITLB{ "ITLB", ITLB_SET, ITLB_WAY, ITLB_SET*ITLB_WAY, ITLB_WQ_SIZE, ITLB_RQ_SIZE, ITLB_PQ_SIZE, ITLB_MSHR_SIZE },
-        DTLB{ "DTLB", DTLB_SET, DTLB_WAY, DTLB_SET*DTLB_WAY, DTLB_WQ_SIZE, DTLB_RQ_SIZE, DTLB_PQ_SIZE, DTLB_MSHR_SIZE },
-        STLB{ "STLB", STLB_SET, STLB_WAY, STLB_SET*STLB_WAY, STLB_WQ_SIZE, STLB_RQ_SIZE, STLB_PQ_SIZE, STLB_MSHR_SIZE },
-        L1I{ "L1I", L1I_SET, L1I_WAY, L1I_SET*L1I_WAY, L1I_WQ_SIZE, L1I_RQ_SIZE, L1I_PQ_SIZE, L1I_MSHR_SIZE },
-        L1D{ "L1D", L1D_SET, L1D_WAY, L1D_SET*L1D_WAY, L1D_WQ_SIZE, L1D_RQ_SIZE, L1D_PQ_SIZE, L1D_MSHR_SIZE },
-        L2C{ "L2C", L2C_SET, L2C_WAY, L2C_SET*L2C_WAY, L2C_WQ_SIZE, L2C_RQ_SIZE, L2C_PQ_SIZE, L2C_MSHR_SIZE };
+    CACHE ITLB{ "ITLB", ITLB_SET, ITLB_WAY, ITLB_SET*ITLB_WAY, ITLB_WQ_SIZE, ITLB_RQ_SIZE, ITLB_PQ_SIZE, ITLB_MSHR_SIZE, arena },
+        DTLB{ "DTLB", DTLB_SET, DTLB_WAY, DTLB_SET*DTLB_WAY, DTLB_WQ_SIZE, DTLB_RQ_SIZE, DTLB_PQ_SIZE, DTLB_MSHR_SIZE, arena },
+        STLB{ "STLB", STLB_SET, STLB_WAY, STLB_SET*STLB_WAY, STLB_WQ_SIZE, STLB_RQ_SIZE, STLB_PQ_SIZE, STLB_MSHR_SIZE, arena },
+        L1I{ "L1I", L1I_SET, L1I_WAY, L1I_SET*L1I_WAY, L1I_WQ_SIZE, L1I_RQ_SIZE, L1I_PQ_SIZE, L1I_MSHR_SIZE, arena },
+        L1D{ "L1D", L1D_SET, L1D_WAY, L1D_SET*L1D_WAY, L1D_WQ_SIZE, L1D_RQ_SIZE, L1D_PQ_SIZE, L1D_MSHR_SIZE, arena },
+        L2C{ "L2C", L2C_SET, L2C_WAY, L2C_SET*L2C_WAY, L2C_WQ_SIZE, L2C_RQ_SIZE, L2C_PQ_SIZE, L2C_MSHR_SIZE, arena };
 
     // trace cache for previously decoded instructions
 
@@ -96,9 +224,6 @@ public:
     O3_CPU() {
         cpu = 0;
 
-        // trace
-        trace_file = NULL;
-
         // instruction
         instr_unique_id = 0;
         completed_executions = 0;
@@ -165,10 +290,18 @@ public:
         RTS1_head = 0;
         RTS0_tail = 0;
         RTS1_tail = 0;
+
+        branch_predictor_module = NULL;
+        l1i_prefetcher_module = NULL;
     }
 
     // functions
     void read_from_trace(),
+        read_from_ftq(),
+        run_ahead(),
+        add_to_sta(ooo_model_instr *arch_instr),
+        decode_cloudsuite_instr(const cloudsuite_instr *trace_instr, ooo_model_instr *arch_instr),
+        decode_input_instr(const input_instr *trace_instr, uint64_t next_ip, ooo_model_instr *arch_instr),
         fetch_instruction(),
         decode_and_dispatch(),
         schedule_instruction(),
@@ -177,6 +310,8 @@ public:
         execute_memory_instruction(),
         do_scheduling(uint32_t rob_index),
         reg_dependency(uint32_t rob_index),
+        add_reg_writer(uint32_t rob_index),
+        remove_reg_writer(uint32_t rob_index),
         do_execution(uint32_t rob_index),
         do_memory_scheduling(uint32_t rob_index),
         operate_lsq(),
@@ -192,23 +327,34 @@ public:
         complete_data_fetch(PACKET_QUEUE *queue, uint8_t is_it_tlb);
 
     void initialize_core();
+    int  next_trace_instr(ooo_model_instr *arch_instr);
     void add_load_queue(uint32_t rob_index, uint32_t data_index),
         add_store_queue(uint32_t rob_index, uint32_t data_index),
         execute_store(uint32_t rob_index, uint32_t sq_index, uint32_t data_index);
     int  execute_load(uint32_t rob_index, uint32_t sq_index, uint32_t data_index);
     void check_dependency(int prior, int current);
-    void operate_cache();
+    void operate(),
+         operate_cache();
     void update_rob();
     void retire_rob();
+    uint64_t next_event_cycle(uint64_t current);
+    uint8_t lsq_blocked(uint32_t rob_index);
 
     uint32_t  add_to_rob(ooo_model_instr *arch_instr),
-        check_rob(uint64_t instr_id);
+        older_store_index(uint32_t rob_index, uint64_t address);
+
+    // position of an entry counted from the ROB head
+    uint32_t rob_age(uint32_t rob_index) {
+        return (rob_index >= ROB.head) ? (rob_index - ROB.head) : (rob_index + ROB.SIZE - ROB.head);
+    };
 
     uint32_t add_to_ifetch_buffer(ooo_model_instr *arch_instr);
     uint32_t add_to_decode_buffer(ooo_model_instr *arch_instr);
 
     uint32_t check_and_add_lsq(uint32_t rob_index);
 
+    uint8_t handle_branch(ooo_model_instr *arch_instr);
+
     // branch predictor
     uint8_t predict_branch(uint64_t ip);
     void    initialize_branch_predictor(),
@@ -222,8 +368,37 @@ public:
     void l1i_prefetcher_cache_fill(uint64_t v_addr, uint32_t set, uint32_t way, uint8_t prefetch, uint64_t evicted_v_addr);
     void l1i_prefetcher_final_stats();
     int prefetch_code_line(uint64_t pf_v_addr);
+
+    // modules picked at run time and the hooks of every linked module, see module_list.h
+    const BRANCH_PREDICTOR_MODULE *branch_predictor_module;
+    const L1I_PREFETCHER_MODULE *l1i_prefetcher_module;
+
+    BRANCH_PREDICTOR_LIST(DECLARE_BRANCH_PREDICTOR)
+    L1I_PREFETCHER_LIST(DECLARE_L1I_PREFETCHER)
+};
+
+class BRANCH_PREDICTOR_MODULE {
+public:
+    const char *name;
+    void (O3_CPU::*initialize)();
+    uint8_t (O3_CPU::*predict)(uint64_t ip);
+    void (O3_CPU::*last_result)(uint64_t ip, uint8_t taken);
 };
 
+class L1I_PREFETCHER_MODULE {
+public:
+    const char *name;
+    void (O3_CPU::*initialize)();
+    void (O3_CPU::*branch_operate)(uint64_t ip, uint8_t branch_type, uint64_t branch_target);
+    void (O3_CPU::*cache_operate)(uint64_t v_addr, uint8_t cache_hit, uint8_t prefetch_hit);
+    void (O3_CPU::*cycle_operate)();
+    void (O3_CPU::*cache_fill)(uint64_t v_addr, uint32_t set, uint32_t way, uint8_t prefetch, uint64_t evicted_v_addr);
+    void (O3_CPU::*final_stats)();
+};
+
+const BRANCH_PREDICTOR_MODULE *find_branch_predictor(const char *name);
+const L1I_PREFETCHER_MODULE *find_l1i_prefetcher(const char *name);
+
 extern O3_CPU ooo_cpu[NUM_CPUS];
 
 #endif
@@ -0,0 +1,91 @@
+#ifndef PAGE_TABLE_H
+#define PAGE_TABLE_H
+
+#include "champsim.h"
+
+#include <vector>
+
+#define ADDRESS_TABLE_EMPTY UINT64_MAX // no page or cache line number reaches this key
+
+// flat hash table keyed by page or cache line number, open addressing with linear probing and backward-shift deletion
+// without values it is a plain set, used for the per-core cache line footprint
+class ADDRESS_TABLE {
+public:
+    uint64_t *key,
+        *value,
+        mask,
+        occupancy;
+
+    uint32_t shift;
+
+    uint8_t has_value;
+
+    // constructor
+    ADDRESS_TABLE(uint8_t v1 = 0, uint32_t log2_size = 16) : has_value(v1) {
+        key = NULL;
+        value = NULL;
+        occupancy = 0;
+        allocate(log2_size);
+    };
+
+    // destructor
+    ~ADDRESS_TABLE() {
+        delete[] key;
+        delete[] value;
+    };
+
+    uint64_t slot(uint64_t k) {
+        return (k * 0x9E3779B97F4A7C15ULL) >> shift;
+    };
+
+    uint64_t size() {
+        return mask + 1;
+    };
+
+    // functions
+    uint64_t *find(uint64_t k);
+    uint8_t  insert(uint64_t k, uint64_t v = 0);
+    void allocate(uint32_t log2_size),
+         erase(uint64_t k);
+};
+
+#if (LOG2_PAGE_SIZE - LOG2_BLOCK_SIZE) > 6
+#error "PAGE_FRAME::resident needs a bit per cache line of a page"
+#endif
+
+// PAGE FRAME
+// one per allocated physical page, page_table and inverse_table map vpages and ppages to frame indices
+class PAGE_FRAME {
+public:
+    uint64_t vpage,
+        ppage,
+        resident; // bit i is set once line i of the page has been filled from DRAM, cleared when the page is swapped
+
+    uint8_t referenced;
+
+    PAGE_FRAME(uint64_t v1, uint64_t v2) : vpage(v1), ppage(v2) {
+        resident = 0;
+        referenced = 1;
+    };
+};
+
+// page swaps pick their victim with a CLOCK sweep over the frames, every translation sets the frame's referenced bit
+class PAGE_FRAMES {
+public:
+    vector<PAGE_FRAME> frame;
+    uint64_t clock_hand;
+
+    PAGE_FRAMES() {
+        clock_hand = 0;
+    };
+
+    // functions
+    uint64_t allocate(uint64_t vpage, uint64_t ppage),
+             find_victim();
+    void mark_resident(uint64_t address);
+};
+
+extern ADDRESS_TABLE page_table, inverse_table, unique_cl[NUM_CPUS];
+extern PAGE_FRAMES page_frames;
+
+#endif
@@ -46,7 +46,7 @@ class fastset {
 
 	// get one of the bits
 
-	bool getbit(TYPE x) {
+	bool getbit(TYPE x) const {
 		int word = x >> 6;
 		int bit = x & 63;
 		return (data.bits[word] >> bit) & 1;
@@ -191,7 +191,7 @@ public:
 	// this set becomes the union of itself and the other set
 	// (call it "join" because "union" is a C++ keyword)
 
-	void join(fastset & other, int n) {
+	void join(const fastset & other, int n) {
 
 		// special rules for special sets
 
@@ -221,45 +221,54 @@ public:
 		for (int i=0; i<lim; i++) data.bits[i] |= other.data.bits[i];
 	}
 
-	// expand the entire set into the array v, returning the cardinality
+	// walks the set in increasing order without copying it out: a small set
+	// is read in place and a bitset one nonzero word at a time, so neither
+	// touches the stack nor looks at empty bits
 
-	int expand(TYPE v[], int n) {
-		if (!card) return 0;
+	class iterator {
+		const fastset
+			&set;
 
-		// a small set can just be copied
+		int
+			n,		// bits at or above n are not part of the set
+			index;		// next small set value or next word of the bitset
 
-		if (card < SMALL_SIZE) {
-			for (int i=0; i<card; i++) v[i] = data.values[i];
-			return card;
-		}
+		unsigned long long int
+			word;		// bits of the current word not returned yet
 
-		// go through the bit array looking for elements
+	public:
 
-		int k = 0;
-		TYPE i;
-		for (i=0; i<n; i+=64) {
+		iterator(const fastset & s, int lim) : set(s), n(lim), index(0), word(0) { }
 
-			// if this 64 bit subset is not empty, copy it into v
+		// store the next member in x, false once the set is exhausted
 
-			if (data.bits[i/64]) {
-				for (TYPE j=0; j<64; j++) {
-					TYPE l = i + j;
-					if (l < n) {
-						if (getbit(l)) v[k++] = l;
-					}
-					else break;
-				}
+		bool next(int & x) {
+			if (set.card < SMALL_SIZE) {
+				if (index >= set.card) return false;
+				x = set.data.values[index++];
+				return true;
 			}
+
+			// skip whole empty words
+
+			while (!word) {
+				if (index * 64 >= n) return false;
+				word = set.data.bits[index++];
+			}
+
+			x = (index - 1) * 64 + __builtin_ctzll(word);
+			word &= word - 1;
+
+			// members come out in order, so nothing past n follows
+			return x < n;
 		}
-		return k;
-	}
+	};
 };
 
-// this little macro iterates over either the whole set or just the single member
+// this little macro iterates over the members of a set, the body may break or continue as usual
 
 #define ITERATE_SET(i,a,n) \
-	TYPE expand_##i[n+1]; \
-	int card_##i = (a).expand (expand_##i, n); \
-	for (int count_##i=0, i=expand_##i[0]; count_##i<card_##i; i=expand_##i[++count_##i])
+	fastset::iterator iterate_##i((a), n); \
+	for (int i; iterate_##i.next(i); )
 
 #endif
@@ -50,11 +50,16 @@
 
 using namespace std;
 
+// kept in their own namespace, kpcp has classes of the same names
+namespace spp {
+
 enum FILTER_REQUEST {
     SPP_L2C_PREFETCH, SPP_LLC_PREFETCH, L2C_DEMAND, L2C_EVICT
 }; // Request type for prefetch filter
 uint64_t get_hash(uint64_t key);
 
+class GLOBAL_REGISTER;
+
 class SIGNATURE_TABLE {
 public:
     bool     valid[ST_SET][ST_WAY];
@@ -64,12 +69,6 @@ public:
         lru[ST_SET][ST_WAY];
 
     SIGNATURE_TABLE() {
-        cout << "Initialize SIGNATURE TABLE" << endl;
-        cout << "ST_SET: " << ST_SET << endl;
-        cout << "ST_WAY: " << ST_WAY << endl;
-        cout << "ST_TAG_BIT: " << ST_TAG_BIT << endl;
-        cout << "ST_TAG_MASK: " << hex << ST_TAG_MASK << dec << endl;
-
         for (uint32_t set = 0; set < ST_SET; set++)
             for (uint32_t way = 0; way < ST_WAY; way++) {
                 valid[set][way] = 0;
@@ -80,7 +79,7 @@ public:
             }
     };
 
-    void read_and_update_sig(uint64_t page, uint32_t page_offset, uint32_t &last_sig, uint32_t &curr_sig, int32_t &delta);
+    void read_and_update_sig(uint64_t page, uint32_t page_offset, uint32_t &last_sig, uint32_t &curr_sig, int32_t &delta, GLOBAL_REGISTER &GHR);
 };
 
 class PATTERN_TABLE {
@@ -90,13 +89,6 @@ public:
         c_sig[PT_SET];
 
     PATTERN_TABLE() {
-        cout << endl << "Initialize PATTERN TABLE" << endl;
-        cout << "PT_SET: " << PT_SET << endl;
-        cout << "PT_WAY: " << PT_WAY << endl;
-        cout << "SIG_DELTA_BIT: " << SIG_DELTA_BIT << endl;
-        cout << "C_SIG_BIT: " << C_SIG_BIT << endl;
-        cout << "C_DELTA_BIT: " << C_DELTA_BIT << endl;
-
         for (uint32_t set = 0; set < PT_SET; set++) {
             for (uint32_t way = 0; way < PT_WAY; way++) {
                 delta[set][way] = 0;
@@ -107,7 +99,7 @@ public:
     }
 
     void update_pattern(uint32_t last_sig, int curr_delta),
-        read_pattern(uint32_t curr_sig, int *prefetch_delta, uint32_t *confidence_q, uint32_t &lookahead_way, uint32_t &lookahead_conf, uint32_t &pf_q_tail, uint32_t &depth);
+        read_pattern(uint32_t curr_sig, int *prefetch_delta, uint32_t *confidence_q, uint32_t &lookahead_way, uint32_t &lookahead_conf, uint32_t &pf_q_tail, uint32_t &depth, GLOBAL_REGISTER &GHR);
 };
 
 class PREFETCH_FILTER {
@@ -117,9 +109,6 @@ public:
         useful[FILTER_SET]; // Consider this as "used"
 
     PREFETCH_FILTER() {
-        cout << endl << "Initialize PREFETCH FILTER" << endl;
-        cout << "FILTER_SET: " << FILTER_SET << endl;
-
         for (uint32_t set = 0; set < FILTER_SET; set++) {
             remainder_tag[set] = 0;
             valid[set] = 0;
@@ -128,7 +117,7 @@ public:
 
     }
 
-    bool     check(uint64_t pf_addr, FILTER_REQUEST filter_request);
+    bool     check(uint64_t pf_addr, FILTER_REQUEST filter_request, GLOBAL_REGISTER &GHR);
 };
 
 class GLOBAL_REGISTER {
@@ -163,4 +152,6 @@ public:
     uint32_t check_entry(uint32_t page_offset);
 };
 
+}
+
 #endif
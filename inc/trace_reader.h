@@ -0,0 +1,183 @@
+#ifndef TRACE_READER_H
+#define TRACE_READER_H
+
+#include "champsim.h"
+#include "compact_trace.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <zlib.h>
+#include <lzma.h>
+
+// TRACE READER
+#define TRACE_BATCH_RECORDS 4096 // instructions decoded per batch
+#define TRACE_RING_BATCHES 4     // batches kept in flight by the decoder thread
+#define TRACE_XZ_INPUT_SIZE (1<<16)
+
+#define TRACE_FORMAT_GZIP 0
+#define TRACE_FORMAT_XZ 1
+#define TRACE_FORMAT_PIPE 2      // remote traces still go through wget | decompressor
+#define TRACE_FORMAT_RAW 3       // uncompressed traces are mapped and read in place
+#define TRACE_FORMAT_COMPACT 4   // mapped compact traces, expanded into the ring
+
+class TRACE_BATCH {
+public:
+    char *data;
+    uint32_t count, // number of complete records in data
+        eof;        // the trace ended after this batch
+
+    TRACE_BATCH() {
+        data = NULL;
+        count = 0;
+        eof = 0;
+    };
+};
+
+// streams fixed-size instruction records out of a trace
+// compressed records are decoded in batches into a ring; with a decoder thread the ring is
+// kept full ahead of the core, otherwise a batch is decoded whenever the ring runs dry
+// uncompressed traces skip the ring and hand out records straight from an mmap of the file
+// compact traces (see compact_trace.h) are mapped as well but expanded through the ring
+class TRACE_READER {
+public:
+    string trace_string;
+    uint32_t format, record_size;
+    uint8_t threaded;
+
+    // decoder state
+    gzFile gz_file;
+    FILE *raw_file;
+    lzma_stream xz_stream;
+    uint8_t *xz_input;
+    uint8_t xz_done;
+    char pipe_command[1024];
+
+    // mapped raw trace
+    char *map_begin, *map_end, *map_cursor;
+    size_t map_size;
+    COMPACT_TRACE_STATE compact_state;
+
+    // instruction ring
+    TRACE_BATCH ring[TRACE_RING_BATCHES];
+    uint32_t ring_head, ring_tail, ring_occupancy; // batches, protected by ring_lock
+
+    // batch being drained by the core, only touched by the reading thread
+    TRACE_BATCH *current;
+    uint32_t read_index;
+
+    // decoder thread
+    thread decoder;
+    mutex ring_lock;
+    condition_variable ring_not_full, ring_not_empty;
+    uint8_t stop_decoder;
+
+    TRACE_READER() {
+        format = TRACE_FORMAT_GZIP;
+        record_size = 0;
+        threaded = 0;
+
+        gz_file = NULL;
+        raw_file = NULL;
+        lzma_stream init = LZMA_STREAM_INIT;
+        xz_stream = init;
+        xz_input = NULL;
+        xz_done = 0;
+        pipe_command[0] = '\0';
+
+        map_begin = NULL;
+        map_end = NULL;
+        map_cursor = NULL;
+        map_size = 0;
+
+        ring_head = 0;
+        ring_tail = 0;
+        ring_occupancy = 0;
+
+        current = NULL;
+        read_index = 0;
+
+        stop_decoder = 0;
+    };
+
+    ~TRACE_READER() {
+        close();
+    };
+
+    // functions
+    void open(const char *name, uint32_t size, uint8_t use_thread),
+         close(),
+         open_stream(),
+         close_stream(),
+         map_trace(),
+         unmap_trace(),
+         decode_batch(TRACE_BATCH *batch),
+         decoder_loop(),
+         acquire_batch(),
+         release_batch();
+
+    size_t read_stream(char *dst, size_t bytes),
+           read_compact(char *dst, size_t bytes);
+
+    // next record, valid until the following call; NULL once at the end of every pass over the trace
+    const char *next_record();
+
+    // copying variant of next_record(), returns 0 at the end of a pass
+    int read(void *dst);
+};
+
+// DECODED INSTRUCTION CACHE
+// keeps the first pass over a trace in its decoded, pre-counted form so that repeated passes
+// skip reading and decoding the trace altogether
+class DECODED_INSTR {
+public:
+    uint64_t ip,
+        branch_target,
+        destination_memory[NUM_INSTR_DESTINATIONS_SPARC],
+        source_memory[NUM_INSTR_SOURCES];
+
+    uint8_t destination_registers[NUM_INSTR_DESTINATIONS_SPARC],
+        source_registers[NUM_INSTR_SOURCES],
+        asid[2],
+        is_branch,
+        branch_taken,
+        branch_type,
+        num_reg_ops,
+        num_mem_ops;
+};
+
+class DECODED_TRACE_CACHE {
+public:
+    DECODED_INSTR *begin;
+    uint64_t capacity, num_instr,
+        pass_start, replay_index, num_replayed;
+    uint8_t recording, replaying;
+    uint32_t cpu;
+
+    DECODED_TRACE_CACHE() {
+        begin = NULL;
+        capacity = 0;
+        num_instr = 0;
+        pass_start = 0;
+        replay_index = 0;
+        num_replayed = 0;
+        recording = 0;
+        replaying = 0;
+        cpu = 0;
+    };
+
+    ~DECODED_TRACE_CACHE() {
+        free(begin);
+    };
+
+    // functions
+    void initialize(uint32_t cpu_num, uint64_t size_mb),
+         record(const ooo_model_instr *arch_instr),
+         abandon();
+
+    // returns 1 when the cache holds the whole trace and replaying starts with the next pass
+    int end_pass(const ooo_model_instr *wrap_instr, uint8_t has_wrap),
+        replay(ooo_model_instr *arch_instr); // returns 0 at the end of a pass
+};
+
+#endif
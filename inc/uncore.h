@@ -8,15 +8,61 @@
 
 //#define DRC_MSHR_SIZE 48
 
+// a core's view of the shared LLC while cores run on worker threads (see core_threads.h)
+// requests are buffered together with the cycle they were issued in and handed to the LLC, in core order,
+// once the uncore is simulated for that cycle; occupancy checks see the LLC as of the last quantum plus
+// this core's own buffered requests
+// request types follow get_occupancy(): 1 RQ, 2 WQ, 3 PQ
+#define PORT_WQ_FULL 4 // replays increment_WQ_FULL()
+
+class PORT_REQUEST {
+public:
+    uint8_t type;
+    uint64_t cycle;
+    PACKET packet;
+};
+
+class UNCORE_PORT : public MEMORY {
+public:
+    MEMORY *target;
+    uint32_t cpu;
+    deque <PORT_REQUEST> pending;
+    uint32_t num_pending[PORT_WQ_FULL+1];
+
+    UNCORE_PORT() {
+        target = NULL;
+        cpu = 0;
+        for (uint32_t i=0; i<=PORT_WQ_FULL; i++)
+            num_pending[i] = 0;
+    };
+
+    // functions
+    int  add_rq(PACKET *packet),
+        add_wq(PACKET *packet),
+        add_pq(PACKET *packet),
+        buffer(uint8_t type, PACKET *packet);
+
+    void return_data(PACKET *packet),
+        operate(),
+        increment_WQ_FULL(uint64_t address),
+        drain(uint64_t cycle);
+
+    uint32_t get_occupancy(uint8_t queue_type, uint64_t address),
+        get_size(uint8_t queue_type, uint64_t address);
+};
+
 // uncore
 class UNCORE {
 public:
 
+    // backs the LLC and DRAM queues, declared before them so it is torn down after them
+    ARENA arena;
+
     // LLC
-    CACHE LLC{ "LLC", LLC_SET, LLC_WAY, LLC_SET*LLC_WAY, LLC_WQ_SIZE, LLC_RQ_SIZE, LLC_PQ_SIZE, LLC_MSHR_SIZE };
+    CACHE LLC{ "LLC", LLC_SET, LLC_WAY, LLC_SET*LLC_WAY, LLC_WQ_SIZE, LLC_RQ_SIZE, LLC_PQ_SIZE, LLC_MSHR_SIZE, arena };
 
     // DRAM
-    MEMORY_CONTROLLER DRAM{ "DRAM" };
+    MEMORY_CONTROLLER DRAM{ "DRAM", arena };
 
     UNCORE();
 };
@@ -1,4 +1,5 @@
-#include "cache.h"
+#define L1D_PREFETCHER next_line
+#include "module.h"
 
 void CACHE::l1d_prefetcher_initialize() 
 {
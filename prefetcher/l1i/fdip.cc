@@ -0,0 +1,82 @@
+#define L1I_PREFETCHER fdip
+#include "module.h"
+
+// fetch directed instruction prefetching: prefetches the cache line of every block the branch predictor has
+// queued in the fetch target queue, oldest first, needs the decoupled front end (-ftq_size)
+#define FDIP_DEGREE 2 // blocks prefetched per cycle
+namespace {
+uint64_t fdip_last_line[NUM_CPUS], // line of the last block prefetched, consecutive blocks often share it
+    fdip_prefetched[NUM_CPUS],
+    fdip_skipped[NUM_CPUS];
+}
+
+void O3_CPU::l1i_prefetcher_initialize()
+{
+    cout << "CPU " << cpu << " L1I FDIP prefetcher";
+    if (ftq.SIZE == 0)
+        cout << " (no fetch target queue, -ftq_size is not set)";
+    cout << endl;
+
+    // idle cycle skipping waits for this prefetcher to act on every queued block
+    ftq.prefetcher = 1;
+
+    fdip_last_line[cpu] = 0;
+    fdip_prefetched[cpu] = 0;
+    fdip_skipped[cpu] = 0;
+}
+
+void O3_CPU::l1i_prefetcher_branch_operate(uint64_t ip, uint8_t branch_type, uint64_t branch_target)
+{
+
+}
+
+void O3_CPU::l1i_prefetcher_cache_operate(uint64_t v_addr, uint8_t cache_hit, uint8_t prefetch_hit)
+{
+
+}
+
+void O3_CPU::l1i_prefetcher_cycle_operate()
+{
+    uint32_t issued = 0;
+    for (uint32_t i=0; i<ftq.occupancy; i++) {
+        FTQ_BLOCK *block = ftq.at(i);
+        if (block->prefetched)
+            continue;
+
+        // the oldest block is already being fetched
+        if ((i == 0) && block->next_fetch) {
+            block->prefetched = 1;
+            continue;
+        }
+
+        uint64_t line = block->ip >> LOG2_BLOCK_SIZE;
+        if (line == fdip_last_line[cpu]) {
+            block->prefetched = 1;
+            fdip_skipped[cpu]++;
+            continue;
+        }
+
+        if ((issued == FDIP_DEGREE) || (L1I.MSHR.occupancy >= (L1I.MSHR.SIZE>>1)))
+            break;
+
+        // the prefetch queue is full, try again next cycle
+        if (prefetch_code_line(line << LOG2_BLOCK_SIZE) == 0)
+            break;
+
+        block->prefetched = 1;
+        fdip_last_line[cpu] = line;
+        fdip_prefetched[cpu]++;
+        issued++;
+    }
+}
+
+void O3_CPU::l1i_prefetcher_cache_fill(uint64_t v_addr, uint32_t set, uint32_t way, uint8_t prefetch, uint64_t evicted_v_addr)
+{
+
+}
+
+void O3_CPU::l1i_prefetcher_final_stats()
+{
+    cout << "CPU " << cpu << " L1I FDIP prefetcher final stats" << endl;
+    cout << "Fetch blocks prefetched: " << fdip_prefetched[cpu] << " same line as the previous block: " << fdip_skipped[cpu] << endl;
+}
@@ -1,4 +1,5 @@
-#include "ooo_cpu.h"
+#define L1I_PREFETCHER no
+#include "module.h"
 
 void O3_CPU::l1i_prefetcher_initialize() 
 {
@@ -13,11 +13,13 @@
 
  */
 
-#include "cache.h"
+#define L2C_PREFETCHER ip_stride
+#include "module.h"
 
 #define IP_TRACKER_COUNT 1024
 #define PREFETCH_DEGREE 3
 
+namespace {
 class IP_TRACKER {
   public:
     // the IP we're tracking
@@ -40,13 +42,14 @@ class IP_TRACKER {
     };
 };
 
-IP_TRACKER trackers[IP_TRACKER_COUNT];
+IP_TRACKER trackers[NUM_CPUS][IP_TRACKER_COUNT];
+}
 
 void CACHE::l2c_prefetcher_initialize() 
 {
     cout << "CPU " << cpu << " L2C IP-based stride prefetcher" << endl;
     for (int i=0; i<IP_TRACKER_COUNT; i++)
-        trackers[i].lru = i;
+        trackers[cpu][i].lru = i;
 }
 
 uint32_t CACHE::l2c_prefetcher_operate(uint64_t addr, uint64_t ip, uint8_t cache_hit, uint8_t type, uint32_t metadata_in)
@@ -56,7 +59,7 @@ uint32_t CACHE::l2c_prefetcher_operate(uint64_t addr, uint64_t ip, uint8_t cache
 
     int index = -1;
     for (index=0; index<IP_TRACKER_COUNT; index++) {
-        if (trackers[index].ip == ip)
+        if (trackers[cpu][index].ip == ip)
             break;
     }
 
@@ -64,21 +67,21 @@ uint32_t CACHE::l2c_prefetcher_operate(uint64_t addr, uint64_t ip, uint8_t cache
     if (index == IP_TRACKER_COUNT) {
 
         for (index=0; index<IP_TRACKER_COUNT; index++) {
-            if (trackers[index].lru == (IP_TRACKER_COUNT-1))
+            if (trackers[cpu][index].lru == (IP_TRACKER_COUNT-1))
                 break;
         }
 
-        trackers[index].ip = ip;
-        trackers[index].last_cl_addr = cl_addr;
-        trackers[index].last_stride = 0;
+        trackers[cpu][index].ip = ip;
+        trackers[cpu][index].last_cl_addr = cl_addr;
+        trackers[cpu][index].last_stride = 0;
 
-        //cout << "[IP_STRIDE] MISS index: " << index << " lru: " << trackers[index].lru << " ip: " << hex << ip << " cl_addr: " << cl_addr << dec << endl;
+        //cout << "[IP_STRIDE] MISS index: " << index << " lru: " << trackers[cpu][index].lru << " ip: " << hex << ip << " cl_addr: " << cl_addr << dec << endl;
 
         for (int i=0; i<IP_TRACKER_COUNT; i++) {
-            if (trackers[i].lru < trackers[index].lru)
-                trackers[i].lru++;
+            if (trackers[cpu][i].lru < trackers[cpu][index].lru)
+                trackers[cpu][i].lru++;
         }
-        trackers[index].lru = 0;
+        trackers[cpu][index].lru = 0;
 
         return metadata_in;
     }
@@ -92,14 +95,14 @@ uint32_t CACHE::l2c_prefetcher_operate(uint64_t addr, uint64_t ip, uint8_t cache
     // this bit appears overly complicated because we're calculating
     // differences between unsigned address variables
     int64_t stride = 0;
-    if (cl_addr > trackers[index].last_cl_addr)
-        stride = cl_addr - trackers[index].last_cl_addr;
+    if (cl_addr > trackers[cpu][index].last_cl_addr)
+        stride = cl_addr - trackers[cpu][index].last_cl_addr;
     else {
-        stride = trackers[index].last_cl_addr - cl_addr;
+        stride = trackers[cpu][index].last_cl_addr - cl_addr;
         stride *= -1;
     }
 
-    //cout << "[IP_STRIDE] HIT  index: " << index << " lru: " << trackers[index].lru << " ip: " << hex << ip << " cl_addr: " << cl_addr << dec << " stride: " << stride << endl;
+    //cout << "[IP_STRIDE] HIT  index: " << index << " lru: " << trackers[cpu][index].lru << " ip: " << hex << ip << " cl_addr: " << cl_addr << dec << " stride: " << stride << endl;
 
     // don't do anything if we somehow saw the same address twice in a row
     if (stride == 0)
@@ -107,7 +110,7 @@ uint32_t CACHE::l2c_prefetcher_operate(uint64_t addr, uint64_t ip, uint8_t cache
 
     // only do any prefetching if there's a pattern of seeing the same
     // stride more than once
-    if (stride == trackers[index].last_stride) {
+    if (stride == trackers[cpu][index].last_stride) {
 
         // do some prefetching
         for (int i=0; i<PREFETCH_DEGREE; i++) {
@@ -126,14 +129,14 @@ uint32_t CACHE::l2c_prefetcher_operate(uint64_t addr, uint64_t ip, uint8_t cache
         }
     }
 
-    trackers[index].last_cl_addr = cl_addr;
-    trackers[index].last_stride = stride;
+    trackers[cpu][index].last_cl_addr = cl_addr;
+    trackers[cpu][index].last_stride = stride;
 
     for (int i=0; i<IP_TRACKER_COUNT; i++) {
-        if (trackers[i].lru < trackers[index].lru)
-            trackers[i].lru++;
+        if (trackers[cpu][i].lru < trackers[cpu][index].lru)
+            trackers[cpu][i].lru++;
     }
-    trackers[index].lru = 0;
+    trackers[cpu][index].lru = 0;
 
     return metadata_in;
 }
@@ -1,8 +1,11 @@
 // Note that some variables and functions are defined at kpcp_util.cc
 
-#include "cache.h"
+#define L2C_PREFETCHER kpcp
+#include "module.h"
 #include "kpcp.h"
 
+using namespace kpcp;
+
 #define PF_THRESHOLD 25
 #define FILL_THRESHOLD 75
 #define LOOKAHEAD_ON
@@ -20,9 +23,10 @@ int L2_PT_access[NUM_CPUS], L2_PT_hit[NUM_CPUS], L2_PT_invalid[NUM_CPUS], L2_PT_
 int l2_sig_dist[NUM_CPUS][1<<SIG_LENGTH];
 */
 
+namespace {
 int num_pf[NUM_CPUS], curr_conf[NUM_CPUS], curr_delta[NUM_CPUS], MAX_CONF[NUM_CPUS];
 int out_of_page[NUM_CPUS], not_enough_conf[NUM_CPUS];
-int pf_delta[NUM_CPUS][L2C_MSHR_SIZE], PF_inflight[NUM_CPUS];
+int PF_inflight[NUM_CPUS];
 int spp_pf_issued[NUM_CPUS], spp_pf_useful[NUM_CPUS], spp_pf_useless[NUM_CPUS];
 int useful_depth[NUM_CPUS][L2C_MSHR_SIZE], useless_depth[NUM_CPUS][L2C_MSHR_SIZE];
 int conf_counter[NUM_CPUS];
@@ -45,6 +49,7 @@ class PF_buffer {
     };
 };
 PF_buffer pf_buffer[NUM_CPUS][L2C_MSHR_SIZE];
+}
 
 void CACHE::l2c_prefetcher_initialize() 
 {
@@ -70,6 +75,8 @@ void CACHE::l2c_prefetcher_initialize()
     conf_counter[cpu] = 0;
 }
 
+namespace {
+#ifdef L2_GHR_ON
 void GHR_update(uint32_t cpu, int signature, int path_conf, int last_block, int oop_delta)
 {
     int match;
@@ -131,6 +138,7 @@ void GHR_update(uint32_t cpu, int signature, int path_conf, int last_block, int
 
     return;
 }
+#endif
 
 int check_same_page(int curr_block, int delta)
 {
@@ -312,6 +320,7 @@ int PF_check(uint32_t cpu, int signature, int curr_block)
 
     return 0;
 }
+}
 
 // defined at kpcp_util.cc
 /*
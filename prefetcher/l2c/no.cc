@@ -1,4 +1,5 @@
-#include "cache.h"
+#define L2C_PREFETCHER no
+#include "module.h"
 
 void CACHE::l2c_prefetcher_initialize() 
 {
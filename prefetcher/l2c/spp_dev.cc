@@ -1,14 +1,38 @@
-#include "cache.h"
+#define L2C_PREFETCHER spp_dev
+#include "module.h"
 #include "spp_dev.h"
 
-SIGNATURE_TABLE ST;
-PATTERN_TABLE   PT;
-PREFETCH_FILTER FILTER;
-GLOBAL_REGISTER GHR;
+using namespace spp;
+
+namespace {
+// one set of tables per core, each L2C is private and may run on its own thread with -core_threads
+SIGNATURE_TABLE ST[NUM_CPUS];
+PATTERN_TABLE   PT[NUM_CPUS];
+PREFETCH_FILTER FILTER[NUM_CPUS];
+GLOBAL_REGISTER GHR[NUM_CPUS];
+}
 
 void CACHE::l2c_prefetcher_initialize() 
 {
-
+    // the tables are built before main(), so they are only described here, once
+    if (cpu)
+        return;
+
+    cout << "Initialize SIGNATURE TABLE" << endl;
+    cout << "ST_SET: " << ST_SET << endl;
+    cout << "ST_WAY: " << ST_WAY << endl;
+    cout << "ST_TAG_BIT: " << ST_TAG_BIT << endl;
+    cout << "ST_TAG_MASK: " << hex << ST_TAG_MASK << dec << endl;
+
+    cout << endl << "Initialize PATTERN TABLE" << endl;
+    cout << "PT_SET: " << PT_SET << endl;
+    cout << "PT_WAY: " << PT_WAY << endl;
+    cout << "SIG_DELTA_BIT: " << SIG_DELTA_BIT << endl;
+    cout << "C_SIG_BIT: " << C_SIG_BIT << endl;
+    cout << "C_DELTA_BIT: " << C_DELTA_BIT << endl;
+
+    cout << endl << "Initialize PREFETCH FILTER" << endl;
+    cout << "FILTER_SET: " << FILTER_SET << endl;
 }
 
 uint32_t CACHE::l2c_prefetcher_operate(uint64_t addr, uint64_t ip, uint8_t cache_hit, uint8_t type, uint32_t metadata_in)
@@ -28,7 +52,7 @@ uint32_t CACHE::l2c_prefetcher_operate(uint64_t addr, uint64_t ip, uint8_t cache
         delta_q[i] = 0;
     }
     confidence_q[0] = 100;
-    GHR.global_accuracy = GHR.pf_issued ? ((100 * GHR.pf_useful) / GHR.pf_issued)  : 0;
+    GHR[cpu].global_accuracy = GHR[cpu].pf_issued ? ((100 * GHR[cpu].pf_useful) / GHR[cpu].pf_issued)  : 0;
     
     SPP_DP (
         cout << endl << "[ChampSim] " << __func__ << " addr: " << hex << addr << " cache_line: " << (addr >> LOG2_BLOCK_SIZE);
@@ -38,13 +62,13 @@ uint32_t CACHE::l2c_prefetcher_operate(uint64_t addr, uint64_t ip, uint8_t cache
     // Stage 1: Read and update a sig stored in ST
     // last_sig and delta are used to update (sig, delta) correlation in PT
     // curr_sig is used to read prefetch candidates in PT 
-    ST.read_and_update_sig(page, page_offset, last_sig, curr_sig, delta);
+    ST[cpu].read_and_update_sig(page, page_offset, last_sig, curr_sig, delta, GHR[cpu]);
 
     // Also check the prefetch filter in parallel to update global accuracy counters 
-    FILTER.check(addr, L2C_DEMAND); 
+    FILTER[cpu].check(addr, L2C_DEMAND, GHR[cpu]); 
 
     // Stage 2: Update delta patterns stored in PT
-    if (last_sig) PT.update_pattern(last_sig, delta);
+    if (last_sig) PT[cpu].update_pattern(last_sig, delta);
 
     // Stage 3: Start prefetching
     uint64_t base_addr = addr;
@@ -57,7 +81,7 @@ uint32_t CACHE::l2c_prefetcher_operate(uint64_t addr, uint64_t ip, uint8_t cache
     do {
 #endif
         uint32_t lookahead_way = PT_WAY;
-        PT.read_pattern(curr_sig, delta_q, confidence_q, lookahead_way, lookahead_conf, pf_q_tail, depth);
+        PT[cpu].read_pattern(curr_sig, delta_q, confidence_q, lookahead_way, lookahead_conf, pf_q_tail, depth, GHR[cpu]);
 
         do_lookahead = 0;
         for (uint32_t i = pf_q_head; i < pf_q_tail; i++) {
@@ -65,16 +89,16 @@ uint32_t CACHE::l2c_prefetcher_operate(uint64_t addr, uint64_t ip, uint8_t cache
                 uint64_t pf_addr = (base_addr & ~(BLOCK_SIZE - 1)) + (delta_q[i] << LOG2_BLOCK_SIZE);
 
                 if ((addr & ~(PAGE_SIZE - 1)) == (pf_addr & ~(PAGE_SIZE - 1))) { // Prefetch request is in the same physical page
-                    if (FILTER.check(pf_addr, ((confidence_q[i] >= FILL_THRESHOLD) ? SPP_L2C_PREFETCH : SPP_LLC_PREFETCH))) {
+                    if (FILTER[cpu].check(pf_addr, ((confidence_q[i] >= FILL_THRESHOLD) ? SPP_L2C_PREFETCH : SPP_LLC_PREFETCH), GHR[cpu])) {
 		      prefetch_line(ip, addr, pf_addr, ((confidence_q[i] >= FILL_THRESHOLD) ? FILL_L2 : FILL_LLC), 0); // Use addr (not base_addr) to obey the same physical page boundary
 
                         if (confidence_q[i] >= FILL_THRESHOLD) {
-                            GHR.pf_issued++;
-                            if (GHR.pf_issued > GLOBAL_COUNTER_MAX) {
-                                GHR.pf_issued >>= 1;
-                                GHR.pf_useful >>= 1;
+                            GHR[cpu].pf_issued++;
+                            if (GHR[cpu].pf_issued > GLOBAL_COUNTER_MAX) {
+                                GHR[cpu].pf_issued >>= 1;
+                                GHR[cpu].pf_useful >>= 1;
                             }
-                            SPP_DP (cout << "[ChampSim] SPP L2 prefetch issued GHR.pf_issued: " << GHR.pf_issued << " GHR.pf_useful: " << GHR.pf_useful << endl;);
+                            SPP_DP (cout << "[ChampSim] SPP L2 prefetch issued GHR.pf_issued: " << GHR[cpu].pf_issued << " GHR.pf_useful: " << GHR[cpu].pf_useful << endl;);
                         }
 
                         SPP_DP (
@@ -87,7 +111,7 @@ uint32_t CACHE::l2c_prefetcher_operate(uint64_t addr, uint64_t ip, uint8_t cache
                 } else { // Prefetch request is crossing the physical page boundary
 #ifdef GHR_ON
                     // Store this prefetch request in GHR to bootstrap SPP learning when we see a ST miss (i.e., accessing a new page)
-                    GHR.update_entry(curr_sig, confidence_q[i], (pf_addr >> LOG2_BLOCK_SIZE) & 0x3F, delta_q[i]); 
+                    GHR[cpu].update_entry(curr_sig, confidence_q[i], (pf_addr >> LOG2_BLOCK_SIZE) & 0x3F, delta_q[i]); 
 #endif
                 }
 
@@ -99,11 +123,11 @@ uint32_t CACHE::l2c_prefetcher_operate(uint64_t addr, uint64_t ip, uint8_t cache
         // Update base_addr and curr_sig
         if (lookahead_way < PT_WAY) {
             uint32_t set = get_hash(curr_sig) % PT_SET;
-            base_addr += (PT.delta[set][lookahead_way] << LOG2_BLOCK_SIZE);
+            base_addr += (PT[cpu].delta[set][lookahead_way] << LOG2_BLOCK_SIZE);
 
             // PT.delta uses a 7-bit sign magnitude representation to generate sig_delta
             //int sig_delta = (PT.delta[set][lookahead_way] < 0) ? ((((-1) * PT.delta[set][lookahead_way]) & 0x3F) + 0x40) : PT.delta[set][lookahead_way];
-            int sig_delta = (PT.delta[set][lookahead_way] < 0) ? (((-1) * PT.delta[set][lookahead_way]) + (1 << (SIG_DELTA_BIT - 1))) : PT.delta[set][lookahead_way];
+            int sig_delta = (PT[cpu].delta[set][lookahead_way] < 0) ? (((-1) * PT[cpu].delta[set][lookahead_way]) + (1 << (SIG_DELTA_BIT - 1))) : PT[cpu].delta[set][lookahead_way];
             curr_sig = ((curr_sig << SIG_SHIFT) ^ sig_delta) & SIG_MASK;
         }
 
@@ -122,7 +146,7 @@ uint32_t CACHE::l2c_prefetcher_cache_fill(uint64_t addr, uint32_t set, uint32_t
 {
 #ifdef FILTER_ON
     SPP_DP (cout << endl;);
-    FILTER.check(evicted_addr, L2C_EVICT);
+    FILTER[cpu].check(evicted_addr, L2C_EVICT, GHR[cpu]);
 #endif
 
     return metadata_in;
@@ -133,6 +157,8 @@ void CACHE::l2c_prefetcher_final_stats()
 
 }
 
+namespace spp {
+
 // TODO: Find a good 64-bit hash function
 uint64_t get_hash(uint64_t key)
 {
@@ -152,7 +178,7 @@ uint64_t get_hash(uint64_t key)
     return key;
 }
 
-void SIGNATURE_TABLE::read_and_update_sig(uint64_t page, uint32_t page_offset, uint32_t &last_sig, uint32_t &curr_sig, int32_t &delta)
+void SIGNATURE_TABLE::read_and_update_sig(uint64_t page, uint32_t page_offset, uint32_t &last_sig, uint32_t &curr_sig, int32_t &delta, GLOBAL_REGISTER &GHR)
 {
     uint32_t set = get_hash(page) % ST_SET,
              match = ST_WAY,
@@ -328,7 +354,7 @@ void PATTERN_TABLE::update_pattern(uint32_t last_sig, int curr_delta)
     }
 }
 
-void PATTERN_TABLE::read_pattern(uint32_t curr_sig, int *delta_q, uint32_t *confidence_q, uint32_t &lookahead_way, uint32_t &lookahead_conf, uint32_t &pf_q_tail, uint32_t &depth)
+void PATTERN_TABLE::read_pattern(uint32_t curr_sig, int *delta_q, uint32_t *confidence_q, uint32_t &lookahead_way, uint32_t &lookahead_conf, uint32_t &pf_q_tail, uint32_t &depth, GLOBAL_REGISTER &GHR)
 {
     // Update (sig, delta) correlation
     uint32_t set = get_hash(curr_sig) % PT_SET,
@@ -372,7 +398,7 @@ void PATTERN_TABLE::read_pattern(uint32_t curr_sig, int *delta_q, uint32_t *conf
     } else confidence_q[pf_q_tail] = 0;
 }
 
-bool PREFETCH_FILTER::check(uint64_t check_addr, FILTER_REQUEST filter_request)
+bool PREFETCH_FILTER::check(uint64_t check_addr, FILTER_REQUEST filter_request, GLOBAL_REGISTER &GHR)
 {
     uint64_t cache_line = check_addr >> LOG2_BLOCK_SIZE,
              hash = get_hash(cache_line),
@@ -529,3 +555,5 @@ uint32_t GLOBAL_REGISTER::check_entry(uint32_t page_offset)
 
     return max_conf_way;
 }
+
+}
@@ -1,4 +1,5 @@
-#include "cache.h"
+#define LLC_PREFETCHER next_line
+#include "module.h"
 
 void CACHE::llc_prefetcher_initialize() 
 {
@@ -1,4 +1,5 @@
-#include "cache.h"
+#define LLC_PREFETCHER no
+#include "module.h"
 
 void CACHE::llc_prefetcher_initialize() 
 {
@@ -1,4 +1,5 @@
-#include "cache.h"
+#define LLC_REPLACEMENT drrip
+#include "module.h"
 
 #define maxRRPV 3
 #define NUM_POLICY 2
@@ -9,10 +10,12 @@
 #define PSEL_MAX ((1<<PSEL_WIDTH)-1)
 #define PSEL_THRS PSEL_MAX/2
 
+namespace {
 uint32_t rrpv[LLC_SET][LLC_WAY],
          bip_counter = 0,
          PSEL[NUM_CPUS];
 unsigned rand_sets[TOTAL_SDM_SETS];
+}
 
 void CACHE::llc_initialize_replacement()
 {
@@ -49,6 +52,7 @@ void CACHE::llc_initialize_replacement()
         PSEL[i] = 0;
 }
 
+namespace {
 int is_it_leader(uint32_t cpu, uint32_t set)
 {
     uint32_t start = cpu * NUM_POLICY * SDM_SIZE,
@@ -60,6 +64,7 @@ int is_it_leader(uint32_t cpu, uint32_t set)
 
     return -1;
 }
+}
 
 // called on every cache hit and cache fill
 void CACHE::llc_update_replacement_state(uint32_t cpu, uint32_t set, uint32_t way, uint64_t full_addr, uint64_t ip, uint64_t victim_addr, uint32_t type, uint8_t hit)
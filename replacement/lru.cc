@@ -1,4 +1,5 @@
-#include "cache.h"
+#define LLC_REPLACEMENT lru
+#include "module.h"
 
 // initialize replacement state
 void CACHE::llc_initialize_replacement()
@@ -1,4 +1,5 @@
-#include "cache.h"
+#define LLC_REPLACEMENT ship
+#include "module.h"
 #include <cstdlib>
 #include <ctime>
 
@@ -9,6 +10,7 @@
 #define SAMPLER_WAY LLC_WAY
 #define SHCT_MAX 7
 
+namespace {
 uint32_t rrpv[LLC_SET][LLC_WAY];
 
 // sampler structure
@@ -50,6 +52,7 @@ class SHCT_class {
     };
 };
 SHCT_class SHCT[NUM_CPUS][SHCT_SIZE];
+}
 
 // initialize replacement state
 void CACHE::llc_initialize_replacement()
@@ -96,6 +99,7 @@ void CACHE::llc_initialize_replacement()
     }
 }
 
+namespace {
 // check if this set is sampled
 uint32_t is_it_sampled(uint32_t set)
 {
@@ -199,6 +203,7 @@ void update_sampler(uint32_t cpu, uint32_t s_idx, uint64_t address, uint64_t ip,
     }
     s_set[match].lru = 0;
 }
+}
 
 // find replacement victim
 uint32_t CACHE::llc_find_victim(uint32_t cpu, uint64_t instr_id, uint32_t set, const BLOCK *current_set, uint64_t ip, uint64_t full_addr, uint32_t type)
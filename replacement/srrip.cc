@@ -1,7 +1,10 @@
-#include "cache.h"
+#define LLC_REPLACEMENT srrip
+#include "module.h"
 
 #define maxRRPV 3
+namespace {
 uint32_t rrpv[LLC_SET][LLC_WAY];
+}
 
 // initialize replacement state
 void CACHE::llc_initialize_replacement()
@@ -0,0 +1,70 @@
+// Converts a ChampSim (or CloudSuite) trace into the compact format read natively by ChampSim
+//
+// build: make compactor
+// usage: bin/trace_compactor [-cloudsuite] <input trace (.gz, .xz or uncompressed)> <output trace>
+//
+// the output is recognized by its header, any extension not starting with 'g' or 'x' works (e.g. .cmp)
+
+#include "trace_reader.h"
+
+template <class T>
+int convert(TRACE_READER &input, FILE *output)
+{
+    char header[COMPACT_TRACE_HEADER_SIZE];
+    uint32_t record_size = sizeof(T), reserved = 0;
+    memcpy(header, COMPACT_TRACE_MAGIC, 8);
+    memcpy(header + 8, &record_size, sizeof(record_size));
+    memcpy(header + 12, &reserved, sizeof(reserved));
+    fwrite(header, 1, COMPACT_TRACE_HEADER_SIZE, output);
+
+    COMPACT_TRACE_STATE state;
+    T instr;
+    uint8_t record[COMPACT_MAX_RECORD_SIZE];
+    uint64_t num_records = 0, compact_bytes = COMPACT_TRACE_HEADER_SIZE;
+
+    while (input.read(&instr)) {
+        uint8_t *end = encode_compact_record(record, &instr, &state);
+        fwrite(record, 1, end - record, output);
+
+        num_records++;
+        compact_bytes += end - record;
+    }
+
+    printf("Records: %lu Original: %lu bytes Compact: %lu bytes (%.2fx)\n", num_records, num_records*sizeof(T), compact_bytes,
+        compact_bytes ? (1.0*num_records*sizeof(T)) / compact_bytes : 0);
+
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    int cloudsuite = 0, arg = 1;
+    if ((argc > 1) && (string(argv[1]) == "-cloudsuite")) {
+        cloudsuite = 1;
+        arg++;
+    }
+
+    if (argc - arg != 2) {
+        fprintf(stderr, "usage: %s [-cloudsuite] <input trace> <output trace>\n", argv[0]);
+        return 1;
+    }
+
+    string input_name(argv[arg]), output_name(argv[arg+1]);
+
+    // the input is read and decompressed in-process by the same reader as ChampSim, one pass, without a decoder thread
+    TRACE_READER input;
+    input.open(input_name.c_str(), cloudsuite ? sizeof(cloudsuite_instr) : sizeof(input_instr), 0);
+
+    FILE *output = fopen(output_name.c_str(), "wb");
+    if (output == NULL) {
+        fprintf(stderr, "*** CANNOT OPEN OUTPUT TRACE: %s ***\n", output_name.c_str());
+        return 1;
+    }
+
+    int ret = cloudsuite ? convert<cloudsuite_instr>(input, output) : convert<input_instr>(input, output);
+
+    input.close();
+    fclose(output);
+
+    return ret;
+}
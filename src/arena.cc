@@ -0,0 +1,88 @@
+#include "arena.h"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+void *ARENA::reserve(size_t bytes)
+{
+    bytes = (bytes + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if ((size_t)(end - next) < bytes)
+        map_region(bytes);
+
+    void *base = next;
+    next += bytes;
+
+    return base;
+}
+
+// what is left of the current region is abandoned, a region is only ever outgrown by a very large cache
+void ARENA::map_region(size_t bytes)
+{
+    size_t size = (bytes + ARENA_HUGE_PAGE - 1) & ~(size_t)(ARENA_HUGE_PAGE - 1);
+    if (size < ARENA_REGION_SIZE)
+        size = ARENA_REGION_SIZE;
+
+    // over-map by a huge page and trim both ends so the region starts on a huge page boundary
+    char *mapped = (char *)mmap(NULL, size + ARENA_HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED) {
+        cerr << "[ARENA] " << __func__ << " cannot map " << size << " bytes" << endl;
+        assert(0);
+    }
+
+    char *base = (char *)(((uintptr_t)mapped + ARENA_HUGE_PAGE - 1) & ~(uintptr_t)(ARENA_HUGE_PAGE - 1));
+    if (base > mapped)
+        munmap(mapped, base - mapped);
+    if (mapped + size + ARENA_HUGE_PAGE > base + size)
+        munmap(base + size, (mapped + size + ARENA_HUGE_PAGE) - (base + size));
+
+    // only a hint, the arena works the same on small pages
+    madvise(base, size, MADV_HUGEPAGE);
+
+    region.push_back(base);
+    region_size.push_back(size);
+    next = base;
+    end = base + size;
+
+    if (node >= 0)
+        bind_region(region.size() - 1);
+}
+
+void ARENA::bind_region(uint32_t index)
+{
+    unsigned long nodemask[16] = { 0 };
+    if ((uint32_t)node >= 8*sizeof(nodemask))
+        return;
+    nodemask[node / (8*sizeof(unsigned long))] |= 1UL << (node % (8*sizeof(unsigned long)));
+
+    // best effort, a kernel or container without NUMA support leaves the pages where they are
+    syscall(SYS_mbind, region[index], region_size[index], MPOL_PREFERRED, nodemask, 8*sizeof(nodemask), MPOL_MF_MOVE);
+}
+
+// moves the regions to the memory node of the calling thread, called by the thread that simulates the owner once it
+// is pinned to a host CPU
+void ARENA::bind_local()
+{
+    unsigned cpu_id = 0, node_id = 0;
+    if (syscall(SYS_getcpu, &cpu_id, &node_id, NULL) != 0)
+        return;
+
+    node = node_id;
+    for (uint32_t i=0; i<region.size(); i++)
+        bind_region(i);
+}
+
+void ARENA::release()
+{
+    for (size_t i=destructor.size(); i>0; i--)
+        destructor[i-1].destroy(destructor[i-1].base, destructor[i-1].count);
+    destructor.clear();
+
+    for (uint32_t i=0; i<region.size(); i++)
+        munmap(region[i], region_size[i]);
+    region.clear();
+    region_size.clear();
+
+    next = NULL;
+    end = NULL;
+}
@@ -0,0 +1,357 @@
+#include "batch.h"
+#include "ooo_cpu.h"
+#include "uncore.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+BATCH_DRIVER batch;
+
+void BATCH_DEQUE::assign(uint32_t head, uint32_t tail)
+{
+    range = ((uint64_t)head << 32) | tail;
+}
+
+int BATCH_DEQUE::pop_front()
+{
+    uint64_t current = range.load();
+    while (1) {
+        uint32_t head = current >> 32, tail = (uint32_t)current;
+        if (head >= tail)
+            return -1;
+
+        if (range.compare_exchange_weak(current, ((uint64_t)(head+1) << 32) | tail))
+            return head;
+    }
+}
+
+int BATCH_DEQUE::steal_back()
+{
+    uint64_t current = range.load();
+    while (1) {
+        uint32_t head = current >> 32, tail = (uint32_t)current;
+        if (head >= tail)
+            return -1;
+
+        if (range.compare_exchange_weak(current, ((uint64_t)head << 32) | (tail-1)))
+            return tail-1;
+    }
+}
+
+void BATCH_DRIVER::parse_manifest(const char *manifest)
+{
+    ifstream input(manifest);
+    if (!input.good()) {
+        cerr << "[BATCH] cannot open job manifest " << manifest << endl;
+        assert(0);
+    }
+
+    string line;
+    uint32_t line_number = 0;
+    while (getline(input, line)) {
+        line_number++;
+
+        size_t comment = line.find('#');
+        if (comment != string::npos)
+            line.erase(comment);
+
+        istringstream tokens(line);
+        BATCH_JOB job;
+        if (!(tokens >> job.name))
+            continue;
+
+        string arg;
+        while (tokens >> arg)
+            job.args.push_back(arg);
+
+        if (find(job.args.begin(), job.args.end(), string("-traces")) == job.args.end()) {
+            cerr << "[BATCH] " << manifest << ":" << line_number << " job " << job.name << " has no -traces" << endl;
+            assert(0);
+        }
+
+        for (uint32_t i=0; i<jobs.size(); i++) {
+            if (jobs[i].name == job.name) {
+                cerr << "[BATCH] " << manifest << ":" << line_number << " job name " << job.name << " is used twice" << endl;
+                assert(0);
+            }
+        }
+
+        jobs.push_back(job);
+    }
+}
+
+int BATCH_DRIVER::next_job(uint32_t worker)
+{
+    int index = deque[worker].pop_front();
+    if (index >= 0)
+        return index;
+
+    // steal the last job of the next slice that still has work
+    for (uint32_t i=1; i<num_workers; i++) {
+        index = deque[(worker+i) % num_workers].steal_back();
+        if (index >= 0)
+            return index;
+    }
+
+    return -1;
+}
+
+int BATCH_DRIVER::run_job(uint32_t index, char *program)
+{
+    BATCH_JOB &job = jobs[index];
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        cerr << "[BATCH] fork failed for job " << job.name << endl;
+        assert(0);
+    }
+
+    if (pid == 0) {
+        // simulation child, carries on in main() with the job's own command line
+        string console_path = output_dir + "/" + job.name + ".txt";
+        if (freopen(console_path.c_str(), "w", stdout) == NULL) {
+            cerr << "[BATCH] cannot create " << console_path << endl;
+            _exit(1);
+        }
+        dup2(fileno(stdout), fileno(stderr));
+
+        job_name = job.name;
+        result_path = output_dir + "/" + job.name + ".json";
+
+        job_argv.push_back(program);
+        for (uint32_t i=0; i<job.args.size(); i++)
+            job_argv.push_back(strdup(job.args[i].c_str()));
+        job_argv.push_back(NULL);
+
+        return 1;
+    }
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+
+    uint8_t failed = !WIFEXITED(status) || (WEXITSTATUS(status) != 0);
+    if (failed) {
+        num_failed->fetch_add(1);
+        write_failure(job, status);
+    }
+
+    printf("[BATCH] job %s %s\n", job.name.c_str(), failed ? "failed" : "done");
+    fflush(stdout);
+
+    return 0;
+}
+
+int BATCH_DRIVER::worker_loop(uint32_t worker, char *program)
+{
+    int index;
+    while ((index = next_job(worker)) >= 0) {
+        if (run_job(index, program))
+            return 1;
+    }
+
+    return 0;
+}
+
+// a JSON string literal, quotes included
+static string json_string(const string &value)
+{
+    string quoted = "\"";
+    char escape[8];
+
+    for (size_t i=0; i<value.size(); i++) {
+        unsigned char c = value[i];
+        if ((c == '"') || (c == '\\')) {
+            quoted += '\\';
+            quoted += c;
+        }
+        else if (c < 0x20) {
+            snprintf(escape, sizeof(escape), "\\u%04x", c);
+            quoted += escape;
+        }
+        else
+            quoted += c;
+    }
+
+    return quoted + "\"";
+}
+
+void BATCH_DRIVER::write_failure(const BATCH_JOB &job, int status)
+{
+    ofstream result((output_dir + "/" + job.name + ".json").c_str());
+
+    result << "{" << endl;
+    result << "  \"job\": " << json_string(job.name) << "," << endl;
+    result << "  \"status\": \"failed\"," << endl;
+    if (WIFSIGNALED(status))
+        result << "  \"signal\": " << WTERMSIG(status) << endl;
+    else
+        result << "  \"exit_code\": " << WEXITSTATUS(status) << endl;
+    result << "}" << endl;
+}
+
+int BATCH_DRIVER::run(int argc, char **argv)
+{
+    const char *manifest = argv[2];
+    for (int i=3; i<argc; i++) {
+        if ((strcmp(argv[i], "-jobs") == 0) && (i+1 < argc))
+            num_workers = atoi(argv[++i]);
+        else if ((strcmp(argv[i], "-batch_output") == 0) && (i+1 < argc))
+            output_dir = argv[++i];
+        else {
+            cerr << "[BATCH] unknown batch option " << argv[i] << endl;
+            assert(0);
+        }
+    }
+
+    parse_manifest(manifest);
+    if (jobs.size() == 0) {
+        cerr << "[BATCH] no jobs in " << manifest << endl;
+        assert(0);
+    }
+
+    if (num_workers == 0)
+        num_workers = thread::hardware_concurrency();
+    if (num_workers == 0)
+        num_workers = 1;
+    if (num_workers > jobs.size())
+        num_workers = jobs.size();
+
+    if ((mkdir(output_dir.c_str(), 0755) != 0) && (errno != EEXIST)) {
+        cerr << "[BATCH] cannot create output directory " << output_dir << endl;
+        assert(0);
+    }
+
+    cout << "[BATCH] " << jobs.size() << " jobs from " << manifest << " on " << num_workers << " workers, results in " << output_dir << endl;
+
+    // the slices and the failure count live in memory shared by every worker
+    size_t shared_size = num_workers * sizeof(BATCH_DEQUE) + sizeof(atomic<uint32_t>);
+    void *shared = mmap(NULL, shared_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        cerr << "[BATCH] cannot map the shared job queue" << endl;
+        assert(0);
+    }
+
+    deque = (BATCH_DEQUE *)shared;
+    num_failed = new ((char *)shared + num_workers * sizeof(BATCH_DEQUE)) atomic<uint32_t>(0);
+    for (uint32_t i=0; i<num_workers; i++) {
+        new (&deque[i]) BATCH_DEQUE;
+        deque[i].assign((uint64_t)jobs.size() * i / num_workers, (uint64_t)jobs.size() * (i+1) / num_workers);
+    }
+
+    // nothing buffered may be duplicated into the children
+    cout.flush();
+    fflush(stdout);
+
+    vector<pid_t> workers;
+    for (uint32_t i=0; i<num_workers; i++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            cerr << "[BATCH] cannot start worker " << i << endl;
+            assert(0);
+        }
+
+        if (pid == 0) {
+            if (worker_loop(i, argv[0]))
+                return 1;
+            _exit(0);
+        }
+
+        workers.push_back(pid);
+    }
+
+    for (uint32_t i=0; i<workers.size(); i++)
+        waitpid(workers[i], NULL, 0);
+
+    cout << "[BATCH] " << (jobs.size() - num_failed->load()) << " jobs done, " << num_failed->load() << " failed" << endl;
+
+    return 0;
+}
+
+// structured results of the job simulated by this process, same numbers as the region of interest statistics
+void write_batch_result(const char *path)
+{
+    ofstream result(path);
+
+    result << "{" << endl;
+    result << "  \"job\": " << json_string(batch.job_name) << "," << endl;
+    result << "  \"status\": \"ok\"," << endl;
+    result << "  \"seed\": " << champsim_seed << "," << endl;
+    result << "  \"modules\": { \"branch_predictor\": \"" << ooo_cpu[0].branch_predictor_module->name;
+    result << "\", \"l1i_prefetcher\": \"" << ooo_cpu[0].l1i_prefetcher_module->name;
+    result << "\", \"l1d_prefetcher\": \"" << ooo_cpu[0].L1D.l1d_prefetcher_module->name;
+    result << "\", \"l2c_prefetcher\": \"" << ooo_cpu[0].L2C.l2c_prefetcher_module->name;
+    result << "\", \"llc_prefetcher\": \"" << uncore.LLC.llc_prefetcher_module->name;
+    result << "\", \"llc_replacement\": \"" << uncore.LLC.llc_replacement_module->name << "\" }," << endl;
+    result << "  \"cpus\": [" << endl;
+
+    for (uint32_t i=0; i<NUM_CPUS; i++) {
+        O3_CPU &cpu = ooo_cpu[i];
+
+        result << "    {" << endl;
+        result << "      \"trace\": " << json_string(cpu.trace_string) << "," << endl;
+        result << "      \"warmup_instructions\": " << cpu.warmup_instructions << "," << endl;
+        result << "      \"instructions\": " << cpu.finish_sim_instr << "," << endl;
+        result << "      \"cycles\": " << cpu.finish_sim_cycle << "," << endl;
+        result << "      \"ipc\": " << ((double)cpu.finish_sim_instr / cpu.finish_sim_cycle) << "," << endl;
+        result << "      \"branch_mispredictions\": " << cpu.branch_mispredictions << "," << endl;
+        result << "      \"major_faults\": " << major_fault[i] << "," << endl;
+        result << "      \"minor_faults\": " << minor_fault[i] << "," << endl;
+
+        CACHE *caches[4] = { &cpu.L1I, &cpu.L1D, &cpu.L2C, &uncore.LLC };
+        result << "      \"caches\": {" << endl;
+        for (uint32_t j=0; j<4; j++) {
+            uint64_t access = 0, hit = 0, miss = 0;
+            for (uint32_t k=0; k<NUM_TYPES; k++) {
+                access += caches[j]->roi_access[i][k];
+                hit += caches[j]->roi_hit[i][k];
+                miss += caches[j]->roi_miss[i][k];
+            }
+
+            result << "        \"" << caches[j]->NAME << "\": { \"access\": " << access << ", \"hit\": " << hit << ", \"miss\": " << miss;
+            result << ", \"load_miss\": " << caches[j]->roi_miss[i][0] << " }" << ((j < 3) ? "," : "") << endl;
+        }
+        result << "      }" << endl;
+        result << "    }" << ((i < NUM_CPUS-1) ? "," : "") << endl;
+    }
+
+    result << "  ]," << endl;
+
+    result << "  \"dram\": [" << endl;
+    for (uint32_t i=0; i<DRAM_CHANNELS; i++) {
+        result << "    { \"rq_row_buffer_hit\": " << uncore.DRAM.RQ[i].ROW_BUFFER_HIT << ", \"rq_row_buffer_miss\": " << uncore.DRAM.RQ[i].ROW_BUFFER_MISS;
+        result << ", \"wq_row_buffer_hit\": " << uncore.DRAM.WQ[i].ROW_BUFFER_HIT << ", \"wq_row_buffer_miss\": " << uncore.DRAM.WQ[i].ROW_BUFFER_MISS;
+        result << ", \"refresh\": " << uncore.DRAM.timing_stats[i].refresh << ", \"refresh_stall\": " << uncore.DRAM.timing_stats[i].refresh_stall;
+        result << ", \"act_stall\": " << uncore.DRAM.timing_stats[i].act_stall << ", \"cas_stall\": " << uncore.DRAM.timing_stats[i].cas_stall;
+        result << ", \"write_recovery_stall\": " << uncore.DRAM.timing_stats[i].write_recovery_stall << " }";
+        result << ((i < DRAM_CHANNELS-1) ? "," : "") << endl;
+    }
+    result << "  ]," << endl;
+
+    // row buffer outcomes of LOAD, RFO, PREFETCH and WRITEBACK requests
+    const char *outcome_name[NUM_DRAM_ROW_OUTCOMES] = { "row_hit", "row_miss", "row_conflict" };
+    result << "  \"dram_rows\": {";
+    for (uint32_t i=0; i<NUM_DRAM_ROW_OUTCOMES; i++) {
+        result << " \"" << outcome_name[i] << "\": [";
+        for (uint32_t j=0; j<NUM_TYPES; j++)
+            result << uncore.DRAM.row_outcome[i][j] << ((j < NUM_TYPES-1) ? ", " : "");
+        result << "]" << ((i < NUM_DRAM_ROW_OUTCOMES-1) ? "," : "");
+    }
+    result << " }," << endl;
+
+    result << "  \"dram_cores\": [" << endl;
+    for (uint32_t i=0; i<NUM_CPUS; i++) {
+        DRAM_CORE_STATS *stats = &uncore.DRAM.core_stats[i];
+        result << "    { \"read\": " << stats->reads << ", \"prefetch\": " << stats->prefetches << ", \"write\": " << stats->writes;
+        result << ", \"row_buffer_hit\": " << stats->row_hits << ", \"read_latency\": " << stats->read_latency;
+        result << ", \"cycles\": " << current_core_cycle[i] - ooo_cpu[i].begin_sim_cycle << " }";
+        result << ((i < NUM_CPUS-1) ? "," : "") << endl;
+    }
+    result << "  ]" << endl;
+    result << "}" << endl;
+}
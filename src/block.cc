@@ -1,82 +1,153 @@
 #include "block.h"
 
+// never freed, packets of the global queues still release their records into it at exit
+DEPENDS_POOL *depends_pool = new DEPENDS_POOL[NUM_CPUS];
+const PACKET_DEPENDS no_depends;
+
+uint32_t DEPENDS_POOL::allocate()
+{
+    if (free_slot.empty()) {
+        uint32_t first = chunk.size() * DEPENDS_POOL_CHUNK;
+        if (first + DEPENDS_POOL_CHUNK >= (1U << DEPENDS_SLOT_BITS)) {
+            cerr << "[DEPENDS_POOL] " << __func__ << " out of handles" << endl;
+            assert(0);
+        }
+
+        chunk.push_back(new PACKET_DEPENDS[DEPENDS_POOL_CHUNK]);
+        for (uint32_t i=DEPENDS_POOL_CHUNK; i>0; i--)
+            free_slot.push_back(first + i - 1);
+    }
+
+    uint32_t slot = free_slot.back();
+    free_slot.pop_back();
+    *get(slot) = PACKET_DEPENDS();
+
+    return slot;
+}
+
+void DEPENDS_POOL::release(uint32_t slot)
+{
+    free_slot.push_back(slot);
+}
+
+void DEPENDS_REF::allocate(uint32_t pool)
+{
+    handle = (pool << DEPENDS_SLOT_BITS) | (depends_pool[pool].allocate() + 1);
+}
+
+// the copy lives in the pool of the source packet, as both now belong to the same core
+void DEPENDS_REF::copy(const DEPENDS_REF &other)
+{
+    if (handle && ((handle >> DEPENDS_SLOT_BITS) != (other.handle >> DEPENDS_SLOT_BITS)))
+        release();
+    if (handle == 0)
+        allocate(other.handle >> DEPENDS_SLOT_BITS);
+    *get() = *other.get();
+}
+
+void DEPENDS_REF::release()
+{
+    depends_pool[handle >> DEPENDS_SLOT_BITS].release((handle & ((1 << DEPENDS_SLOT_BITS) - 1)) - 1);
+    handle = 0;
+}
+
+void PACKET_QUEUE::allocate(ARENA &arena)
+{
+    entry = arena.allocate<PACKET>(SIZE);
+
+    if (match_mode != QUEUE_UNINDEXED) {
+        // keep the load factor at or below 1/2
+        uint32_t log2_index_size = 2;
+        while ((1u << log2_index_size) < 2*SIZE)
+            log2_index_size++;
+
+        index_table = arena.allocate<uint32_t>(1 << log2_index_size);
+        for (uint32_t i=0; i<(1u << log2_index_size); i++)
+            index_table[i] = UINT32_MAX;
+        index_mask = (1 << log2_index_size) - 1;
+        index_shift = 64 - log2_index_size;
+    }
+}
+
 int PACKET_QUEUE::check_queue(PACKET *packet)
 {
     if ((head == tail) && occupancy == 0)
         return -1;
 
-    if (head < tail) {
-        for (uint32_t i=head; i<tail; i++) {
-            if (NAME == "L1D_WQ") {
-                if (entry[i].full_addr == packet->full_addr) {
-                    DP(if (warmup_complete[packet->cpu]) {
-                        cout << "[" << NAME << "] " << __func__ << " cpu: " << packet->cpu << " instr_id: " << packet->instr_id << " same address: " << hex << packet->address;
-                        cout << " full_addr: " << packet->full_addr << dec << " by instr_id: " << entry[i].instr_id << " index: " << i;
-                        cout << " cycle " << packet->event_cycle << endl;
-                    });
-                    return i;
-                }
-            }
-            else {
-                if (entry[i].address == packet->address) {
-                    DP(if (warmup_complete[packet->cpu]) {
-                        cout << "[" << NAME << "] " << __func__ << " cpu: " << packet->cpu << " instr_id: " << packet->instr_id << " same address: " << hex << packet->address;
-                        cout << " full_addr: " << packet->full_addr << dec << " by instr_id: " << entry[i].instr_id << " index: " << i;
-                        cout << " cycle " << packet->event_cycle << endl;
-                    });
-                    return i;
-                }
+    int match = -1;
+    uint64_t key = match_key(packet);
+
+    if (match_mode == QUEUE_UNINDEXED) {
+        for (uint32_t i=head, n=0; n<occupancy; n++) {
+            if (entry[i].address == key) {
+                match = i;
+                break;
             }
+            i++;
+            if (i == SIZE)
+                i = 0;
         }
     }
     else {
-        for (uint32_t i=head; i<SIZE; i++) {
-            if (NAME == "L1D_WQ") {
-                if (entry[i].full_addr == packet->full_addr) {
-                    DP(if (warmup_complete[packet->cpu]) {
-                        cout << "[" << NAME << "] " << __func__ << " cpu: " << packet->cpu << " instr_id: " << packet->instr_id << " same address: " << hex << packet->address;
-                        cout << " full_addr: " << packet->full_addr << dec << " by instr_id: " << entry[i].instr_id << " index: " << i;
-                        cout << " cycle " << packet->event_cycle << endl;
-                    });
-                    return i;
-                }
-            }
-            else {
-                if (entry[i].address == packet->address) {
-                    DP(if (warmup_complete[packet->cpu]) {
-                        cout << "[" << NAME << "] " << __func__ << " cpu: " << packet->cpu << " instr_id: " << packet->instr_id << " same address: " << hex << packet->address;
-                        cout << " full_addr: " << packet->full_addr << dec << " by instr_id: " << entry[i].instr_id << " index: " << i;
-                        cout << " cycle " << packet->event_cycle << endl;
-                    });
-                    return i;
+        // the oldest matching entry wins, as it would in a scan from head
+        uint32_t match_age = UINT32_MAX;
+        for (uint32_t slot = index_slot(key); index_table[slot] != UINT32_MAX; slot = (slot + 1) & index_mask) {
+            uint32_t i = index_table[slot];
+            if (match_key(&entry[i]) == key) {
+                uint32_t age = (i >= head) ? (i - head) : (i + SIZE - head);
+                if (age < match_age) {
+                    match = i;
+                    match_age = age;
                 }
             }
         }
-        for (uint32_t i=0; i<tail; i++) {
-            if (NAME == "L1D_WQ") {
-                if (entry[i].full_addr == packet->full_addr) {
-                    DP(if (warmup_complete[packet->cpu]) {
-                        cout << "[" << NAME << "] " << __func__ << " cpu: " << packet->cpu << " instr_id: " << packet->instr_id << " same address: " << hex << packet->address;
-                        cout << " full_addr: " << packet->full_addr << dec << " by instr_id: " << entry[i].instr_id << " index: " << i;
-                        cout << " cycle " << packet->event_cycle << endl;
-                    });
-                    return i;
-                }
-            }
-            else {
-                if (entry[i].address == packet->address) {
-                    DP(if (warmup_complete[packet->cpu]) {
-                        cout << "[" << NAME << "] " << __func__ << " cpu: " << packet->cpu << " instr_id: " << packet->instr_id << " same address: " << hex << packet->address;
-                        cout << " full_addr: " << packet->full_addr << dec << " by instr_id: " << entry[i].instr_id << " index: " << i;
-                        cout << " cycle " << packet->event_cycle << endl;
-                    });
-                    return i;
-                }
-            }
+    }
+
+    DP(if ((match != -1) && warmup_complete[packet->cpu]) {
+        cout << "[" << NAME << "] " << __func__ << " cpu: " << packet->cpu << " instr_id: " << packet->instr_id << " same address: " << hex << packet->address;
+        cout << " full_addr: " << packet->full_addr << dec << " by instr_id: " << entry[match].instr_id << " index: " << match;
+        cout << " cycle " << packet->event_cycle << endl;
+    });
+
+    return match;
+}
+
+void PACKET_QUEUE::index_insert(uint32_t index)
+{
+    if (match_mode == QUEUE_UNINDEXED)
+        return;
+
+    uint32_t slot = index_slot(match_key(&entry[index]));
+    while (index_table[slot] != UINT32_MAX)
+        slot = (slot + 1) & index_mask;
+    index_table[slot] = index;
+}
+
+void PACKET_QUEUE::index_erase(uint32_t index)
+{
+    if (match_mode == QUEUE_UNINDEXED)
+        return;
+
+    uint32_t hole = index_slot(match_key(&entry[index]));
+    while (index_table[hole] != index) {
+        #ifdef SANITY_CHECK
+        if (index_table[hole] == UINT32_MAX) {
+            cerr << "[" << NAME << "] " << __func__ << " index: " << index << " is not in the address index" << endl;
+            assert(0);
         }
+        #endif
+        hole = (hole + 1) & index_mask;
     }
 
-    return -1;
+    // backward shift deletion, pull later entries of the probe run into the hole
+    for (uint32_t slot = (hole + 1) & index_mask; index_table[slot] != UINT32_MAX; slot = (slot + 1) & index_mask) {
+        uint32_t home = index_slot(match_key(&entry[index_table[slot]]));
+        if (((slot - home) & index_mask) >= ((slot - hole) & index_mask)) {
+            index_table[hole] = index_table[slot];
+            hole = slot;
+        }
+    }
+    index_table[hole] = UINT32_MAX;
 }
 
 void PACKET_QUEUE::add_queue(PACKET *packet)
@@ -88,6 +159,7 @@ void PACKET_QUEUE::add_queue(PACKET *packet)
 
     // add entry
     entry[tail] = *packet;
+    index_insert(tail);
 
     DP(if (warmup_complete[packet->cpu]) {
         cout << "[" << NAME << "] " << __func__ << " cpu: " << packet->cpu << " instr_id: " << packet->instr_id;
@@ -115,6 +187,7 @@ void PACKET_QUEUE::remove_queue(PACKET *packet)
     });
 
     // reset entry
+    index_erase(packet - entry);
     PACKET empty_packet;
     *packet = empty_packet;
 
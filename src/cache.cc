@@ -1,5 +1,10 @@
 #include "cache.h"
 #include "set.h"
+#include "page_table.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 uint64_t l2pf_access = 0;
 
@@ -71,8 +76,7 @@ void CACHE::handle_fill()
                 total_miss_latency += current_miss_latency;
             }
 
-            MSHR.remove_queue(&MSHR.entry[mshr_index]);
-            MSHR.num_returned--;
+            remove_mshr(mshr_index);
 
             update_fill_cycle();
 
@@ -218,8 +222,7 @@ void CACHE::handle_fill()
                 total_miss_latency += current_miss_latency;
             }
 
-            MSHR.remove_queue(&MSHR.entry[mshr_index]);
-            MSHR.num_returned--;
+            remove_mshr(mshr_index);
 
             update_fill_cycle();
         }
@@ -239,7 +242,7 @@ void CACHE::handle_writeback()
 
         // access cache
         uint32_t set = get_set(WQ.entry[index].address);
-        int way = check_hit(&WQ.entry[index]);
+        int way = check_hit(&WQ.entry[index], set);
 
         if (way >= 0) { // writeback hit (or RFO hit for L1D)
 
@@ -486,6 +489,10 @@ void CACHE::handle_writeback()
                     sim_miss[writeback_cpu][WQ.entry[index].type]++;
                     sim_access[writeback_cpu][WQ.entry[index].type]++;
 
+                    // a writeback may bring back a line of a page that left the LLC, a swap still has to find it
+                    if (cache_type == IS_LLC)
+                        page_frames.mark_resident(WQ.entry[index].address);
+
                     fill_cache(set, way, &WQ.entry[index]);
 
                     // mark dirty
@@ -540,7 +547,7 @@ void CACHE::handle_read()
 
             // access cache
             uint32_t set = get_set(RQ.entry[index].address);
-            int way = check_hit(&RQ.entry[index]);
+            int way = check_hit(&RQ.entry[index], set);
 
             if (way >= 0) { // read hit
 
@@ -704,15 +711,15 @@ void CACHE::handle_read()
                             if (RQ.entry[index].tlb_access) {
                                 uint32_t sq_index = RQ.entry[index].sq_index;
                                 MSHR.entry[mshr_index].store_merged = 1;
-                                MSHR.entry[mshr_index].sq_index_depend_on_me.insert(sq_index);
-                                MSHR.entry[mshr_index].sq_index_depend_on_me.join(RQ.entry[index].sq_index_depend_on_me, SQ_SIZE);
+                                MSHR.entry[mshr_index].edit_depends().sq_index_depend_on_me.insert(sq_index);
+                                MSHR.entry[mshr_index].edit_depends().sq_index_depend_on_me.join(RQ.entry[index].depends().sq_index_depend_on_me, SQ_SIZE);
                             }
 
                             if (RQ.entry[index].load_merged) {
                                 //uint32_t lq_index = RQ.entry[index].lq_index; 
                                 MSHR.entry[mshr_index].load_merged = 1;
                                 //MSHR.entry[mshr_index].lq_index_depend_on_me[lq_index] = 1;
-                                MSHR.entry[mshr_index].lq_index_depend_on_me.join(RQ.entry[index].lq_index_depend_on_me, LQ_SIZE);
+                                MSHR.entry[mshr_index].edit_depends().lq_index_depend_on_me.join(RQ.entry[index].depends().lq_index_depend_on_me, LQ_SIZE);
                             }
                         }
                         else {
@@ -720,7 +727,7 @@ void CACHE::handle_read()
                                 uint32_t rob_index = RQ.entry[index].rob_index;
                                 MSHR.entry[mshr_index].instruction = 1; // add as instruction type
                                 MSHR.entry[mshr_index].instr_merged = 1;
-                                MSHR.entry[mshr_index].rob_index_depend_on_me.insert(rob_index);
+                                MSHR.entry[mshr_index].edit_depends().rob_index_depend_on_me.insert(rob_index);
 
                                 DP(if (warmup_complete[MSHR.entry[mshr_index].cpu]) {
                                     cout << "[INSTR_MERGED] " << __func__ << " cpu: " << MSHR.entry[mshr_index].cpu << " instr_id: " << MSHR.entry[mshr_index].instr_id;
@@ -728,7 +735,7 @@ void CACHE::handle_read()
                                 });
 
                                 if (RQ.entry[index].instr_merged) {
-                                    MSHR.entry[mshr_index].rob_index_depend_on_me.join(RQ.entry[index].rob_index_depend_on_me, ROB_SIZE);
+                                    MSHR.entry[mshr_index].edit_depends().rob_index_depend_on_me.join(RQ.entry[index].depends().rob_index_depend_on_me, ROB_SIZE);
                                     DP(if (warmup_complete[MSHR.entry[mshr_index].cpu]) {
                                         cout << "[INSTR_MERGED] " << __func__ << " cpu: " << MSHR.entry[mshr_index].cpu << " instr_id: " << MSHR.entry[mshr_index].instr_id;
                                         cout << " merged rob_index: " << i << " instr_id: N/A" << endl;
@@ -740,16 +747,16 @@ void CACHE::handle_read()
                                 uint32_t lq_index = RQ.entry[index].lq_index;
                                 MSHR.entry[mshr_index].is_data = 1; // add as data type
                                 MSHR.entry[mshr_index].load_merged = 1;
-                                MSHR.entry[mshr_index].lq_index_depend_on_me.insert(lq_index);
+                                MSHR.entry[mshr_index].edit_depends().lq_index_depend_on_me.insert(lq_index);
 
                                 DP(if (warmup_complete[read_cpu]) {
                                     cout << "[DATA_MERGED] " << __func__ << " cpu: " << read_cpu << " instr_id: " << RQ.entry[index].instr_id;
                                     cout << " merged rob_index: " << RQ.entry[index].rob_index << " instr_id: " << RQ.entry[index].instr_id << " lq_index: " << RQ.entry[index].lq_index << endl;
                                 });
-                                MSHR.entry[mshr_index].lq_index_depend_on_me.join(RQ.entry[index].lq_index_depend_on_me, LQ_SIZE);
+                                MSHR.entry[mshr_index].edit_depends().lq_index_depend_on_me.join(RQ.entry[index].depends().lq_index_depend_on_me, LQ_SIZE);
                                 if (RQ.entry[index].store_merged) {
                                     MSHR.entry[mshr_index].store_merged = 1;
-                                    MSHR.entry[mshr_index].sq_index_depend_on_me.join(RQ.entry[index].sq_index_depend_on_me, SQ_SIZE);
+                                    MSHR.entry[mshr_index].edit_depends().sq_index_depend_on_me.join(RQ.entry[index].depends().sq_index_depend_on_me, SQ_SIZE);
                                 }
                             }
                         }
@@ -848,7 +855,7 @@ void CACHE::handle_prefetch()
 
             // access cache
             uint32_t set = get_set(PQ.entry[index].address);
-            int way = check_hit(&PQ.entry[index]);
+            int way = check_hit(&PQ.entry[index], set);
 
             if (way >= 0) { // prefetch hit
 
@@ -1066,19 +1073,91 @@ void CACHE::operate()
         handle_prefetch();
 }
 
-uint32_t CACHE::get_set(uint64_t address)
+// earliest cycle after current at which operate() can change anything, UINT64_MAX if the cache is drained
+// mirrors the gates of handle_fill(), handle_writeback(), handle_read() and handle_prefetch()
+uint64_t CACHE::next_event_cycle(uint64_t current)
 {
-    return (uint32_t)(address & ((1 << lg2(NUM_SET)) - 1));
+    uint64_t next = UINT64_MAX;
+
+    if ((MSHR.next_fill_index != MSHR_SIZE) && (MSHR.entry[MSHR.next_fill_index].cpu != NUM_CPUS))
+        next = next_event(next, MSHR.next_fill_cycle, current);
+
+    if (WQ.occupancy && (WQ.entry[WQ.head].cpu != NUM_CPUS))
+        next = next_event(next, WQ.entry[WQ.head].event_cycle, current);
+
+    if (RQ.occupancy && (RQ.entry[RQ.head].cpu != NUM_CPUS))
+        next = next_event(next, RQ.entry[RQ.head].event_cycle, current);
+
+    if (PQ.occupancy && (PQ.entry[PQ.head].cpu != NUM_CPUS))
+        next = next_event(next, PQ.entry[PQ.head].event_cycle, current);
+
+    return next;
 }
 
-uint32_t CACHE::get_way(uint64_t address, uint32_t set)
+// bit w is set when way w of tags holds tag, ways is a multiple of TAG_STORE_ALIGN and at most TAG_STORE_CHUNK
+// instantiated with the stride of every configured level, so the compiler unrolls the whole set
+template <uint32_t WAYS>
+static inline uint64_t match_tags(const uint64_t *tags, uint64_t tag, uint32_t ways = WAYS)
 {
-    for (uint32_t way=0; way<NUM_WAY; way++) {
-        if (block[set][way].valid && (block[set][way].tag == address))
-            return way;
+    uint64_t mask = 0;
+
+    #if defined(__AVX2__)
+    __m256i key = _mm256_set1_epi64x(tag);
+    for (uint32_t way=0; way<ways; way+=4) {
+        __m256i match = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i *)&tags[way]), key);
+        mask |= (uint64_t)_mm256_movemask_pd(_mm256_castsi256_pd(match)) << way;
     }
+    #elif defined(__SSE2__)
+    // SSE2 only compares 32-bit lanes, a way matches when both halves of its tag do
+    __m128i key = _mm_set1_epi64x(tag);
+    for (uint32_t way=0; way<ways; way+=2) {
+        __m128i match = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)&tags[way]), key);
+        match = _mm_and_si128(match, _mm_shuffle_epi32(match, _MM_SHUFFLE(2, 3, 0, 1)));
+        mask |= (uint64_t)_mm_movemask_pd(_mm_castsi128_pd(match)) << way;
+    }
+    #else
+    for (uint32_t way=0; way<ways; way++)
+        mask |= (uint64_t)(tags[way] == tag) << way;
+    #endif
 
-    return NUM_WAY;
+    return mask;
+}
+
+// first way of set holding tag, NUM_WAY on a miss
+uint32_t CACHE::find_tag(uint32_t set, uint64_t tag)
+{
+    const uint64_t *tags = &tag_store[set*TAG_STRIDE];
+    uint64_t mask;
+
+    switch (TAG_STRIDE) {
+        case 4:
+            mask = match_tags<4>(tags, tag);
+            break;
+        case 8:
+            mask = match_tags<8>(tags, tag);
+            break;
+        case 12:
+            mask = match_tags<12>(tags, tag);
+            break;
+        case 16:
+            mask = match_tags<16>(tags, tag);
+            break;
+        default:
+            // the chunks are multiples of TAG_STORE_ALIGN too, the first one with a match holds the first way
+            for (uint32_t base=0; base<TAG_STRIDE; base+=TAG_STORE_CHUNK) {
+                mask = match_tags<0>(&tags[base], tag, min(TAG_STRIDE - base, (uint32_t)TAG_STORE_CHUNK));
+                if (mask)
+                    return base + __builtin_ctzll(mask);
+            }
+            return NUM_WAY;
+    }
+
+    return mask ? __builtin_ctzll(mask) : NUM_WAY;
+}
+
+uint32_t CACHE::get_way(uint64_t address, uint32_t set)
+{
+    return find_tag(set, address);
 }
 
 void CACHE::fill_cache(uint32_t set, uint32_t way, PACKET *packet)
@@ -1111,12 +1190,14 @@ void CACHE::fill_cache(uint32_t set, uint32_t way, PACKET *packet)
     if (block[set][way].prefetch)
         pf_fill++;
 
-    block[set][way].delta = packet->delta;
-    block[set][way].depth = packet->depth;
-    block[set][way].signature = packet->signature;
-    block[set][way].confidence = packet->confidence;
+    const PACKET_DEPENDS &depends = packet->depends();
+    block[set][way].delta = depends.delta;
+    block[set][way].depth = depends.depth;
+    block[set][way].signature = depends.signature;
+    block[set][way].confidence = depends.confidence;
 
     block[set][way].tag = packet->address;
+    tag_store[set*TAG_STRIDE + way] = packet->address;
     block[set][way].address = packet->address;
     block[set][way].full_addr = packet->full_addr;
     block[set][way].data = packet->data;
@@ -1131,33 +1212,32 @@ void CACHE::fill_cache(uint32_t set, uint32_t way, PACKET *packet)
     });
 }
 
-int CACHE::check_hit(PACKET *packet)
+// set is get_set(packet->address), which the caller already has
+int CACHE::check_hit(PACKET *packet, uint32_t set)
 {
-    uint32_t set = get_set(packet->address);
     int match_way = -1;
 
-    if (NUM_SET < set) {
+    #ifdef SANITY_CHECK
+    if (set != get_set(packet->address)) {
         cerr << "[" << NAME << "_ERROR] " << __func__ << " invalid set index: " << set << " NUM_SET: " << NUM_SET;
         cerr << " address: " << hex << packet->address << " full_addr: " << packet->full_addr << dec;
         cerr << " event: " << packet->event_cycle << endl;
         assert(0);
     }
+    #endif
 
     // hit
-    for (uint32_t way=0; way<NUM_WAY; way++) {
-        if (block[set][way].valid && (block[set][way].tag == packet->address)) {
+    uint32_t way = find_tag(set, packet->address);
+    if (way < NUM_WAY) {
 
-            match_way = way;
+        match_way = way;
 
-            DP(if (warmup_complete[packet->cpu]) {
-                cout << "[" << NAME << "] " << __func__ << " instr_id: " << packet->instr_id << " type: " << +packet->type << hex << " addr: " << packet->address;
-                cout << " full_addr: " << packet->full_addr << " tag: " << block[set][way].tag << " data: " << block[set][way].data << dec;
-                cout << " set: " << set << " way: " << way << " lru: " << block[set][way].lru;
-                cout << " event: " << packet->event_cycle << " cycle: " << current_core_cycle[cpu] << endl;
-            });
-
-            break;
-        }
+        DP(if (warmup_complete[packet->cpu]) {
+            cout << "[" << NAME << "] " << __func__ << " instr_id: " << packet->instr_id << " type: " << +packet->type << hex << " addr: " << packet->address;
+            cout << " full_addr: " << packet->full_addr << " tag: " << block[set][way].tag << " data: " << block[set][way].data << dec;
+            cout << " set: " << set << " way: " << way << " lru: " << block[set][way].lru;
+            cout << " event: " << packet->event_cycle << " cycle: " << current_core_cycle[cpu] << endl;
+        });
     }
 
     return match_way;
@@ -1168,28 +1248,20 @@ int CACHE::invalidate_entry(uint64_t inval_addr)
     uint32_t set = get_set(inval_addr);
     int match_way = -1;
 
-    if (NUM_SET < set) {
-        cerr << "[" << NAME << "_ERROR] " << __func__ << " invalid set index: " << set << " NUM_SET: " << NUM_SET;
-        cerr << " inval_addr: " << hex << inval_addr << dec << endl;
-        assert(0);
-    }
-
     // invalidate
-    for (uint32_t way=0; way<NUM_WAY; way++) {
-        if (block[set][way].valid && (block[set][way].tag == inval_addr)) {
+    uint32_t way = find_tag(set, inval_addr);
+    if (way < NUM_WAY) {
 
-            block[set][way].valid = 0;
+        block[set][way].valid = 0;
+        tag_store[set*TAG_STRIDE + way] = INVALID_TAG;
 
-            match_way = way;
-
-            DP(if (warmup_complete[cpu]) {
-                cout << "[" << NAME << "] " << __func__ << " inval_addr: " << hex << inval_addr;
-                cout << " tag: " << block[set][way].tag << " data: " << block[set][way].data << dec;
-                cout << " set: " << set << " way: " << way << " lru: " << block[set][way].lru << " cycle: " << current_core_cycle[cpu] << endl;
-            });
+        match_way = way;
 
-            break;
-        }
+        DP(if (warmup_complete[cpu]) {
+            cout << "[" << NAME << "] " << __func__ << " inval_addr: " << hex << inval_addr;
+            cout << " tag: " << block[set][way].tag << " data: " << block[set][way].data << dec;
+            cout << " set: " << set << " way: " << way << " lru: " << block[set][way].lru << " cycle: " << current_core_cycle[cpu] << endl;
+        });
     }
 
     return match_way;
@@ -1261,7 +1333,7 @@ int CACHE::add_rq(PACKET *packet)
 
         if (packet->instruction) {
             uint32_t rob_index = packet->rob_index;
-            RQ.entry[index].rob_index_depend_on_me.insert(rob_index);
+            RQ.entry[index].edit_depends().rob_index_depend_on_me.insert(rob_index);
             RQ.entry[index].instruction = 1; // add as instruction type
             RQ.entry[index].instr_merged = 1;
 
@@ -1276,12 +1348,12 @@ int CACHE::add_rq(PACKET *packet)
             if (packet->type == RFO) {
 
                 uint32_t sq_index = packet->sq_index;
-                RQ.entry[index].sq_index_depend_on_me.insert(sq_index);
+                RQ.entry[index].edit_depends().sq_index_depend_on_me.insert(sq_index);
                 RQ.entry[index].store_merged = 1;
             }
             else {
                 uint32_t lq_index = packet->lq_index;
-                RQ.entry[index].lq_index_depend_on_me.insert(lq_index);
+                RQ.entry[index].edit_depends().lq_index_depend_on_me.insert(lq_index);
                 RQ.entry[index].load_merged = 1;
 
                 DP(if (warmup_complete[packet->cpu]) {
@@ -1327,6 +1399,7 @@ int CACHE::add_rq(PACKET *packet)
     #endif
 
     RQ.entry[index] = *packet;
+    RQ.index_insert(index);
 
     // ADD LATENCY
     if (RQ.entry[index].event_cycle < current_core_cycle[packet->cpu])
@@ -1381,6 +1454,7 @@ int CACHE::add_wq(PACKET *packet)
     }
 
     WQ.entry[index] = *packet;
+    WQ.index_insert(index);
 
     // ADD LATENCY
     if (WQ.entry[index].event_cycle < current_core_cycle[packet->cpu])
@@ -1467,10 +1541,11 @@ int CACHE::kpc_prefetch_line(uint64_t base_addr, uint64_t pf_addr, int pf_fill_l
             //pf_packet.rob_index = LQ.entry[lq_index].rob_index;
             pf_packet.ip = 0;
             pf_packet.type = PREFETCH;
-            pf_packet.delta = delta;
-            pf_packet.depth = depth;
-            pf_packet.signature = signature;
-            pf_packet.confidence = confidence;
+            PACKET_DEPENDS &depends = pf_packet.edit_depends();
+            depends.delta = delta;
+            depends.depth = depth;
+            depends.signature = signature;
+            depends.confidence = confidence;
             pf_packet.event_cycle = current_core_cycle[cpu];
 
             // give a dummy 0 as the IP of a prefetch
@@ -1578,6 +1653,7 @@ int CACHE::add_pq(PACKET *packet)
     #endif
 
     PQ.entry[index] = *packet;
+    PQ.index_insert(index);
 
     // ADD LATENCY
     if (PQ.entry[index].event_cycle < current_core_cycle[packet->cpu])
@@ -1627,12 +1703,17 @@ void CACHE::return_data(PACKET *packet)
     MSHR.entry[mshr_index].data = packet->data;
     MSHR.entry[mshr_index].pf_metadata = packet->pf_metadata;
 
+    // page swaps only invalidate the lines that came in from DRAM or through an LLC writeback miss
+    if (cache_type == IS_LLC)
+        page_frames.mark_resident(packet->address);
+
     // ADD LATENCY
     if (MSHR.entry[mshr_index].event_cycle < current_core_cycle[packet->cpu])
         MSHR.entry[mshr_index].event_cycle = current_core_cycle[packet->cpu] + LATENCY;
     else
         MSHR.entry[mshr_index].event_cycle += LATENCY;
 
+    mshr_fill_order.push(make_pair(MSHR.entry[mshr_index].event_cycle, (uint32_t)mshr_index));
     update_fill_cycle();
 
     DP(if (warmup_complete[packet->cpu]) {
@@ -1646,61 +1727,45 @@ void CACHE::return_data(PACKET *packet)
 
 void CACHE::update_fill_cycle()
 {
-    // update next_fill_cycle
-    uint64_t min_cycle = UINT64_MAX;
-    uint32_t min_index = MSHR.SIZE;
-    for (uint32_t i=0; i<MSHR.SIZE; i++) {
-        if ((MSHR.entry[i].returned == COMPLETED) && (MSHR.entry[i].event_cycle < min_cycle)) {
-            min_cycle = MSHR.entry[i].event_cycle;
-            min_index = i;
-        }
+    // update next_fill_cycle, dropping heap entries whose MSHR entry has since been filled or returned again
+    while (!mshr_fill_order.empty()) {
+        PACKET &packet = MSHR.entry[mshr_fill_order.top().second];
+        if ((packet.returned == COMPLETED) && (packet.event_cycle == mshr_fill_order.top().first))
+            break;
 
-        DP(if (warmup_complete[MSHR.entry[i].cpu]) {
-            cout << "[" << NAME << "_MSHR] " <<  __func__ << " checking instr_id: " << MSHR.entry[i].instr_id;
-            cout << " address: " << hex << MSHR.entry[i].address << " full_addr: " << MSHR.entry[i].full_addr;
-            cout << " data: " << MSHR.entry[i].data << dec << " returned: " << +MSHR.entry[i].returned << " fill_level: " << MSHR.entry[i].fill_level;
-            cout << " index: " << i << " occupancy: " << MSHR.occupancy;
-            cout << " event: " << MSHR.entry[i].event_cycle << " current: " << current_core_cycle[MSHR.entry[i].cpu] << " next: " << MSHR.next_fill_cycle << endl;
-        });
+        mshr_fill_order.pop();
     }
 
-    MSHR.next_fill_cycle = min_cycle;
+    if (mshr_fill_order.empty()) {
+        MSHR.next_fill_cycle = UINT64_MAX;
+        MSHR.next_fill_index = MSHR.SIZE;
+        return;
+    }
+
+    uint32_t min_index = mshr_fill_order.top().second;
+    MSHR.next_fill_cycle = mshr_fill_order.top().first;
     MSHR.next_fill_index = min_index;
-    if (min_index < MSHR.SIZE) {
 
-        DP(if (warmup_complete[MSHR.entry[min_index].cpu]) {
-            cout << "[" << NAME << "_MSHR] " <<  __func__ << " instr_id: " << MSHR.entry[min_index].instr_id;
-            cout << " address: " << hex << MSHR.entry[min_index].address << " full_addr: " << MSHR.entry[min_index].full_addr;
-            cout << " data: " << MSHR.entry[min_index].data << dec << " num_returned: " << MSHR.num_returned;
-            cout << " event: " << MSHR.entry[min_index].event_cycle << " current: " << current_core_cycle[MSHR.entry[min_index].cpu] << " next: " << MSHR.next_fill_cycle << endl;
-        });
-    }
+    DP(if (warmup_complete[MSHR.entry[min_index].cpu]) {
+        cout << "[" << NAME << "_MSHR] " <<  __func__ << " instr_id: " << MSHR.entry[min_index].instr_id;
+        cout << " address: " << hex << MSHR.entry[min_index].address << " full_addr: " << MSHR.entry[min_index].full_addr;
+        cout << " data: " << MSHR.entry[min_index].data << dec << " num_returned: " << MSHR.num_returned;
+        cout << " event: " << MSHR.entry[min_index].event_cycle << " current: " << current_core_cycle[MSHR.entry[min_index].cpu] << " next: " << MSHR.next_fill_cycle << endl;
+    });
 }
 
 int CACHE::check_mshr(PACKET *packet)
 {
-    // search mshr
-  //bool instruction_and_data_collision = false;
-
-    for (uint32_t index=0; index<MSHR_SIZE; index++)
-    {
-        if (MSHR.entry[index].address == packet->address)
-        {
-            //if(MSHR.entry[index].instruction != packet->instruction)
-            //  {
-            //    instruction_and_data_collision = true;
-            //  }
-            //else
-            //  {
-            DP(if (warmup_complete[packet->cpu]) {
-                cout << "[" << NAME << "_MSHR] " << __func__ << " same entry instr_id: " << packet->instr_id << " prior_id: " << MSHR.entry[index].instr_id;
-                cout << " address: " << hex << packet->address;
-                cout << " full_addr: " << packet->full_addr << dec << endl;
-            });
+    // search mshr, an address has at most one entry
+    int index = MSHR.check_queue(packet);
+    if (index >= 0) {
+        DP(if (warmup_complete[packet->cpu]) {
+            cout << "[" << NAME << "_MSHR] " << __func__ << " same entry instr_id: " << packet->instr_id << " prior_id: " << MSHR.entry[index].instr_id;
+            cout << " address: " << hex << packet->address;
+            cout << " full_addr: " << packet->full_addr << dec << endl;
+        });
 
-            return index;
-            //  }
-        }
+        return index;
     }
 
     //if(instruction_and_data_collision) // remove instruction-and-data collision safeguard
@@ -1726,29 +1791,38 @@ int CACHE::check_mshr(PACKET *packet)
 
 void CACHE::add_mshr(PACKET *packet)
 {
-    uint32_t index = 0;
-
     packet->cycle_enqueued = current_core_cycle[packet->cpu];
 
-    // search mshr
-    for (index=0; index<MSHR_SIZE; index++) {
-        if (MSHR.entry[index].address == 0) {
+    // take the lowest free entry
+    for (uint32_t word=0; word<mshr_free.size(); word++) {
+        if (mshr_free[word] == 0)
+            continue;
 
-            MSHR.entry[index] = *packet;
-            MSHR.entry[index].returned = INFLIGHT;
-            MSHR.occupancy++;
+        uint32_t index = word*64 + __builtin_ctzll(mshr_free[word]);
+        mshr_free[word] &= mshr_free[word] - 1;
 
-            DP(if (warmup_complete[packet->cpu]) {
-                cout << "[" << NAME << "_MSHR] " << __func__ << " instr_id: " << packet->instr_id;
-                cout << " address: " << hex << packet->address << " full_addr: " << packet->full_addr << dec;
-                cout << " index: " << index << " occupancy: " << MSHR.occupancy << endl;
-            });
+        MSHR.entry[index] = *packet;
+        MSHR.entry[index].returned = INFLIGHT;
+        MSHR.occupancy++;
+        MSHR.index_insert(index);
 
-            break;
-        }
+        DP(if (warmup_complete[packet->cpu]) {
+            cout << "[" << NAME << "_MSHR] " << __func__ << " instr_id: " << packet->instr_id;
+            cout << " address: " << hex << packet->address << " full_addr: " << packet->full_addr << dec;
+            cout << " index: " << index << " occupancy: " << MSHR.occupancy << endl;
+        });
+
+        break;
     }
 }
 
+void CACHE::remove_mshr(uint32_t index)
+{
+    MSHR.remove_queue(&MSHR.entry[index]);
+    MSHR.num_returned--;
+    mshr_free[index >> 6] |= 1ULL << (index & 63);
+}
+
 uint32_t CACHE::get_occupancy(uint8_t queue_type, uint64_t address)
 {
     if (queue_type == 0)
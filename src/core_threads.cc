@@ -0,0 +1,162 @@
+#include "core_threads.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+CORE_THREADS core_threads;
+
+void SPIN_BARRIER::wait()
+{
+    uint64_t current_generation = generation.load();
+
+    // the last thread to arrive releases the others
+    if ((waiting.fetch_add(1) + 1) == parties) {
+        waiting.store(0);
+        generation.fetch_add(1);
+        return;
+    }
+
+    for (uint32_t spin=0; generation.load() == current_generation; spin++) {
+        if (spin >= CORE_THREADS_SPIN)
+            this_thread::yield();
+    }
+}
+
+void CORE_THREADS::start(uint64_t quantum_cycles)
+{
+    if (quantum_cycles == 0) {
+        cerr << "[CORE_THREADS] quantum must be at least one cycle" << endl;
+        assert(0);
+    }
+
+    enabled = 1;
+    quantum = quantum_cycles;
+    stopping = 0;
+
+    quantum_begin.parties = NUM_CPUS;
+    quantum_end.parties = NUM_CPUS;
+
+    // the L2Cs reach the shared LLC through their ports from now on
+    for (uint32_t i=0; i<NUM_CPUS; i++) {
+        llc_port[i].cpu = i;
+        llc_port[i].target = ooo_cpu[i].L2C.lower_level;
+        ooo_cpu[i].L2C.lower_level = &llc_port[i];
+        cycle_done[i] = current_core_cycle[i];
+    }
+
+    for (uint32_t i=1; i<NUM_CPUS; i++)
+        worker[i] = thread(&CORE_THREADS::worker_loop, this, i);
+}
+
+void CORE_THREADS::stop()
+{
+    if (enabled == 0)
+        return;
+
+    stopping = 1;
+    quantum_begin.wait();
+
+    for (uint32_t i=1; i<NUM_CPUS; i++)
+        worker[i].join();
+
+    for (uint32_t i=0; i<NUM_CPUS; i++)
+        ooo_cpu[i].L2C.lower_level = llc_port[i].target;
+
+    enabled = 0;
+}
+
+void CORE_THREADS::run_core(uint32_t cpu)
+{
+    for (uint64_t i=0; i<quantum; i++) {
+        ooo_cpu[cpu].operate();
+        cycle_done[cpu] = current_core_cycle[cpu];
+    }
+}
+
+// pins the calling worker to the cpu-th host CPU the process may run on, wrapping around, returns 0 on failure
+int CORE_THREADS::pin_worker(uint32_t cpu)
+{
+    cpu_set_t allowed, pinned;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return 0;
+
+    int count = CPU_COUNT(&allowed);
+    if (count == 0)
+        return 0;
+
+    int target = cpu % count, host = 0;
+    for (host=0; host<CPU_SETSIZE; host++) {
+        if (CPU_ISSET(host, &allowed) && (target-- == 0))
+            break;
+    }
+
+    CPU_ZERO(&pinned);
+    CPU_SET(host, &pinned);
+    return pthread_setaffinity_np(pthread_self(), sizeof(pinned), &pinned) == 0;
+}
+
+void CORE_THREADS::worker_loop(uint32_t cpu)
+{
+    // the core's buffers, queues and private caches follow it to this thread's memory node, which only stays
+    // the same once the scheduler can no longer move the thread
+    if (pin_worker(cpu))
+        ooo_cpu[cpu].arena.bind_local();
+
+    while (1) {
+        quantum_begin.wait();
+        if (stopping)
+            return;
+
+        run_core(cpu);
+
+        quantum_end.wait();
+    }
+}
+
+// called by the main thread once per quantum, returns with every core and the uncore at the end of the quantum
+void CORE_THREADS::run_quantum()
+{
+    uint64_t begin_cycle = current_core_cycle[0];
+
+    quantum_begin.wait();
+    run_core(0);
+    quantum_end.wait();
+
+    // catch the uncore up, cycle by cycle, with what the cores issued in each cycle
+    for (uint64_t cycle=begin_cycle+1; cycle<=begin_cycle+quantum; cycle++) {
+        for (uint32_t i=0; i<NUM_CPUS; i++)
+            current_core_cycle[i] = cycle;
+
+        for (uint32_t i=0; i<NUM_CPUS; i++)
+            llc_port[i].drain(cycle);
+
+        uncore.DRAM.operate();
+        uncore.LLC.operate();
+    }
+
+    // no core is running, so every translation of the next quantum sees the same value
+    if (allocated_pages >= DRAM_PAGES)
+        swapping = 1;
+}
+
+// a page allocation waits until every core ahead of it in (cycle, cpu) order is done:
+// lower numbered cores must have completed this cycle, higher numbered cores the previous one
+void CORE_THREADS::wait_page_allocation(uint32_t cpu, unique_lock<mutex> &page_table_guard)
+{
+    uint64_t cycle = current_core_cycle[cpu];
+
+    page_table_guard.unlock();
+
+    for (uint32_t i=0; i<NUM_CPUS; i++) {
+        if (i == cpu)
+            continue;
+
+        uint64_t needed = (i < cpu) ? cycle : (cycle - 1);
+        for (uint32_t spin=0; cycle_done[i].load() < needed; spin++) {
+            if (spin >= CORE_THREADS_SPIN)
+                this_thread::yield();
+        }
+    }
+
+    page_table_guard.lock();
+}
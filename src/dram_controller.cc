@@ -4,50 +4,239 @@
 uint32_t DRAM_MTPS, DRAM_DBUS_RETURN_TIME,
 tRP, tRCD, tCAS;
 
+// set by the knobs, the logarithms and sizes are derived in MEMORY_CONTROLLER::initialize()
+uint32_t DRAM_CHANNELS = DEFAULT_DRAM_CHANNELS, LOG2_DRAM_CHANNELS,
+DRAM_RANKS = DEFAULT_DRAM_RANKS, LOG2_DRAM_RANKS,
+DRAM_BANKS = DEFAULT_DRAM_BANKS, LOG2_DRAM_BANKS,
+DRAM_ROWS = DEFAULT_DRAM_ROWS, LOG2_DRAM_ROWS,
+DRAM_COLUMNS = DEFAULT_DRAM_COLUMNS, LOG2_DRAM_COLUMNS,
+DRAM_SIZE;
+
+uint64_t DRAM_PAGES;
+
+const char *DRAM_MAPPING_NAME[NUM_DRAM_MAPPINGS] = { "line", "row", "xor" };
+
+uint8_t find_dram_mapping(const char *name)
+{
+    for (uint8_t i=0; i<NUM_DRAM_MAPPINGS; i++) {
+        if (strcmp(name, DRAM_MAPPING_NAME[i]) == 0)
+            return i;
+    }
+
+    cerr << "[DRAM] unknown address mapping " << name << ", available:";
+    for (uint8_t i=0; i<NUM_DRAM_MAPPINGS; i++)
+        cerr << " " << DRAM_MAPPING_NAME[i];
+    cerr << endl;
+    assert(0);
+
+    return DRAM_MAP_LINE;
+}
+
+const char *DRAM_TIMING_NAME[NUM_DRAM_TIMINGS] = { "simple", "ddr4", "ddr5" };
+const uint32_t DRAM_TIMING_MTPS[NUM_DRAM_TIMINGS] = { 0, 0, 4800 },
+    DRAM_TIMING_BANKS[NUM_DRAM_TIMINGS] = { 0, 0, 32 };
+
+// rank constraints of the DDR timing models in nanoseconds, tRRD_S, tRRD_L, tFAW, tCCD_S, tCCD_L, tWR, tREFI, tRFC,
+// followed by the number of bank groups, JEDEC values for 1KB pages
+static const double DRAM_TIMING_NANOSECONDS[NUM_DRAM_TIMINGS][9] = {
+    { 0, 0, 0, 0, 0, 0, 0, 0, 1 },
+    { 2.5, 4.9, 21, 2.5, 5, 15, 7800, 350, 4 }, // DDR4-3200, 8Gb
+    { 3.3, 5, 13.3, 3.3, 5, 30, 3900, 295, 8 }  // DDR5-4800, 16Gb
+};
+
+uint8_t find_dram_timing(const char *name)
+{
+    for (uint8_t i=0; i<NUM_DRAM_TIMINGS; i++) {
+        if (strcmp(name, DRAM_TIMING_NAME[i]) == 0)
+            return i;
+    }
+
+    cerr << "[DRAM] unknown timing model " << name << ", available:";
+    for (uint8_t i=0; i<NUM_DRAM_TIMINGS; i++)
+        cerr << " " << DRAM_TIMING_NAME[i];
+    cerr << endl;
+    assert(0);
+
+    return DRAM_TIMING_SIMPLE;
+}
+
+const char *DRAM_PAGE_POLICY_NAME[NUM_DRAM_PAGE_POLICIES] = { "open", "closed", "adaptive" };
+
+uint8_t find_dram_page_policy(const char *name)
+{
+    for (uint8_t i=0; i<NUM_DRAM_PAGE_POLICIES; i++) {
+        if (strcmp(name, DRAM_PAGE_POLICY_NAME[i]) == 0)
+            return i;
+    }
+
+    cerr << "[DRAM] unknown page policy " << name << ", available:";
+    for (uint8_t i=0; i<NUM_DRAM_PAGE_POLICIES; i++)
+        cerr << " " << DRAM_PAGE_POLICY_NAME[i];
+    cerr << endl;
+    assert(0);
+
+    return DRAM_PAGE_OPEN;
+}
+
+// a geometry knob has to be a power of two, returns its logarithm
+static uint32_t dram_log2(const char *knob, uint32_t value)
+{
+    if ((value == 0) || (value & (value - 1))) {
+        cerr << "[DRAM] -" << knob << " " << value << " is not a power of two" << endl;
+        assert(0);
+    }
+
+    return lg2(value);
+}
+
+void MEMORY_CONTROLLER::initialize(uint8_t map, uint8_t model, uint8_t scheduler_kind, uint32_t row_hit_cap, uint8_t demote, uint8_t policy)
+{
+    LOG2_DRAM_CHANNELS = dram_log2("dram_channels", DRAM_CHANNELS);
+    LOG2_DRAM_RANKS = dram_log2("dram_ranks", DRAM_RANKS);
+    LOG2_DRAM_BANKS = dram_log2("dram_banks", DRAM_BANKS);
+    LOG2_DRAM_ROWS = dram_log2("dram_rows", DRAM_ROWS);
+    LOG2_DRAM_COLUMNS = dram_log2("dram_columns", DRAM_COLUMNS);
+
+    uint64_t dram_bytes = ((uint64_t)DRAM_CHANNELS*DRAM_RANKS*DRAM_BANKS*DRAM_ROWS*DRAM_COLUMNS) << LOG2_BLOCK_SIZE;
+    DRAM_SIZE = dram_bytes >> 20;
+    DRAM_PAGES = dram_bytes >> LOG2_PAGE_SIZE;
+
+    mapping = map;
+    if (mapping == DRAM_MAP_LINE) {
+        channel_shift = 0;
+        bank_shift = LOG2_DRAM_CHANNELS;
+        column_shift = bank_shift + LOG2_DRAM_BANKS;
+        rank_shift = column_shift + LOG2_DRAM_COLUMNS;
+    }
+    else {
+        column_shift = 0;
+        channel_shift = LOG2_DRAM_COLUMNS;
+        bank_shift = channel_shift + LOG2_DRAM_CHANNELS;
+        rank_shift = bank_shift + LOG2_DRAM_BANKS;
+    }
+    row_shift = rank_shift + LOG2_DRAM_RANKS;
+
+    timing_model = model;
+    const double *ns = DRAM_TIMING_NANOSECONDS[timing_model];
+    timing.tRRD_S = (uint32_t)((1.0 * ns[0] * CPU_FREQ) / 1000);
+    timing.tRRD_L = (uint32_t)((1.0 * ns[1] * CPU_FREQ) / 1000);
+    timing.tFAW   = (uint32_t)((1.0 * ns[2] * CPU_FREQ) / 1000);
+    timing.tCCD_S = (uint32_t)((1.0 * ns[3] * CPU_FREQ) / 1000);
+    timing.tCCD_L = (uint32_t)((1.0 * ns[4] * CPU_FREQ) / 1000);
+    timing.tWR    = (uint32_t)((1.0 * ns[5] * CPU_FREQ) / 1000);
+    timing.tREFI  = (uint32_t)((1.0 * ns[6] * CPU_FREQ) / 1000);
+    timing.tRFC   = (uint32_t)((1.0 * ns[7] * CPU_FREQ) / 1000);
+    timing.bank_groups = (ns[8] < DRAM_BANKS) ? (uint32_t)ns[8] : DRAM_BANKS;
+    if ((timing_model != DRAM_TIMING_SIMPLE) && (DRAM_BANKS < 2*ns[8])) {
+        cerr << "[DRAM] " << DRAM_BANKS << " banks leave one bank per group of " << DRAM_TIMING_NAME[timing_model];
+        cerr << ", tRRD_L and tCCD_L never apply" << endl;
+    }
+
+    rank_state = arena.allocate<DRAM_RANK_STATE>(DRAM_CHANNELS*DRAM_RANKS);
+    precharge_cycle = arena.allocate<uint64_t>(DRAM_CHANNELS*DRAM_BANKS_PER_CHANNEL);
+    timing_stats = arena.allocate<DRAM_TIMING_STATS>(DRAM_CHANNELS);
+
+    scheduler = create_dram_scheduler(scheduler_kind, row_hit_cap, arena);
+    scheduler->initialize(DRAM_CHANNELS, DRAM_BANKS_PER_CHANNEL, arena);
+    prefetch_demote = demote;
+
+    page_policy = policy;
+    row_predictor = arena.allocate<uint8_t>(DRAM_CHANNELS*DRAM_BANKS_PER_CHANNEL);
+    last_row = arena.allocate<uint32_t>(DRAM_CHANNELS*DRAM_BANKS_PER_CHANNEL);
+    activate_cycle = arena.allocate<uint64_t>(DRAM_CHANNELS*DRAM_BANKS_PER_CHANNEL);
+    for (uint32_t i=0; i<DRAM_CHANNELS*DRAM_BANKS_PER_CHANNEL; i++) {
+        row_predictor[i] = (DRAM_ROW_PREDICTOR_MAX + 1) >> 1;
+        last_row[i] = UINT32_MAX;
+        activate_cycle[i] = 0;
+    }
+
+    dbus_cycle_available = arena.allocate<uint64_t>(DRAM_CHANNELS);
+    dbus_cycle_congested = arena.allocate<uint64_t>(DRAM_CHANNELS);
+    write_mode = arena.allocate<uint8_t>(DRAM_CHANNELS);
+    scheduled_reads = arena.allocate<uint32_t>(DRAM_CHANNELS);
+    scheduled_writes = arena.allocate<uint32_t>(DRAM_CHANNELS);
+    bank_request = arena.allocate<BANK_REQUEST>(DRAM_CHANNELS*DRAM_BANKS_PER_CHANNEL);
+
+    WQ = arena.allocate<PACKET_QUEUE>(DRAM_CHANNELS);
+    RQ = arena.allocate<PACKET_QUEUE>(DRAM_CHANNELS);
+    WQ_banks = arena.allocate<DRAM_QUEUE_BANKS>(DRAM_CHANNELS);
+    RQ_banks = arena.allocate<DRAM_QUEUE_BANKS>(DRAM_CHANNELS);
+
+    for (uint32_t i=0; i<DRAM_CHANNELS; i++) {
+        dbus_cycle_available[i] = 0;
+        dbus_cycle_congested[i] = 0;
+        write_mode[i] = 0;
+        scheduled_reads[i] = 0;
+        scheduled_writes[i] = 0;
+
+        WQ[i].NAME = "DRAM_WQ" + to_string(i);
+        WQ[i].SIZE = DRAM_WQ_SIZE;
+        WQ[i].allocate(arena);
+
+        RQ[i].NAME = "DRAM_RQ" + to_string(i);
+        RQ[i].SIZE = DRAM_RQ_SIZE;
+        RQ[i].allocate(arena);
+
+        WQ_banks[i].initialize(&WQ[i], dram_bank(i, 0, 0), arena);
+        RQ_banks[i].initialize(&RQ[i], dram_bank(i, 0, 0), arena);
+    }
+}
+
 void MEMORY_CONTROLLER::reset_remain_requests(PACKET_QUEUE *queue, uint32_t channel)
 {
-    for (uint32_t i=0; i<queue->SIZE; i++) {
-        if (queue->entry[i].scheduled) {
+    DRAM_QUEUE_BANKS *banks = queue_banks(queue);
 
-            uint64_t op_addr = queue->entry[i].address;
-            uint32_t op_cpu = queue->entry[i].cpu,
-                op_channel = dram_get_channel(op_addr),
-                op_rank = dram_get_rank(op_addr),
-                op_bank = dram_get_bank(op_addr),
-                op_row = dram_get_row(op_addr);
+    // a scheduled request is the one its bank is working on
+    for (uint32_t b=0; b<DRAM_BANKS_PER_CHANNEL; b++) {
+        BANK_REQUEST *request = &banks->bank_request[b];
+        if ((request->request_index < 0) || !(queue->is_WQ ? request->is_write : request->is_read))
+            continue;
 
-            #ifdef DEBUG_PRINT
-            //uint32_t op_column = dram_get_column(op_addr);
-            #endif
+        uint32_t i = request->request_index;
+        uint32_t op_cpu = queue->entry[i].cpu,
+            op_channel = channel,
+            op_rank = banks->slot[i].rank,
+            op_bank = banks->slot[i].bank,
+            op_row = banks->slot[i].row;
 
-                        // update open row
-            if ((bank_request[op_channel][op_rank][op_bank].cycle_available - tCAS) <= current_core_cycle[op_cpu])
-                bank_request[op_channel][op_rank][op_bank].open_row = op_row;
-            else
-                bank_request[op_channel][op_rank][op_bank].open_row = UINT32_MAX;
-
-            // this bank is ready for another DRAM request
-            bank_request[op_channel][op_rank][op_bank].request_index = -1;
-            bank_request[op_channel][op_rank][op_bank].row_buffer_hit = 0;
-            bank_request[op_channel][op_rank][op_bank].working = 0;
-            bank_request[op_channel][op_rank][op_bank].cycle_available = current_core_cycle[op_cpu];
-            if (bank_request[op_channel][op_rank][op_bank].is_write) {
-                scheduled_writes[channel]--;
-                bank_request[op_channel][op_rank][op_bank].is_write = 0;
-            }
-            else if (bank_request[op_channel][op_rank][op_bank].is_read) {
-                scheduled_reads[channel]--;
-                bank_request[op_channel][op_rank][op_bank].is_read = 0;
-            }
+        #ifdef DEBUG_PRINT
+        //uint32_t op_column = dram_get_column(op_addr);
+        #endif
 
-            queue->entry[i].scheduled = 0;
-            queue->entry[i].event_cycle = current_core_cycle[op_cpu];
+                    // update open row
+        if ((request->cycle_available - tCAS) <= current_core_cycle[op_cpu]) {
+            request->open_row = op_row;
+            open_row_changed(op_channel, op_rank, op_bank);
 
-            DP(if (warmup_complete[op_cpu]) {
-                cout << queue->NAME << " instr_id: " << queue->entry[i].instr_id << " swrites: " << scheduled_writes[channel] << " sreads: " << scheduled_reads[channel] << endl;
-            });
+            // the request gave up the bank, so the page policy may close the row it opened
+            policy_precharge(op_channel, op_rank, op_bank, current_core_cycle[op_cpu]);
+        }
+        else {
+            request->open_row = UINT32_MAX;
+            open_row_changed(op_channel, op_rank, op_bank);
+        }
 
+        // this bank is ready for another DRAM request
+        request->request_index = -1;
+        request->row_buffer_hit = 0;
+        request->working = 0;
+        request->cycle_available = current_core_cycle[op_cpu];
+        if (request->is_write) {
+            scheduled_writes[channel]--;
+            request->is_write = 0;
+        }
+        else if (request->is_read) {
+            scheduled_reads[channel]--;
+            request->is_read = 0;
         }
+
+        queue->entry[i].scheduled = 0;
+        queue->entry[i].event_cycle = current_core_cycle[op_cpu];
+        banks->insert(i);
+
+        DP(if (warmup_complete[op_cpu]) {
+            cout << queue->NAME << " instr_id: " << queue->entry[i].instr_id << " swrites: " << scheduled_writes[channel] << " sreads: " << scheduled_reads[channel] << endl;
+        });
     }
 
     update_schedule_cycle(&RQ[channel]);
@@ -122,139 +311,178 @@ void MEMORY_CONTROLLER::operate()
     }
 }
 
-void MEMORY_CONTROLLER::schedule(PACKET_QUEUE *queue)
+// earliest cycle after current at which operate() can change anything, UINT64_MAX if all channels are drained
+uint64_t MEMORY_CONTROLLER::next_event_cycle(uint64_t current)
 {
-    uint64_t read_addr;
-    uint32_t read_channel, read_rank, read_bank, read_row;
-    uint8_t  row_buffer_hit = 0;
+    uint64_t next = UINT64_MAX;
 
-    int oldest_index = -1;
-    uint64_t oldest_cycle = UINT64_MAX;
-
-    // first, search for the oldest open row hit
-    for (uint32_t i=0; i<queue->SIZE; i++) {
-
-        // already scheduled
-        if (queue->entry[i].scheduled)
-            continue;
-
-        // empty entry
-        read_addr = queue->entry[i].address;
-        if (read_addr == 0)
-            continue;
+    for (uint32_t i=0; i<DRAM_CHANNELS; i++) {
+        // read/write mode switches only depend on the queue occupancy
+        if ((write_mode[i] == 0) && ((WQ[i].occupancy >= DRAM_WRITE_HIGH_WM) || ((RQ[i].occupancy == 0) && (WQ[i].occupancy > 0))))
+            return current + 1;
+        if (write_mode[i] && ((WQ[i].occupancy == 0) || (RQ[i].occupancy && (WQ[i].occupancy < DRAM_WRITE_LOW_WM))))
+            return current + 1;
+
+        PACKET_QUEUE *queue = write_mode[i] ? &WQ[i] : &RQ[i];
+
+        // schedule() only makes progress once a pending request maps to an idle bank
+        DRAM_QUEUE_BANKS *banks = queue_banks(queue);
+        if (queue->next_schedule_index < queue->SIZE) {
+            for (uint32_t b=0; b<DRAM_BANKS_PER_CHANNEL; b++) {
+                if (banks->bank[b].occupancy && (banks->bank_request[b].working == 0)) {
+                    next = next_event(next, queue->next_schedule_cycle, current);
+                    break;
+                }
+            }
+        }
 
-        read_channel = dram_get_channel(read_addr);
-        read_rank = dram_get_rank(read_addr);
-        read_bank = dram_get_bank(read_addr);
+        // process() waits for the scheduled request's bank, and then either returns it or pushes it behind the data bus
+        if (queue->next_process_index < queue->SIZE) {
+            uint64_t bank_cycle = banks->bank_request[banks->bank_index(queue->next_process_index)].cycle_available;
 
-        // bank is busy
-        if (bank_request[read_channel][read_rank][read_bank].working) { // should we check this or not? how do we know if bank is busy or not for all requests in the queue?
+            next = next_event(next, (bank_cycle > queue->next_process_cycle) ? bank_cycle : queue->next_process_cycle, current);
+        }
+    }
 
-            //DP ( if (warmup_complete[0]) {
-            //cout << queue->NAME << " " << __func__ << " instr_id: " << queue->entry[i].instr_id << " bank is busy";
-            //cout << " swrites: " << scheduled_writes[channel] << " sreads: " << scheduled_reads[channel];
-            //cout << " write: " << +bank_request[read_channel][read_rank][read_bank].is_write << " read: " << +bank_request[read_channel][read_rank][read_bank].is_read << hex;
-            //cout << " address: " << queue->entry[i].address << dec << " channel: " << read_channel << " rank: " << read_rank << " bank: " << read_bank << endl; });
+    return next;
+}
 
+// the pending request of an idle bank with the lowest scheduler priority, the oldest among equals
+int MEMORY_CONTROLLER::pick_request(PACKET_QUEUE *queue, uint8_t *row_buffer_hit)
+{
+    DRAM_QUEUE_BANKS *banks = queue_banks(queue);
+    uint32_t channel = queue->is_WQ ? (queue - WQ) : (queue - RQ);
+    uint8_t demote = prefetch_demote && (queue->occupancy >= (queue->SIZE >> 1));
+
+    uint32_t best = queue->SIZE;
+    uint64_t best_priority = UINT64_MAX;
+    uint8_t best_hit = 0;
+    for (uint32_t b=0; b<DRAM_BANKS_PER_CHANNEL; b++) {
+        if ((banks->bank[b].occupancy == 0) || banks->bank_request[b].working)
             continue;
-        }
 
-        read_row = dram_get_row(read_addr);
-        //read_column = dram_get_column(read_addr);
+        for (uint32_t i=banks->bank[b].head; i<queue->SIZE; i=banks->slot[i].next) {
+            uint8_t row_hit = (banks->slot[i].row == banks->bank_request[b].open_row);
+            uint64_t priority = scheduler->priority(channel, b, &queue->entry[i], row_hit, banks->slot[i].enqueued, current_core_cycle[queue->entry[i].cpu]);
+            if (demote && (queue->entry[i].type == PREFETCH))
+                priority |= (1ull << 63);
 
-        // check open row
-        if (bank_request[read_channel][read_rank][read_bank].open_row != read_row) {
+            if ((priority < best_priority) || ((priority == best_priority) && banks->older(i, best))) {
+                best = i;
+                best_priority = priority;
+                best_hit = row_hit;
+            }
+        }
+    }
 
-            /*
-            DP ( if (warmup_complete[0]) {
-            cout << queue->NAME << " " << __func__ << " instr_id: " << queue->entry[i].instr_id << " row is inactive";
-            cout << " swrites: " << scheduled_writes[channel] << " sreads: " << scheduled_reads[channel];
-            cout << " write: " << +bank_request[read_channel][read_rank][read_bank].is_write << " read: " << +bank_request[read_channel][read_rank][read_bank].is_read << hex;
-            cout << " address: " << queue->entry[i].address << dec << " channel: " << read_channel << " rank: " << read_rank << " bank: " << read_bank << endl; });
-            */
+    if (best == queue->SIZE)
+        return -1;
 
-            continue;
-        }
+    *row_buffer_hit = best_hit;
+    return best;
+}
 
-        // select the oldest entry
-        if (queue->entry[i].event_cycle < oldest_cycle) {
-            oldest_cycle = queue->entry[i].event_cycle;
-            oldest_index = i;
-            row_buffer_hit = 1;
-        }
-    }
+void MEMORY_CONTROLLER::schedule(PACKET_QUEUE *queue)
+{
+    DRAM_QUEUE_BANKS *banks = queue_banks(queue);
+    uint8_t  row_buffer_hit = 0;
 
-    if (oldest_index == -1) { // no matching open_row (row buffer miss)
+    // a refresh closes every row of its rank, so the open row hits have to be found again
+    if (timing_model != DRAM_TIMING_SIMPLE)
+        refresh_rows(queue->is_WQ ? (queue - WQ) : (queue - RQ), current_core_cycle[queue->entry[queue->next_schedule_index].cpu]);
 
-        oldest_cycle = UINT64_MAX;
-        for (uint32_t i=0; i<queue->SIZE; i++) {
+    int oldest_index = -1;
+    if ((scheduler->kind == DRAM_SCHED_FRFCFS) && (prefetch_demote == 0)) {
 
-            // already scheduled
-            if (queue->entry[i].scheduled)
-                continue;
+        // the oldest open row hit of any idle bank, otherwise the oldest request of any idle bank
+        uint32_t oldest_hit = queue->SIZE, oldest_any = queue->SIZE;
+        for (uint32_t b=0; b<DRAM_BANKS_PER_CHANNEL; b++) {
 
-            // empty entry
-            read_addr = queue->entry[i].address;
-            if (read_addr == 0)
+            // nothing waiting, or bank is busy
+            if ((banks->bank[b].occupancy == 0) || banks->bank_request[b].working)
                 continue;
 
-            // bank is busy
-            read_channel = dram_get_channel(read_addr);
-            read_rank = dram_get_rank(read_addr);
-            read_bank = dram_get_bank(read_addr);
-            if (bank_request[read_channel][read_rank][read_bank].working)
-                continue;
+            if (banks->bank[b].stale)
+                banks->refresh(b);
 
-            //read_row = dram_get_row(read_addr);
-            //read_column = dram_get_column(read_addr);
+            if ((banks->bank[b].oldest_hit < queue->SIZE) && banks->older(banks->bank[b].oldest_hit, oldest_hit))
+                oldest_hit = banks->bank[b].oldest_hit;
+            if (banks->older(banks->bank[b].oldest, oldest_any))
+                oldest_any = banks->bank[b].oldest;
+        }
 
-            // select the oldest entry
-            if (queue->entry[i].event_cycle < oldest_cycle) {
-                oldest_cycle = queue->entry[i].event_cycle;
-                oldest_index = i;
-            }
+        if (oldest_hit < queue->SIZE) {
+            oldest_index = oldest_hit;
+            row_buffer_hit = 1;
         }
+        else if (oldest_any < queue->SIZE)
+            oldest_index = oldest_any;
     }
+    else
+        oldest_index = pick_request(queue, &row_buffer_hit);
 
     // at this point, the scheduler knows which bank to access and if the request is a row buffer hit or miss
     if (oldest_index != -1) { // scheduler might not find anything if all requests are already scheduled or all banks are busy
 
-        uint64_t LATENCY = 0;
+        uint32_t op_cpu = queue->entry[oldest_index].cpu,
+            op_channel = queue->is_WQ ? (queue - WQ) : (queue - RQ),
+            op_rank = banks->slot[oldest_index].rank,
+            op_bank = banks->slot[oldest_index].bank,
+            op_row = banks->slot[oldest_index].row;
+        #ifdef DEBUG_PRINT
+        uint32_t op_column = dram_get_column(queue->entry[oldest_index].address);
+        #endif
+
+        BANK_REQUEST *request = dram_bank(op_channel, op_rank, op_bank);
+        uint32_t open_row = request->open_row;
         if (row_buffer_hit)
+            banks->slot[oldest_index].outcome = DRAM_ROW_HIT;
+        else if (open_row == UINT32_MAX)
+            banks->slot[oldest_index].outcome = DRAM_ROW_MISS;
+        else
+            banks->slot[oldest_index].outcome = DRAM_ROW_CONFLICT;
+
+        if (page_policy == DRAM_PAGE_ADAPTIVE)
+            train_row_predictor(op_channel, op_rank, op_bank, op_row);
+
+        uint64_t LATENCY = 0;
+        if (timing_model != DRAM_TIMING_SIMPLE)
+            LATENCY = ddr_latency(op_channel, op_rank, op_bank, row_buffer_hit, queue->is_WQ, current_core_cycle[op_cpu]);
+        else if (row_buffer_hit)
             LATENCY = tCAS;
+        else if ((page_policy != DRAM_PAGE_OPEN) && (open_row == UINT32_MAX)) {
+            // the page policy precharged the bank, the ACT only waits for that precharge to finish
+            uint64_t act = activate_cycle[(op_channel*DRAM_RANKS + op_rank)*DRAM_BANKS + op_bank];
+            LATENCY = ((act > current_core_cycle[op_cpu]) ? (act - current_core_cycle[op_cpu]) : 0) + tRCD + tCAS;
+        }
         else
             LATENCY = tRP + tRCD + tCAS;
 
-        uint64_t op_addr = queue->entry[oldest_index].address;
-        uint32_t op_cpu = queue->entry[oldest_index].cpu,
-            op_channel = dram_get_channel(op_addr),
-            op_rank = dram_get_rank(op_addr),
-            op_bank = dram_get_bank(op_addr),
-            op_row = dram_get_row(op_addr);
-        #ifdef DEBUG_PRINT
-        uint32_t op_column = dram_get_column(op_addr);
-        #endif
+        scheduler->scheduled(op_channel, op_rank*DRAM_BANKS + op_bank, &queue->entry[oldest_index], row_buffer_hit, LATENCY, current_core_cycle[op_cpu]);
+
+        banks->erase(oldest_index);
 
         // this bank is now busy
-        bank_request[op_channel][op_rank][op_bank].working = 1;
-        bank_request[op_channel][op_rank][op_bank].working_type = queue->entry[oldest_index].type;
-        bank_request[op_channel][op_rank][op_bank].cycle_available = current_core_cycle[op_cpu] + LATENCY;
+        request->working = 1;
+        request->working_type = queue->entry[oldest_index].type;
+        request->cycle_available = current_core_cycle[op_cpu] + LATENCY;
 
-        bank_request[op_channel][op_rank][op_bank].request_index = oldest_index;
-        bank_request[op_channel][op_rank][op_bank].row_buffer_hit = row_buffer_hit;
+        request->request_index = oldest_index;
+        request->row_buffer_hit = row_buffer_hit;
         if (queue->is_WQ) {
-            bank_request[op_channel][op_rank][op_bank].is_write = 1;
-            bank_request[op_channel][op_rank][op_bank].is_read = 0;
+            request->is_write = 1;
+            request->is_read = 0;
             scheduled_writes[op_channel]++;
         }
         else {
-            bank_request[op_channel][op_rank][op_bank].is_write = 0;
-            bank_request[op_channel][op_rank][op_bank].is_read = 1;
+            request->is_write = 0;
+            request->is_read = 1;
             scheduled_reads[op_channel]++;
         }
 
         // update open row
-        bank_request[op_channel][op_rank][op_bank].open_row = op_row;
+        request->open_row = op_row;
+        open_row_changed(op_channel, op_rank, op_bank);
 
         queue->entry[oldest_index].scheduled = 1;
         queue->entry[oldest_index].event_cycle = current_core_cycle[op_cpu] + LATENCY;
@@ -264,7 +492,7 @@ void MEMORY_CONTROLLER::schedule(PACKET_QUEUE *queue)
 
         DP(if (warmup_complete[op_cpu]) {
             cout << "[" << queue->NAME << "] " <<  __func__ << " instr_id: " << queue->entry[oldest_index].instr_id;
-            cout << " row buffer: " << (row_buffer_hit ? (int)bank_request[op_channel][op_rank][op_bank].open_row : -1) << hex;
+            cout << " row buffer: " << (row_buffer_hit ? (int)request->open_row : -1) << hex;
             cout << " address: " << queue->entry[oldest_index].address << " full_addr: " << queue->entry[oldest_index].full_addr << dec;
             cout << " index: " << oldest_index << " occupancy: " << queue->occupancy;
             cout << " ch: " << op_channel << " rank: " << op_rank << " bank: " << op_bank; // wrong from here
@@ -274,6 +502,183 @@ void MEMORY_CONTROLLER::schedule(PACKET_QUEUE *queue)
     }
 }
 
+// the index of the last all-bank refresh of the rank that started by cycle, 0 if there was none
+// the refreshes of the ranks are staggered over tREFI so that a channel never loses all its ranks at once
+uint64_t MEMORY_CONTROLLER::refresh_window(uint32_t rank, uint64_t cycle)
+{
+    uint64_t offset = rank * (timing.tREFI / DRAM_RANKS);
+    if (cycle < offset + timing.tREFI)
+        return 0;
+
+    return (cycle - offset) / timing.tREFI;
+}
+
+// the first cycle from cycle on at which the rank is not refreshing
+uint64_t MEMORY_CONTROLLER::after_refresh(uint32_t rank, uint64_t cycle)
+{
+    uint64_t window = refresh_window(rank, cycle);
+    if (window == 0)
+        return cycle;
+
+    uint64_t end = rank * (timing.tREFI / DRAM_RANKS) + window * timing.tREFI + timing.tRFC;
+
+    return (cycle < end) ? end : cycle;
+}
+
+void MEMORY_CONTROLLER::refresh_rows(uint32_t channel, uint64_t current)
+{
+    for (uint32_t i=0; i<DRAM_RANKS; i++) {
+        DRAM_RANK_STATE *state = &rank_state[channel*DRAM_RANKS + i];
+        uint64_t window = refresh_window(i, current);
+        if (window == state->refresh_window)
+            continue;
+
+        timing_stats[channel].refresh += window - state->refresh_window;
+        state->refresh_window = window;
+
+        for (uint32_t j=0; j<DRAM_BANKS; j++) {
+            dram_bank(channel, i, j)->open_row = UINT32_MAX;
+            open_row_changed(channel, i, j);
+        }
+    }
+}
+
+// issues the commands of a request under the DDR rank constraints and returns the cycles until its data is ready
+// the precharge waits for write recovery, the ACT for tRRD and tFAW, the CAS for tCCD, and neither lands in a refresh
+uint64_t MEMORY_CONTROLLER::ddr_latency(uint32_t channel, uint32_t rank, uint32_t bank, uint8_t row_buffer_hit, uint8_t is_write, uint64_t current)
+{
+    DRAM_RANK_STATE *state = &rank_state[channel*DRAM_RANKS + rank];
+    DRAM_TIMING_STATS *stats = &timing_stats[channel];
+    BANK_REQUEST *request = dram_bank(channel, rank, bank);
+    uint64_t *precharge = &precharge_cycle[(channel*DRAM_RANKS + rank)*DRAM_BANKS + bank];
+    uint32_t group = bank & (timing.bank_groups - 1);
+    uint64_t cas = current, ready;
+
+    if (row_buffer_hit == 0) {
+        uint64_t act = current;
+
+        // a closed bank activates once the precharge of the page policy is done, an open one precharges first
+        if (request->open_row != UINT32_MAX) {
+            if (*precharge > act) {
+                stats->write_recovery_stall += *precharge - act;
+                act = *precharge;
+            }
+            act += tRP;
+        }
+        else if (activate_cycle[(channel*DRAM_RANKS + rank)*DRAM_BANKS + bank] > act)
+            act = activate_cycle[(channel*DRAM_RANKS + rank)*DRAM_BANKS + bank];
+
+        ready = act;
+        uint64_t newest = state->act_cycle[(state->act_head + 3) & 3];
+        if (act < newest + timing.tRRD_S)
+            act = newest + timing.tRRD_S;
+        if (act < state->group_act_cycle[group] + timing.tRRD_L)
+            act = state->group_act_cycle[group] + timing.tRRD_L;
+        if (act < state->act_cycle[state->act_head] + timing.tFAW)
+            act = state->act_cycle[state->act_head] + timing.tFAW;
+        stats->act_stall += act - ready;
+
+        ready = act;
+        act = after_refresh(rank, act);
+        stats->refresh_stall += act - ready;
+
+        state->act_cycle[state->act_head] = act;
+        state->act_head = (state->act_head + 1) & 3;
+        state->group_act_cycle[group] = act;
+
+        cas = act + tRCD;
+    }
+    else {
+        ready = cas;
+        cas = after_refresh(rank, cas);
+        stats->refresh_stall += cas - ready;
+    }
+
+    // earliest slot at least tCCD_S away from every recent CAS of the rank and tCCD_L from those of the same group,
+    // every move passes one CAS for good, so this ends within DRAM_CAS_HISTORY moves
+    ready = cas;
+    for (uint8_t moved=1; moved; ) {
+        moved = 0;
+        for (uint32_t i=0; i<DRAM_CAS_HISTORY; i++) {
+            uint64_t gap = (state->cas_group[i] == group) ? timing.tCCD_L : timing.tCCD_S;
+            if ((cas + gap > state->cas_cycle[i]) && (state->cas_cycle[i] + gap > cas)) {
+                cas = state->cas_cycle[i] + gap;
+                moved = 1;
+            }
+        }
+    }
+    stats->cas_stall += cas - ready;
+
+    state->cas_cycle[state->cas_head] = cas;
+    state->cas_group[state->cas_head] = group;
+    state->cas_head = (state->cas_head + 1) % DRAM_CAS_HISTORY;
+
+    // tCAS stands in for the write latency
+    if (is_write && (*precharge < cas + tCAS + DRAM_DBUS_RETURN_TIME + timing.tWR))
+        *precharge = cas + tCAS + DRAM_DBUS_RETURN_TIME + timing.tWR;
+
+    return cas + tCAS - current;
+}
+
+// the adaptive predictor learns whether a request to the bank hits the row of the request before it
+void MEMORY_CONTROLLER::train_row_predictor(uint32_t channel, uint32_t rank, uint32_t bank, uint32_t row)
+{
+    uint32_t b = (channel*DRAM_RANKS + rank)*DRAM_BANKS + bank;
+
+    if (last_row[b] != UINT32_MAX) {
+        if (row == last_row[b]) {
+            if (row_predictor[b] < DRAM_ROW_PREDICTOR_MAX)
+                row_predictor[b]++;
+        }
+        else if (row_predictor[b] > 0)
+            row_predictor[b]--;
+    }
+    last_row[b] = row;
+}
+
+// counts the row buffer outcome of a finished request and lets the page policy close its row
+void MEMORY_CONTROLLER::request_done(PACKET_QUEUE *queue, uint32_t index, uint32_t channel, uint32_t rank, uint32_t bank, uint64_t current)
+{
+    row_outcome[queue_banks(queue)->slot[index].outcome][queue->entry[index].type]++;
+
+    policy_precharge(channel, rank, bank, current);
+}
+
+// whether a queued read or write of the bank hits its open row
+uint8_t MEMORY_CONTROLLER::row_hit_pending(uint32_t channel, uint32_t rank, uint32_t bank)
+{
+    DRAM_QUEUE_BANKS *queues[2] = { &RQ_banks[channel], &WQ_banks[channel] };
+    uint32_t b = rank*DRAM_BANKS + bank;
+
+    for (uint32_t i=0; i<2; i++) {
+        if (queues[i]->bank[b].stale)
+            queues[i]->refresh(b);
+        if (queues[i]->bank[b].oldest_hit < queues[i]->queue->SIZE)
+            return 1;
+    }
+
+    return 0;
+}
+
+// closes the bank's row unless the page policy keeps it open, a known pending hit always keeps it open
+void MEMORY_CONTROLLER::policy_precharge(uint32_t channel, uint32_t rank, uint32_t bank, uint64_t current)
+{
+    uint32_t b = (channel*DRAM_RANKS + rank)*DRAM_BANKS + bank;
+
+    if ((page_policy == DRAM_PAGE_OPEN) || ((page_policy == DRAM_PAGE_ADAPTIVE) && (row_predictor[b] > (DRAM_ROW_PREDICTOR_MAX >> 1))))
+        return;
+
+    if (row_hit_pending(channel, rank, bank))
+        return;
+
+    // the precharge starts after write recovery, which only the DDR timing models track
+    uint64_t precharge = (precharge_cycle[b] > current) ? precharge_cycle[b] : current;
+    activate_cycle[b] = precharge + tRP;
+
+    dram_bank(channel, rank, bank)->open_row = UINT32_MAX;
+    open_row_changed(channel, rank, bank);
+}
+
 void MEMORY_CONTROLLER::process(PACKET_QUEUE *queue)
 {
     uint32_t request_index = queue->next_process_index;
@@ -282,24 +687,25 @@ void MEMORY_CONTROLLER::process(PACKET_QUEUE *queue)
     if (request_index == queue->SIZE)
         assert(0);
 
+    DRAM_QUEUE_BANKS *banks = queue_banks(queue);
     uint8_t  op_type = queue->entry[request_index].type;
-    uint64_t op_addr = queue->entry[request_index].address;
     uint32_t op_cpu = queue->entry[request_index].cpu,
-        op_channel = dram_get_channel(op_addr),
-        op_rank = dram_get_rank(op_addr),
-        op_bank = dram_get_bank(op_addr);
+        op_channel = queue->is_WQ ? (queue - WQ) : (queue - RQ),
+        op_rank = banks->slot[request_index].rank,
+        op_bank = banks->slot[request_index].bank;
     #ifdef DEBUG_PRINT
-    uint32_t op_row = dram_get_row(op_addr),
-        op_column = dram_get_column(op_addr);
+    uint32_t op_row = banks->slot[request_index].row,
+        op_column = dram_get_column(queue->entry[request_index].address);
     #endif
+    BANK_REQUEST *request = dram_bank(op_channel, op_rank, op_bank);
 
     // sanity check
-    if (bank_request[op_channel][op_rank][op_bank].request_index != (int)request_index) {
+    if (request->request_index != (int)request_index) {
         assert(0);
     }
 
     // paid all DRAM access latency, data is ready to be processed
-    if (bank_request[op_channel][op_rank][op_bank].cycle_available <= current_core_cycle[op_cpu]) {
+    if (request->cycle_available <= current_core_cycle[op_cpu]) {
 
         // check if data bus is available
         if (dbus_cycle_available[op_channel] <= current_core_cycle[op_cpu]) {
@@ -308,17 +714,21 @@ void MEMORY_CONTROLLER::process(PACKET_QUEUE *queue)
                 // update data bus cycle time
                 dbus_cycle_available[op_channel] = current_core_cycle[op_cpu] + DRAM_DBUS_RETURN_TIME;
 
-                if (bank_request[op_channel][op_rank][op_bank].row_buffer_hit)
+                if (request->row_buffer_hit)
                     queue->ROW_BUFFER_HIT++;
                 else
                     queue->ROW_BUFFER_MISS++;
 
+                core_stats[op_cpu].writes++;
+                core_stats[op_cpu].row_hits += request->row_buffer_hit;
+
                 // this bank is ready for another DRAM request
-                bank_request[op_channel][op_rank][op_bank].request_index = -1;
-                bank_request[op_channel][op_rank][op_bank].row_buffer_hit = 0;
-                bank_request[op_channel][op_rank][op_bank].working = false;
-                bank_request[op_channel][op_rank][op_bank].is_write = 0;
-                bank_request[op_channel][op_rank][op_bank].is_read = 0;
+                request->request_index = -1;
+                request->row_buffer_hit = 0;
+                request->working = false;
+                request->is_write = 0;
+                request->is_read = 0;
+                request_done(queue, request_index, op_channel, op_rank, op_bank, current_core_cycle[op_cpu]);
 
                 scheduled_writes[op_channel]--;
             }
@@ -338,17 +748,23 @@ void MEMORY_CONTROLLER::process(PACKET_QUEUE *queue)
                 // send data back to the core cache hierarchy
                 upper_level_dcache[op_cpu]->return_data(&queue->entry[request_index]);
 
-                if (bank_request[op_channel][op_rank][op_bank].row_buffer_hit)
+                if (request->row_buffer_hit)
                     queue->ROW_BUFFER_HIT++;
                 else
                     queue->ROW_BUFFER_MISS++;
 
+                core_stats[op_cpu].reads++;
+                core_stats[op_cpu].prefetches += (op_type == PREFETCH);
+                core_stats[op_cpu].row_hits += request->row_buffer_hit;
+                core_stats[op_cpu].read_latency += dbus_cycle_available[op_channel] - banks->slot[request_index].enqueued;
+
                 // this bank is ready for another DRAM request
-                bank_request[op_channel][op_rank][op_bank].request_index = -1;
-                bank_request[op_channel][op_rank][op_bank].row_buffer_hit = 0;
-                bank_request[op_channel][op_rank][op_bank].working = false;
-                bank_request[op_channel][op_rank][op_bank].is_write = 0;
-                bank_request[op_channel][op_rank][op_bank].is_read = 0;
+                request->request_index = -1;
+                request->row_buffer_hit = 0;
+                request->working = false;
+                request->is_write = 0;
+                request->is_read = 0;
+                request_done(queue, request_index, op_channel, op_rank, op_bank, current_core_cycle[op_cpu]);
 
                 scheduled_reads[op_channel]--;
             }
@@ -379,17 +795,17 @@ void MEMORY_CONTROLLER::process(PACKET_QUEUE *queue)
                 // send data back to the core cache hierarchy
                 upper_level_dcache[op_cpu]->return_data(&queue->entry[request_index]);
 
-                if (bank_request[op_channel][op_rank][op_bank].row_buffer_hit)
+                if (request->row_buffer_hit)
                     queue->ROW_BUFFER_HIT++;
                 else
                     queue->ROW_BUFFER_MISS++;
 
                 // this bank is ready for another DRAM request
-                bank_request[op_channel][op_rank][op_bank].request_index = -1;
-                bank_request[op_channel][op_rank][op_bank].row_buffer_hit = 0;
-                bank_request[op_channel][op_rank][op_bank].working = false;
-                bank_request[op_channel][op_rank][op_bank].is_write = 0;
-                bank_request[op_channel][op_rank][op_bank].is_read = 0;
+                request->request_index = -1;
+                request->row_buffer_hit = 0;
+                request->working = false;
+                request->is_write = 0;
+                request->is_read = 0;
 
                 scheduled_reads[op_channel]--;
 
@@ -402,18 +818,18 @@ void MEMORY_CONTROLLER::process(PACKET_QUEUE *queue)
             #endif
 
             dbus_cycle_congested[op_channel] += (dbus_cycle_available[op_channel] - current_core_cycle[op_cpu]);
-            bank_request[op_channel][op_rank][op_bank].cycle_available = dbus_cycle_available[op_channel];
+            request->cycle_available = dbus_cycle_available[op_channel];
             dbus_congested[NUM_TYPES][NUM_TYPES]++;
             dbus_congested[NUM_TYPES][op_type]++;
-            dbus_congested[bank_request[op_channel][op_rank][op_bank].working_type][NUM_TYPES]++;
-            dbus_congested[bank_request[op_channel][op_rank][op_bank].working_type][op_type]++;
+            dbus_congested[request->working_type][NUM_TYPES]++;
+            dbus_congested[request->working_type][op_type]++;
 
             DP(if (warmup_complete[op_cpu]) {
                 cout << "[" << queue->NAME << "] " <<  __func__ << " dbus_occupied" << hex;
                 cout << " address: " << queue->entry[request_index].address << " full_addr: " << queue->entry[request_index].full_addr << dec;
                 cout << " occupancy: " << queue->occupancy << " channel: " << op_channel << " rank: " << op_rank << " bank: " << op_bank;
                 cout << " row: " << op_row << " column: " << op_column;
-                cout << " current_cycle: " << current_core_cycle[op_cpu] << " event_cycle: " << bank_request[op_channel][op_rank][op_bank].cycle_available << endl;
+                cout << " current_cycle: " << current_core_cycle[op_cpu] << " event_cycle: " << request->cycle_available << endl;
             });
         }
     }
@@ -472,6 +888,7 @@ int MEMORY_CONTROLLER::add_rq(PACKET *packet)
 
             RQ[channel].entry[index] = *packet;
             RQ[channel].occupancy++;
+            enqueue(&RQ[channel], index);
 
             #ifdef DEBUG_PRINT
             uint32_t channel = dram_get_channel(packet->address),
@@ -515,6 +932,7 @@ int MEMORY_CONTROLLER::add_wq(PACKET *packet)
 
             WQ[channel].entry[index] = *packet;
             WQ[channel].occupancy++;
+            enqueue(&WQ[channel], index);
 
             #ifdef DEBUG_PRINT
             uint32_t channel = dram_get_channel(packet->address),
@@ -552,23 +970,20 @@ void MEMORY_CONTROLLER::return_data(PACKET *packet)
 
 void MEMORY_CONTROLLER::update_schedule_cycle(PACKET_QUEUE *queue)
 {
-    // update next_schedule_cycle
-    uint64_t min_cycle = UINT64_MAX;
+    // update next_schedule_cycle, the oldest unscheduled request is the oldest of its bank
+    DRAM_QUEUE_BANKS *banks = queue_banks(queue);
     uint32_t min_index = queue->SIZE;
-    for (uint32_t i=0; i<queue->SIZE; i++) {
-        /*
-        DP (if (warmup_complete[queue->entry[min_index].cpu]) {
-        cout << "[" << queue->NAME << "] " <<  __func__ << " instr_id: " << queue->entry[i].instr_id;
-        cout << " index: " << i << " address: " << hex << queue->entry[i].address << dec << " scheduled: " << +queue->entry[i].scheduled;
-        cout << " event: " << queue->entry[i].event_cycle << " min_cycle: " << min_cycle << endl;
-        });
-        */
+    for (uint32_t b=0; b<DRAM_BANKS_PER_CHANNEL; b++) {
+        if (banks->bank[b].occupancy == 0)
+            continue;
 
-        if (queue->entry[i].address && (queue->entry[i].scheduled == 0) && (queue->entry[i].event_cycle < min_cycle)) {
-            min_cycle = queue->entry[i].event_cycle;
-            min_index = i;
-        }
+        if (banks->bank[b].stale)
+            banks->refresh(b);
+
+        if (banks->older(banks->bank[b].oldest, min_index))
+            min_index = banks->bank[b].oldest;
     }
+    uint64_t min_cycle = (min_index < queue->SIZE) ? queue->entry[min_index].event_cycle : UINT64_MAX;
 
     queue->next_schedule_cycle = min_cycle;
     queue->next_schedule_index = min_index;
@@ -585,15 +1000,18 @@ void MEMORY_CONTROLLER::update_schedule_cycle(PACKET_QUEUE *queue)
 
 void MEMORY_CONTROLLER::update_process_cycle(PACKET_QUEUE *queue)
 {
-    // update next_process_cycle
-    uint64_t min_cycle = UINT64_MAX;
+    // update next_process_cycle, a scheduled request is the one its bank is working on
+    DRAM_QUEUE_BANKS *banks = queue_banks(queue);
     uint32_t min_index = queue->SIZE;
-    for (uint32_t i=0; i<queue->SIZE; i++) {
-        if (queue->entry[i].scheduled && (queue->entry[i].event_cycle < min_cycle)) {
-            min_cycle = queue->entry[i].event_cycle;
-            min_index = i;
-        }
+    for (uint32_t b=0; b<DRAM_BANKS_PER_CHANNEL; b++) {
+        BANK_REQUEST *request = &banks->bank_request[b];
+        if ((request->request_index < 0) || !(queue->is_WQ ? request->is_write : request->is_read))
+            continue;
+
+        if (banks->older(request->request_index, min_index))
+            min_index = request->request_index;
     }
+    uint64_t min_cycle = (min_index < queue->SIZE) ? queue->entry[min_index].event_cycle : UINT64_MAX;
 
     queue->next_process_cycle = min_cycle;
     queue->next_process_index = min_index;
@@ -608,6 +1026,93 @@ void MEMORY_CONTROLLER::update_process_cycle(PACKET_QUEUE *queue)
     }
 }
 
+// decodes a request that has just been written into queue->entry[index] and adds it to its bank
+void MEMORY_CONTROLLER::enqueue(PACKET_QUEUE *queue, uint32_t index)
+{
+    DRAM_QUEUE_BANKS *banks = queue_banks(queue);
+    uint64_t address = queue->entry[index].address;
+
+    banks->slot[index].rank = dram_get_rank(address);
+    banks->slot[index].bank = dram_get_bank(address);
+    banks->slot[index].row = dram_get_row(address);
+    banks->slot[index].enqueued = current_core_cycle[queue->entry[index].cpu];
+    banks->insert(index);
+}
+
+// open row hits of both queues of the channel have to be found again for this bank
+void MEMORY_CONTROLLER::open_row_changed(uint32_t channel, uint32_t rank, uint32_t bank)
+{
+    RQ_banks[channel].bank[rank*DRAM_BANKS + bank].stale = 1;
+    WQ_banks[channel].bank[rank*DRAM_BANKS + bank].stale = 1;
+}
+
+void DRAM_QUEUE_BANKS::initialize(PACKET_QUEUE *q, BANK_REQUEST *b, ARENA &arena)
+{
+    queue = q;
+    bank_request = b;
+    slot = arena.allocate<DRAM_SLOT>(queue->SIZE);
+    bank = arena.allocate<DRAM_BANK_QUEUE>(DRAM_BANKS_PER_CHANNEL);
+
+    for (uint32_t i=0; i<DRAM_BANKS_PER_CHANNEL; i++) {
+        bank[i].head = queue->SIZE;
+        bank[i].occupancy = 0;
+        bank[i].oldest = queue->SIZE;
+        bank[i].oldest_hit = queue->SIZE;
+        bank[i].stale = 0;
+    }
+}
+
+void DRAM_QUEUE_BANKS::insert(uint32_t index)
+{
+    DRAM_BANK_QUEUE *b = &bank[bank_index(index)];
+
+    slot[index].prev = queue->SIZE;
+    slot[index].next = b->head;
+    if (b->head < queue->SIZE)
+        slot[b->head].prev = index;
+    b->head = index;
+    b->occupancy++;
+
+    if (b->stale)
+        return;
+
+    if (older(index, b->oldest))
+        b->oldest = index;
+    if ((slot[index].row == bank_request[bank_index(index)].open_row) && older(index, b->oldest_hit))
+        b->oldest_hit = index;
+}
+
+void DRAM_QUEUE_BANKS::erase(uint32_t index)
+{
+    DRAM_BANK_QUEUE *b = &bank[bank_index(index)];
+
+    if (slot[index].prev < queue->SIZE)
+        slot[slot[index].prev].next = slot[index].next;
+    else
+        b->head = slot[index].next;
+    if (slot[index].next < queue->SIZE)
+        slot[slot[index].next].prev = slot[index].prev;
+    b->occupancy--;
+
+    if ((index == b->oldest) || (index == b->oldest_hit))
+        b->stale = 1;
+}
+
+void DRAM_QUEUE_BANKS::refresh(uint32_t b)
+{
+    uint32_t open_row = bank_request[b].open_row;
+
+    bank[b].oldest = queue->SIZE;
+    bank[b].oldest_hit = queue->SIZE;
+    for (uint32_t i=bank[b].head; i<queue->SIZE; i=slot[i].next) {
+        if (older(i, bank[b].oldest))
+            bank[b].oldest = i;
+        if ((slot[i].row == open_row) && older(i, bank[b].oldest_hit))
+            bank[b].oldest_hit = i;
+    }
+    bank[b].stale = 0;
+}
+
 int MEMORY_CONTROLLER::check_dram_queue(PACKET_QUEUE *queue, PACKET *packet)
 {
     // search write queue
@@ -644,9 +1149,11 @@ uint32_t MEMORY_CONTROLLER::dram_get_channel(uint64_t address)
     if (LOG2_DRAM_CHANNELS == 0)
         return 0;
 
-    int shift = 0;
+    uint32_t channel = (uint32_t)(address >> channel_shift) & (DRAM_CHANNELS - 1);
+    if (mapping == DRAM_MAP_XOR)
+        channel ^= (dram_get_row(address) >> LOG2_DRAM_BANKS) & (DRAM_CHANNELS - 1);
 
-    return (uint32_t)(address >> shift) & (DRAM_CHANNELS - 1);
+    return channel;
 }
 
 uint32_t MEMORY_CONTROLLER::dram_get_bank(uint64_t address)
@@ -654,9 +1161,11 @@ uint32_t MEMORY_CONTROLLER::dram_get_bank(uint64_t address)
     if (LOG2_DRAM_BANKS == 0)
         return 0;
 
-    int shift = LOG2_DRAM_CHANNELS;
+    uint32_t bank = (uint32_t)(address >> bank_shift) & (DRAM_BANKS - 1);
+    if (mapping == DRAM_MAP_XOR)
+        bank ^= dram_get_row(address) & (DRAM_BANKS - 1);
 
-    return (uint32_t)(address >> shift) & (DRAM_BANKS - 1);
+    return bank;
 }
 
 uint32_t MEMORY_CONTROLLER::dram_get_column(uint64_t address)
@@ -664,9 +1173,7 @@ uint32_t MEMORY_CONTROLLER::dram_get_column(uint64_t address)
     if (LOG2_DRAM_COLUMNS == 0)
         return 0;
 
-    int shift = LOG2_DRAM_BANKS + LOG2_DRAM_CHANNELS;
-
-    return (uint32_t)(address >> shift) & (DRAM_COLUMNS - 1);
+    return (uint32_t)(address >> column_shift) & (DRAM_COLUMNS - 1);
 }
 
 uint32_t MEMORY_CONTROLLER::dram_get_rank(uint64_t address)
@@ -674,9 +1181,7 @@ uint32_t MEMORY_CONTROLLER::dram_get_rank(uint64_t address)
     if (LOG2_DRAM_RANKS == 0)
         return 0;
 
-    int shift = LOG2_DRAM_COLUMNS + LOG2_DRAM_BANKS + LOG2_DRAM_CHANNELS;
-
-    return (uint32_t)(address >> shift) & (DRAM_RANKS - 1);
+    return (uint32_t)(address >> rank_shift) & (DRAM_RANKS - 1);
 }
 
 uint32_t MEMORY_CONTROLLER::dram_get_row(uint64_t address)
@@ -684,9 +1189,7 @@ uint32_t MEMORY_CONTROLLER::dram_get_row(uint64_t address)
     if (LOG2_DRAM_ROWS == 0)
         return 0;
 
-    int shift = LOG2_DRAM_RANKS + LOG2_DRAM_COLUMNS + LOG2_DRAM_BANKS + LOG2_DRAM_CHANNELS;
-
-    return (uint32_t)(address >> shift) & (DRAM_ROWS - 1);
+    return (uint32_t)(address >> row_shift) & (DRAM_ROWS - 1);
 }
 
 uint32_t MEMORY_CONTROLLER::get_occupancy(uint8_t queue_type, uint64_t address)
@@ -0,0 +1,130 @@
+#include "dram_scheduler.h"
+
+const char *DRAM_SCHEDULER_NAME[NUM_DRAM_SCHEDULERS] = { "frfcfs", "frfcfs_cap", "bliss", "atlas" };
+
+uint8_t find_dram_scheduler(const char *name)
+{
+    for (uint8_t i=0; i<NUM_DRAM_SCHEDULERS; i++) {
+        if (strcmp(name, DRAM_SCHEDULER_NAME[i]) == 0)
+            return i;
+    }
+
+    cerr << "[DRAM] unknown scheduler " << name << ", available:";
+    for (uint8_t i=0; i<NUM_DRAM_SCHEDULERS; i++)
+        cerr << " " << DRAM_SCHEDULER_NAME[i];
+    cerr << endl;
+    assert(0);
+
+    return DRAM_SCHED_FRFCFS;
+}
+
+DRAM_SCHEDULER *create_dram_scheduler(uint8_t kind, uint32_t row_hit_cap, ARENA &arena)
+{
+    if (kind == DRAM_SCHED_FRFCFS_CAP) {
+        FRFCFS_CAP_SCHEDULER *scheduler = arena.allocate<FRFCFS_CAP_SCHEDULER>(1);
+        scheduler->cap = row_hit_cap;
+        return scheduler;
+    }
+    if (kind == DRAM_SCHED_BLISS)
+        return arena.allocate<BLISS_SCHEDULER>(1);
+    if (kind == DRAM_SCHED_ATLAS)
+        return arena.allocate<ATLAS_SCHEDULER>(1);
+
+    return arena.allocate<DRAM_SCHEDULER>(1);
+}
+
+void FRFCFS_CAP_SCHEDULER::initialize(uint32_t channels, uint32_t banks, ARENA &arena)
+{
+    banks_per_channel = banks;
+    streak = arena.allocate<uint32_t>(channels*banks);
+    for (uint32_t i=0; i<channels*banks; i++)
+        streak[i] = 0;
+}
+
+uint64_t FRFCFS_CAP_SCHEDULER::priority(uint32_t channel, uint32_t bank, PACKET *packet, uint8_t row_hit, uint64_t enqueued, uint64_t current)
+{
+    // a bank that has served cap hits in a row falls back to FCFS, so an older miss of the same bank gets its turn
+    return (row_hit && (streak[channel*banks_per_channel + bank] < cap)) ? 0 : 1;
+}
+
+void FRFCFS_CAP_SCHEDULER::scheduled(uint32_t channel, uint32_t bank, PACKET *packet, uint8_t row_hit, uint64_t latency, uint64_t current)
+{
+    if (row_hit)
+        streak[channel*banks_per_channel + bank]++;
+    else
+        streak[channel*banks_per_channel + bank] = 0;
+}
+
+void BLISS_SCHEDULER::initialize(uint32_t channels, uint32_t banks, ARENA &arena)
+{
+    last_cpu = arena.allocate<uint32_t>(channels);
+    streak = arena.allocate<uint32_t>(channels);
+    for (uint32_t i=0; i<channels; i++) {
+        last_cpu[i] = NUM_CPUS;
+        streak[i] = 0;
+    }
+}
+
+uint64_t BLISS_SCHEDULER::priority(uint32_t channel, uint32_t bank, PACKET *packet, uint8_t row_hit, uint64_t enqueued, uint64_t current)
+{
+    if (current >= next_clearing) {
+        for (uint32_t i=0; i<NUM_CPUS; i++)
+            blacklisted[i] = 0;
+        next_clearing = current - (current % BLISS_CLEARING_INTERVAL) + BLISS_CLEARING_INTERVAL;
+    }
+
+    // non-blacklisted before blacklisted cores, FR-FCFS within each
+    return ((uint64_t)blacklisted[packet->cpu] << 1) | (row_hit ? 0 : 1);
+}
+
+void BLISS_SCHEDULER::scheduled(uint32_t channel, uint32_t bank, PACKET *packet, uint8_t row_hit, uint64_t latency, uint64_t current)
+{
+    if (last_cpu[channel] == packet->cpu)
+        streak[channel]++;
+    else {
+        last_cpu[channel] = packet->cpu;
+        streak[channel] = 1;
+    }
+
+    if (streak[channel] >= BLISS_THRESHOLD)
+        blacklisted[packet->cpu] = 1;
+}
+
+// ranks the cores by the service they attained, weighting the past quanta by ATLAS_HISTORY
+void ATLAS_SCHEDULER::end_quantum(uint64_t current)
+{
+    for (uint32_t i=0; i<NUM_CPUS; i++) {
+        total_service[i] = ATLAS_HISTORY*total_service[i] + (1 - ATLAS_HISTORY)*quantum_service[i];
+        quantum_service[i] = 0;
+    }
+
+    for (uint32_t i=0; i<NUM_CPUS; i++) {
+        rank[i] = 0;
+        for (uint32_t j=0; j<NUM_CPUS; j++) {
+            if ((total_service[j] < total_service[i]) || ((total_service[j] == total_service[i]) && (j < i)))
+                rank[i]++;
+        }
+    }
+
+    next_quantum = current - (current % ATLAS_QUANTUM) + ATLAS_QUANTUM;
+}
+
+uint64_t ATLAS_SCHEDULER::priority(uint32_t channel, uint32_t bank, PACKET *packet, uint8_t row_hit, uint64_t enqueued, uint64_t current)
+{
+    if (current >= next_quantum)
+        end_quantum(current);
+
+    // requests past the age threshold first, then the least attained service, then FR-FCFS
+    uint64_t young = (current - enqueued < ATLAS_AGE_THRESHOLD) ? 1 : 0;
+
+    return (young << 32) | ((uint64_t)rank[packet->cpu] << 1) | (row_hit ? 0 : 1);
+}
+
+void ATLAS_SCHEDULER::scheduled(uint32_t channel, uint32_t bank, PACKET *packet, uint8_t row_hit, uint64_t latency, uint64_t current)
+{
+    if (current >= next_quantum)
+        end_quantum(current);
+
+    // the service a request attains is the time it holds its bank
+    quantum_service[packet->cpu] += latency;
+}
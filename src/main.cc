@@ -3,6 +3,9 @@
 #include <getopt.h>
 #include "ooo_cpu.h"
 #include "uncore.h"
+#include "core_threads.h"
+#include "batch.h"
+#include "page_table.h"
 #include <fstream>
 
 uint8_t warmup_complete[NUM_CPUS],
@@ -11,7 +14,8 @@ all_warmup_complete = 0,
 all_simulation_complete = 0,
 MAX_INSTR_DESTINATIONS = NUM_INSTR_DESTINATIONS,
 knob_cloudsuite = 0,
-knob_low_bandwidth = 0;
+knob_low_bandwidth = 0,
+knob_trace_thread = 0;
 
 uint64_t warmup_instructions     = 1000000,
 simulation_instructions = 10000000,
@@ -22,7 +26,6 @@ time_t start_time;
 // PAGE TABLE
 uint32_t PAGE_TABLE_LATENCY = 0, SWAP_LATENCY = 0;
 queue <uint64_t > page_queue;
-map <uint64_t, uint64_t> page_table, inverse_table, recent_page, unique_cl[NUM_CPUS];
 uint64_t previous_ppage, num_adjacent_page, num_cl[NUM_CPUS], allocated_pages, num_page[NUM_CPUS], minor_fault[NUM_CPUS], major_fault[NUM_CPUS];
 
 void record_roi_stats(uint32_t cpu, CACHE *cache)
@@ -124,9 +127,38 @@ void print_dram_stats()
         cout << " DBUS_CONGESTED: " << setw(10) << uncore.DRAM.dbus_congested[NUM_TYPES][NUM_TYPES] << endl;
         cout << " WQ ROW_BUFFER_HIT: " << setw(10) << uncore.DRAM.WQ[i].ROW_BUFFER_HIT << "  ROW_BUFFER_MISS: " << setw(10) << uncore.DRAM.WQ[i].ROW_BUFFER_MISS;
         cout << "  FULL: " << setw(10) << uncore.DRAM.WQ[i].FULL << endl;
+        if (uncore.DRAM.timing_model != DRAM_TIMING_SIMPLE) {
+            DRAM_TIMING_STATS *stats = &uncore.DRAM.timing_stats[i];
+            cout << " REFRESH: " << setw(10) << stats->refresh << "  REFRESH_STALL: " << setw(10) << stats->refresh_stall << endl;
+            cout << " ACT_STALL: " << setw(10) << stats->act_stall << "  CAS_STALL: " << setw(10) << stats->cas_stall;
+            cout << "  WRITE_RECOVERY_STALL: " << setw(10) << stats->write_recovery_stall << endl;
+        }
         cout << endl;
     }
 
+    const char *type_name[NUM_TYPES] = { "LOAD", "RFO", "PREFETCH", "WRITEBACK" };
+    for (uint32_t i=0; i<NUM_TYPES; i++) {
+        cout << " " << setw(9) << left << type_name[i] << right << " ROW_HIT: " << setw(10) << uncore.DRAM.row_outcome[DRAM_ROW_HIT][i];
+        cout << "  ROW_MISS: " << setw(10) << uncore.DRAM.row_outcome[DRAM_ROW_MISS][i];
+        cout << "  ROW_CONFLICT: " << setw(10) << uncore.DRAM.row_outcome[DRAM_ROW_CONFLICT][i] << endl;
+    }
+    cout << endl;
+
+    for (uint32_t i=0; i<NUM_CPUS; i++) {
+        DRAM_CORE_STATS *stats = &uncore.DRAM.core_stats[i];
+        uint64_t cycles = current_core_cycle[i] - ooo_cpu[i].begin_sim_cycle;
+
+        cout << " CPU " << i << " READ: " << setw(10) << stats->reads << "  PREFETCH: " << setw(10) << stats->prefetches;
+        cout << "  WRITE: " << setw(10) << stats->writes << "  ROW_BUFFER_HIT: " << setw(10) << stats->row_hits << endl;
+        cout << " CPU " << i << " AVG_READ_LATENCY: ";
+        if (stats->reads)
+            cout << (1.0*stats->read_latency) / stats->reads;
+        else
+            cout << "-";
+        cout << "  BANDWIDTH: " << (cycles ? ((1.0*(stats->reads + stats->writes)*BLOCK_SIZE*CPU_FREQ) / cycles) : 0) << " MB/s" << endl;
+    }
+    cout << endl;
+
     uint64_t total_congested_cycle = 0;
     for (uint32_t i=0; i<DRAM_CHANNELS; i++)
         total_congested_cycle += uncore.DRAM.dbus_cycle_congested[i];
@@ -211,6 +243,13 @@ void finish_warmup()
         uncore.DRAM.RQ[i].ROW_BUFFER_MISS = 0;
         uncore.DRAM.WQ[i].ROW_BUFFER_HIT = 0;
         uncore.DRAM.WQ[i].ROW_BUFFER_MISS = 0;
+        uncore.DRAM.timing_stats[i] = DRAM_TIMING_STATS();
+    }
+    for (uint32_t i=0; i<NUM_CPUS; i++)
+        uncore.DRAM.core_stats[i] = DRAM_CORE_STATS();
+    for (uint32_t i=0; i<NUM_DRAM_ROW_OUTCOMES; i++) {
+        for (uint32_t j=0; j<NUM_TYPES; j++)
+            uncore.DRAM.row_outcome[i][j] = 0;
     }
 
     // set actual cache latency
@@ -314,84 +353,66 @@ uint64_t va_to_pa(uint32_t cpu, uint64_t instr_id, uint64_t va, uint64_t unique_
     // smart random number generator
     uint64_t random_ppage;
 
-    map <uint64_t, uint64_t>::iterator pr = page_table.begin();
-    map <uint64_t, uint64_t>::iterator ppage_check = inverse_table.begin();
+    // cores running on worker threads share the page table
+    unique_lock<mutex> page_table_guard(core_threads.page_table_lock, defer_lock);
+    if (core_threads.enabled)
+        page_table_guard.lock();
+
+    // once DRAM is full, swaps and the CLOCK referenced bits make every translation depend on the others,
+    // so hits are made in (cycle, cpu) order too, not only the allocations
+    uint8_t ordered = core_threads.enabled && core_threads.swapping;
+    if (ordered)
+        core_threads.wait_page_allocation(cpu, page_table_guard);
 
     // check unique cache line footprint
-    map <uint64_t, uint64_t>::iterator cl_check = unique_cl[cpu].find(unique_va >> LOG2_BLOCK_SIZE);
-    if (cl_check == unique_cl[cpu].end()) { // we've never seen this cache line before
-        unique_cl[cpu].insert(make_pair(unique_va >> LOG2_BLOCK_SIZE, 0));
+    if (unique_cl[cpu].insert(unique_va >> LOG2_BLOCK_SIZE)) // we've never seen this cache line before
         num_cl[cpu]++;
-    }
-    else
-        cl_check->second++;
 
-    pr = page_table.find(vpage);
-    if (pr == page_table.end()) { // no VA => PA translation found 
+    uint64_t ppage, *pr = page_table.find(vpage);
+    if (pr == NULL) { // no VA => PA translation found 
 
-        if (allocated_pages >= DRAM_PAGES) { // not enough memory
+        // pages are allocated in the order the single-threaded loop would allocate them
+        if (core_threads.enabled && (ordered == 0))
+            core_threads.wait_page_allocation(cpu, page_table_guard);
 
-            // TODO: elaborate page replacement algorithm
-            // here, ChampSim randomly selects a page that is not recently used and we only track 32K recently accessed pages
-            uint8_t  found_NRU = 0;
-            uint64_t NRU_vpage = 0; // implement it
-            map <uint64_t, uint64_t>::iterator pr2 = recent_page.begin();
-            for (pr = page_table.begin(); pr != page_table.end(); pr++) {
+        // worker threads only start swapping at the quantum boundary after DRAM fills up
+        if ((allocated_pages >= DRAM_PAGES) && ((core_threads.enabled == 0) || core_threads.swapping)) { // not enough memory
 
-                NRU_vpage = pr->first;
-                if (recent_page.find(NRU_vpage) == recent_page.end()) {
-                    found_NRU = 1;
-                    break;
-                }
-            }
-            #ifdef SANITY_CHECK
-            if (found_NRU == 0)
-                assert(0);
-
-            if (pr == page_table.end())
-                assert(0);
-            #endif
+            // CLOCK picks a frame whose page was not translated since the hand last passed it
+            uint64_t victim = page_frames.find_victim();
+            PAGE_FRAME &frame = page_frames.frame[victim];
+            uint64_t NRU_vpage = frame.vpage,
+                     mapped_ppage = frame.ppage;
             DP(if (warmup_complete[cpu]) {
-                cout << "[SWAP] update page table NRU_vpage: " << hex << pr->first << " new_vpage: " << vpage << " ppage: " << pr->second << dec << endl;
+                cout << "[SWAP] update page table NRU_vpage: " << hex << NRU_vpage << " new_vpage: " << vpage << " ppage: " << mapped_ppage << dec << endl;
             });
 
-            // update page table with new VA => PA mapping
-            // since we cannot change the key value already inserted in a map structure, we need to erase the old node and add a new node
-            uint64_t mapped_ppage = pr->second;
-            page_table.erase(pr);
-            page_table.insert(make_pair(vpage, mapped_ppage));
-
-            // update inverse table with new PA => VA mapping
-            ppage_check = inverse_table.find(mapped_ppage);
-            #ifdef SANITY_CHECK
-            if (ppage_check == inverse_table.end())
-                assert(0);
-            #endif
-            ppage_check->second = vpage;
-
-            DP(if (warmup_complete[cpu]) {
-                cout << "[SWAP] update inverse table NRU_vpage: " << hex << NRU_vpage << " new_vpage: ";
-                cout << ppage_check->second << " ppage: " << ppage_check->first << dec << endl;
-            });
+            // update page table with new VA => PA mapping, the inverse table keeps pointing at the same frame
+            page_table.erase(NRU_vpage);
+            page_table.insert(vpage, victim);
+            frame.vpage = vpage;
+            frame.referenced = 1;
 
             // update page_queue
             page_queue.pop();
             page_queue.push(vpage);
 
-            // invalidate corresponding vpage and ppage from the cache hierarchy
+            // invalidate corresponding vpage and the lines of ppage that may be cached
             ooo_cpu[cpu].ITLB.invalidate_entry(NRU_vpage);
             ooo_cpu[cpu].DTLB.invalidate_entry(NRU_vpage);
             ooo_cpu[cpu].STLB.invalidate_entry(NRU_vpage);
-            for (uint32_t i=0; i<BLOCK_SIZE; i++) {
-                uint64_t cl_addr = (mapped_ppage << 6) | i;
+            for (uint64_t resident = frame.resident; resident; resident &= resident - 1) {
+                uint64_t cl_addr = (mapped_ppage << (LOG2_PAGE_SIZE - LOG2_BLOCK_SIZE)) | __builtin_ctzll(resident);
                 ooo_cpu[cpu].L1I.invalidate_entry(cl_addr);
                 ooo_cpu[cpu].L1D.invalidate_entry(cl_addr);
                 ooo_cpu[cpu].L2C.invalidate_entry(cl_addr);
                 uncore.LLC.invalidate_entry(cl_addr);
             }
+            frame.resident = 0;
 
             // swap complete
             swap = 1;
+            ppage = mapped_ppage;
         }
         else {
             uint8_t fragmented = 0;
@@ -409,10 +430,10 @@ uint64_t va_to_pa(uint32_t cpu, uint64_t instr_id, uint64_t va, uint64_t unique_
             //random_ppage |= (cpu<<(32-LOG2_PAGE_SIZE)); 
 
             while (1) { // try to find an empty physical page number
-                ppage_check = inverse_table.find(random_ppage); // check if this page can be allocated 
-                if (ppage_check != inverse_table.end()) { // random_ppage is not available
+                uint64_t *ppage_check = inverse_table.find(random_ppage); // check if this page can be allocated 
+                if (ppage_check != NULL) { // random_ppage is not available
                     DP(if (warmup_complete[cpu]) {
-                        cout << "vpage: " << hex << ppage_check->first << " is already mapped to ppage: " << random_ppage << dec << endl;
+                        cout << "vpage: " << hex << page_frames.frame[*ppage_check].vpage << " is already mapped to ppage: " << random_ppage << dec << endl;
                     });
 
                     if (num_adjacent_page > 0)
@@ -431,8 +452,9 @@ uint64_t va_to_pa(uint32_t cpu, uint64_t instr_id, uint64_t va, uint64_t unique_
 
             // insert translation to page tables
             //printf("Insert  num_adjacent_page: %u  vpage: %lx  ppage: %lx\n", num_adjacent_page, vpage, random_ppage);
-            page_table.insert(make_pair(vpage, random_ppage));
-            inverse_table.insert(make_pair(random_ppage, vpage));
+            uint64_t frame = page_frames.allocate(vpage, random_ppage);
+            page_table.insert(vpage, frame);
+            inverse_table.insert(random_ppage, frame);
             page_queue.push(vpage);
             previous_ppage = random_ppage;
             num_adjacent_page--;
@@ -446,6 +468,7 @@ uint64_t va_to_pa(uint32_t cpu, uint64_t instr_id, uint64_t va, uint64_t unique_
                     cout << "Recalculate num_adjacent_page: " << num_adjacent_page << endl;
                 });
             }
+            ppage = random_ppage;
         }
 
         if (swap)
@@ -454,16 +477,12 @@ uint64_t va_to_pa(uint32_t cpu, uint64_t instr_id, uint64_t va, uint64_t unique_
             minor_fault[cpu]++;
     }
     else {
-        //printf("Found  vpage: %lx  random_ppage: %lx\n", vpage, pr->second);
+        PAGE_FRAME &frame = page_frames.frame[*pr];
+        frame.referenced = 1;
+        ppage = frame.ppage;
+        //printf("Found  vpage: %lx  random_ppage: %lx\n", vpage, ppage);
     }
 
-    pr = page_table.find(vpage);
-    #ifdef SANITY_CHECK
-    if (pr == page_table.end())
-        assert(0);
-    #endif
-    uint64_t ppage = pr->second;
-
     uint64_t pa = ppage << LOG2_PAGE_SIZE;
     pa |= voffset;
 
@@ -506,6 +525,15 @@ int main(int argc, char** argv)
     sigIntHandler.sa_flags = 0;
     sigaction(SIGINT, &sigIntHandler, NULL);
 
+    // batch mode, only the forked simulation children continue past this point with their job's command line
+    if ((argc > 2) && (strcmp(argv[1], "-batch") == 0)) {
+        if (batch.run(argc, argv) == 0)
+            return (batch.num_failed->load() == 0) ? 0 : 1;
+
+        argc = batch.job_argv.size() - 1;
+        argv = batch.job_argv.data();
+    }
+
     cout << endl << "*** ChampSim Multicore Out-of-Order Simulator ***" << endl << endl;
 
     // initialize knobs
@@ -513,6 +541,37 @@ int main(int argc, char** argv)
 
     uint32_t seed_number = 0;
 
+    // decoded instructions kept per core for replaying the trace, 0 disables it
+    uint64_t decoded_cache_mb = 0;
+
+    // fetch blocks the branch predictor may run ahead of fetch, 0 keeps the front end coupled
+    uint32_t ftq_size = 0;
+
+    // jump over cycles in which nothing can happen
+    uint8_t skip_idle_cycles = 0;
+    uint64_t skipped_cycles = 0;
+
+    // DRAM address mapping, the geometry knobs set DRAM_CHANNELS and friends directly
+    uint8_t dram_mapping = DRAM_MAP_LINE,
+            dram_timing = DRAM_TIMING_SIMPLE,
+            dram_scheduler = DRAM_SCHED_FRFCFS,
+            dram_prefetch_demote = 0,
+            dram_page_policy = DRAM_PAGE_OPEN,
+            dram_banks_knob = 0;
+    uint32_t dram_row_hit_cap = DEFAULT_DRAM_ROW_HIT_CAP;
+
+    // run every core on its own thread, synchronizing with the uncore every quantum cycles
+    uint8_t knob_core_threads = 0;
+    uint64_t quantum = 1;
+
+    // modules, any of the names listed in module_list.h
+    const char *branch_predictor_name = DEFAULT_BRANCH_PREDICTOR,
+          *l1i_prefetcher_name = DEFAULT_L1I_PREFETCHER,
+          *l1d_prefetcher_name = DEFAULT_L1D_PREFETCHER,
+          *l2c_prefetcher_name = DEFAULT_L2C_PREFETCHER,
+          *llc_prefetcher_name = DEFAULT_LLC_PREFETCHER,
+          *llc_replacement_name = DEFAULT_LLC_REPLACEMENT;
+
     // check to see if knobs changed using getopt_long()
     int c;
     while (1) {
@@ -523,6 +582,29 @@ int main(int argc, char** argv)
             { "hide_heartbeat", no_argument, 0, 'h' },
             { "cloudsuite", no_argument, 0, 'c' },
             { "low_bandwidth", no_argument, 0, 'b' },
+            { "trace_thread", no_argument, 0, 'd' },
+            { "decoded_cache", required_argument, 0, 'e' },
+            { "ftq_size", required_argument, 0, 'f' },
+            { "skip_idle_cycles", no_argument, 0, 's' },
+            { "dram_channels", required_argument, 0, 'H' },
+            { "dram_ranks", required_argument, 0, 'K' },
+            { "dram_banks", required_argument, 0, 'A' },
+            { "dram_rows", required_argument, 0, 'O' },
+            { "dram_columns", required_argument, 0, 'L' },
+            { "dram_mapping", required_argument, 0, 'M' },
+            { "dram_timing", required_argument, 0, 'T' },
+            { "dram_scheduler", required_argument, 0, 'G' },
+            { "dram_row_hit_cap", required_argument, 0, 'N' },
+            { "dram_prefetch_demote", no_argument, 0, 'P' },
+            { "dram_page_policy", required_argument, 0, 'E' },
+            { "core_threads", no_argument, 0, 'p' },
+            { "quantum", required_argument, 0, 'q' },
+            { "branch_predictor", required_argument, 0, 'B' },
+            { "l1i_prefetcher", required_argument, 0, 'I' },
+            { "l1d_prefetcher", required_argument, 0, 'D' },
+            { "l2c_prefetcher", required_argument, 0, 'C' },
+            { "llc_prefetcher", required_argument, 0, 'F' },
+            { "llc_replacement", required_argument, 0, 'R' },
             { "traces", no_argument, 0, 't' },
             { 0, 0, 0, 0 }
         };
@@ -554,6 +636,76 @@ int main(int argc, char** argv)
         case 'b':
             knob_low_bandwidth = 1;
             break;
+        case 'd':
+            knob_trace_thread = 1;
+            break;
+        case 'e':
+            decoded_cache_mb = atol(optarg);
+            break;
+        case 'f':
+            ftq_size = atol(optarg);
+            break;
+        case 's':
+            skip_idle_cycles = 1;
+            break;
+        case 'H':
+            DRAM_CHANNELS = atol(optarg);
+            break;
+        case 'K':
+            DRAM_RANKS = atol(optarg);
+            break;
+        case 'A':
+            DRAM_BANKS = atol(optarg);
+            dram_banks_knob = 1;
+            break;
+        case 'O':
+            DRAM_ROWS = atol(optarg);
+            break;
+        case 'L':
+            DRAM_COLUMNS = atol(optarg);
+            break;
+        case 'M':
+            dram_mapping = find_dram_mapping(optarg);
+            break;
+        case 'T':
+            dram_timing = find_dram_timing(optarg);
+            break;
+        case 'G':
+            dram_scheduler = find_dram_scheduler(optarg);
+            break;
+        case 'N':
+            dram_row_hit_cap = atol(optarg);
+            break;
+        case 'P':
+            dram_prefetch_demote = 1;
+            break;
+        case 'E':
+            dram_page_policy = find_dram_page_policy(optarg);
+            break;
+        case 'p':
+            knob_core_threads = 1;
+            break;
+        case 'q':
+            quantum = atol(optarg);
+            break;
+        case 'B':
+            branch_predictor_name = optarg;
+            break;
+        case 'I':
+            l1i_prefetcher_name = optarg;
+            break;
+        case 'D':
+            l1d_prefetcher_name = optarg;
+            break;
+        case 'C':
+            l2c_prefetcher_name = optarg;
+            break;
+        case 'F':
+            llc_prefetcher_name = optarg;
+            break;
+        case 'R':
+            llc_replacement_name = optarg;
+            break;
         case 't':
             traces_encountered = 1;
             break;
@@ -570,13 +722,41 @@ int main(int argc, char** argv)
     cout << "Simulation Instructions: " << simulation_instructions << endl;
     //cout << "Scramble Loads: " << (knob_scramble_loads ? "ture" : "false") << endl;
     cout << "Number of CPUs: " << NUM_CPUS << endl;
+    cout << "Trace decoder thread: " << (knob_trace_thread ? "enabled" : "disabled") << endl;
+    cout << "Decoded instruction cache: " << decoded_cache_mb << " MB per core" << endl;
+    if (ftq_size)
+        cout << "Fetch target queue: " << ftq_size << " blocks" << endl;
+    else
+        cout << "Fetch target queue: disabled" << endl;
+    cout << "Idle cycle skipping: " << (skip_idle_cycles ? "enabled" : "disabled") << endl;
+    if (knob_core_threads) {
+        cout << "Core threads: enabled quantum: " << quantum << " cycles" << endl;
+        // LLC and DRAM replies only reach a core at the next quantum boundary
+        if (quantum > 1)
+            cerr << "[CORE_THREADS] quantum " << quantum << " delays every LLC reply by up to " << quantum
+                 << " cycles, results are approximate (use -quantum 1 for cycle-accurate runs)" << endl;
+    }
+    else
+        cout << "Core threads: disabled" << endl;
     cout << "LLC sets: " << LLC_SET << endl;
     cout << "LLC ways: " << LLC_WAY << endl;
 
+    const BRANCH_PREDICTOR_MODULE *branch_predictor = find_branch_predictor(branch_predictor_name);
+    const L1I_PREFETCHER_MODULE *l1i_prefetcher = find_l1i_prefetcher(l1i_prefetcher_name);
+    const L1D_PREFETCHER_MODULE *l1d_prefetcher = find_l1d_prefetcher(l1d_prefetcher_name);
+    const PREFETCHER_MODULE *l2c_prefetcher = find_l2c_prefetcher(l2c_prefetcher_name),
+          *llc_prefetcher = find_llc_prefetcher(llc_prefetcher_name);
+    const REPLACEMENT_MODULE *llc_replacement = find_llc_replacement(llc_replacement_name);
+    cout << "Modules: " << branch_predictor->name << " " << l1i_prefetcher->name << " " << l1d_prefetcher->name << " ";
+    cout << l2c_prefetcher->name << " " << llc_prefetcher->name << " " << llc_replacement->name << endl;
+
+    // a timing model may bring its own bank count, -dram_banks still overrides it
+    if ((dram_banks_knob == 0) && DRAM_TIMING_BANKS[dram_timing])
+        DRAM_BANKS = DRAM_TIMING_BANKS[dram_timing];
+
+    DRAM_MTPS = DRAM_TIMING_MTPS[dram_timing] ? DRAM_TIMING_MTPS[dram_timing] : DRAM_IO_FREQ;
     if (knob_low_bandwidth)
-        DRAM_MTPS = DRAM_IO_FREQ/4;
-    else
-        DRAM_MTPS = DRAM_IO_FREQ;
+        DRAM_MTPS /= 4;
 
     // DRAM access latency
     tRP  = (uint32_t)((1.0 * tRP_DRAM_NANOSECONDS  * CPU_FREQ) / 1000);
@@ -588,8 +768,31 @@ int main(int argc, char** argv)
     // note that dram burst length = BLOCK_SIZE/DRAM_CHANNEL_WIDTH
     DRAM_DBUS_RETURN_TIME = (BLOCK_SIZE / DRAM_CHANNEL_WIDTH) * (CPU_FREQ / DRAM_MTPS);
 
+    // a timing model with its own data rate rounds the burst up to whole CPU cycles instead, DDR5 splits the channel
+    // into two 32-bit subchannels with BL16, which together move a block every 8 beats: 7 cycles at 4800 MT/s
+    if (DRAM_TIMING_MTPS[dram_timing])
+        DRAM_DBUS_RETURN_TIME = ((BLOCK_SIZE / DRAM_CHANNEL_WIDTH) * CPU_FREQ + DRAM_MTPS - 1) / DRAM_MTPS;
+
+    // sizes the controller for the geometry knobs
+    uncore.DRAM.initialize(dram_mapping, dram_timing, dram_scheduler, dram_row_hit_cap, dram_prefetch_demote, dram_page_policy);
+
     printf("Off-chip DRAM Size: %u MB Channels: %u Width: %u-bit Data Rate: %u MT/s\n",
         DRAM_SIZE, DRAM_CHANNELS, 8*DRAM_CHANNEL_WIDTH, DRAM_MTPS);
+    printf("DRAM Ranks: %u Banks: %u Rows: %u Columns: %u Address Mapping: %s\n",
+        DRAM_RANKS, DRAM_BANKS, DRAM_ROWS, DRAM_COLUMNS, DRAM_MAPPING_NAME[dram_mapping]);
+    if (dram_timing != DRAM_TIMING_SIMPLE) {
+        printf("DRAM Timing: %s Bank Groups: %u tRRD_S: %u tRRD_L: %u tFAW: %u tCCD_S: %u tCCD_L: %u tWR: %u tREFI: %u tRFC: %u cycles\n",
+            DRAM_TIMING_NAME[dram_timing], uncore.DRAM.timing.bank_groups, uncore.DRAM.timing.tRRD_S, uncore.DRAM.timing.tRRD_L,
+            uncore.DRAM.timing.tFAW, uncore.DRAM.timing.tCCD_S, uncore.DRAM.timing.tCCD_L, uncore.DRAM.timing.tWR,
+            uncore.DRAM.timing.tREFI, uncore.DRAM.timing.tRFC);
+    }
+    else
+        printf("DRAM Timing: %s\n", DRAM_TIMING_NAME[dram_timing]);
+    printf("DRAM Scheduler: %s", DRAM_SCHEDULER_NAME[dram_scheduler]);
+    if (dram_scheduler == DRAM_SCHED_FRFCFS_CAP)
+        printf(" Row Hit Cap: %u", dram_row_hit_cap);
+    printf(" Prefetch Demotion: %s\n", dram_prefetch_demote ? "enabled" : "disabled");
+    printf("DRAM Page Policy: %s\n", DRAM_PAGE_POLICY_NAME[dram_page_policy]);
 
     // end consequence of knobs
 
@@ -605,10 +808,6 @@ int main(int argc, char** argv)
             sprintf(ooo_cpu[count_traces].trace_string, "%s", argv[i]);
 
             std::string full_name(argv[i]);
-            std::string last_dot = full_name.substr(full_name.find_last_of("."));
-
-            std::string fmtstr;
-            std::string decomp_program;
             if (full_name.substr(0, 4) == "http")
             {
                 // Check file exists
@@ -620,7 +819,6 @@ int main(int argc, char** argv)
                     std::cerr << "TRACE FILE NOT FOUND" << std::endl;
                     assert(0);
                 }
-                fmtstr = "wget -qO- %2$s | %1$s -dc";
             }
             else
             {
@@ -630,19 +828,12 @@ int main(int argc, char** argv)
                     std::cerr << "TRACE FILE NOT FOUND" << std::endl;
                     assert(0);
                 }
-                fmtstr = "%1$s -dc %2$s";
-            }
-
-            if (last_dot[1] == 'g') // gzip format
-                decomp_program = "gzip";
-            else if (last_dot[1] == 'x') // xz
-                decomp_program = "xz";
-            else {
-                std::cout << "ChampSim does not support traces other than gz or xz compression!" << std::endl;
-                assert(0);
             }
 
-            sprintf(ooo_cpu[count_traces].gunzip_command, fmtstr.c_str(), decomp_program.c_str(), argv[i]);
+            // decompression happens in-process, optionally on a decoder thread per core
+            ooo_cpu[count_traces].trace_reader.open(argv[i], knob_cloudsuite ? sizeof(cloudsuite_instr) : sizeof(input_instr), knob_trace_thread);
+            ooo_cpu[count_traces].decoded_trace.initialize(count_traces, decoded_cache_mb);
+            ooo_cpu[count_traces].ftq.initialize(ftq_size, ooo_cpu[count_traces].arena);
 
             char *pch[100];
             int count_str = 0;
@@ -663,12 +854,6 @@ int main(int argc, char** argv)
                 j++;
             }
 
-            ooo_cpu[count_traces].trace_file = popen(ooo_cpu[count_traces].gunzip_command, "r");
-            if (ooo_cpu[count_traces].trace_file == NULL) {
-                printf("\n*** Trace file not found: %s ***\n\n", argv[i]);
-                assert(0);
-            }
-
             count_traces++;
             if (count_traces > NUM_CPUS) {
                 printf("\n*** Too many traces for the configured number of cores ***\n\n");
@@ -701,6 +886,7 @@ int main(int argc, char** argv)
         ooo_cpu[i].ROB.cpu = i;
 
         // BRANCH PREDICTOR
+        ooo_cpu[i].branch_predictor_module = branch_predictor;
         ooo_cpu[i].initialize_branch_predictor();
 
         // TLBs
@@ -733,6 +919,7 @@ int main(int argc, char** argv)
         ooo_cpu[i].L1I.MAX_READ = 2;
         ooo_cpu[i].L1I.fill_level = FILL_L1;
         ooo_cpu[i].L1I.lower_level = &ooo_cpu[i].L2C;
+        ooo_cpu[i].l1i_prefetcher_module = l1i_prefetcher;
         ooo_cpu[i].l1i_prefetcher_initialize();
         ooo_cpu[i].L1I.l1i_prefetcher_cache_operate = cpu_l1i_prefetcher_cache_operate;
         ooo_cpu[i].L1I.l1i_prefetcher_cache_fill = cpu_l1i_prefetcher_cache_fill;
@@ -742,6 +929,7 @@ int main(int argc, char** argv)
         ooo_cpu[i].L1D.MAX_READ = (2 > MAX_READ_PER_CYCLE) ? MAX_READ_PER_CYCLE : 2;
         ooo_cpu[i].L1D.fill_level = FILL_L1;
         ooo_cpu[i].L1D.lower_level = &ooo_cpu[i].L2C;
+        ooo_cpu[i].L1D.l1d_prefetcher_module = l1d_prefetcher;
         ooo_cpu[i].L1D.l1d_prefetcher_initialize();
 
         ooo_cpu[i].L2C.cpu = i;
@@ -750,6 +938,7 @@ int main(int argc, char** argv)
         ooo_cpu[i].L2C.upper_level_icache[i] = &ooo_cpu[i].L1I;
         ooo_cpu[i].L2C.upper_level_dcache[i] = &ooo_cpu[i].L1D;
         ooo_cpu[i].L2C.lower_level = &uncore.LLC;
+        ooo_cpu[i].L2C.l2c_prefetcher_module = l2c_prefetcher;
         ooo_cpu[i].L2C.l2c_prefetcher_initialize();
 
         // SHARED CACHE
@@ -784,9 +973,14 @@ int main(int argc, char** argv)
         major_fault[i] = 0;
     }
 
+    uncore.LLC.llc_replacement_module = llc_replacement;
+    uncore.LLC.llc_prefetcher_module = llc_prefetcher;
     uncore.LLC.llc_initialize_replacement();
     uncore.LLC.llc_prefetcher_initialize();
 
+    if (knob_core_threads)
+        core_threads.start(quantum);
+
     // simulation entry point
     start_time = time(NULL);
     uint8_t run_simulation = 1;
@@ -798,53 +992,14 @@ int main(int argc, char** argv)
         elapsed_minute -= elapsed_hour*60;
         elapsed_second -= (elapsed_hour*3600 + elapsed_minute*60);
 
+        // with core threads, every core runs a whole quantum on its own worker before the uncore catches up
+        if (core_threads.enabled)
+            core_threads.run_quantum();
+
         for (int i=0; i<NUM_CPUS; i++) {
             // proceed one cycle
-            current_core_cycle[i]++;
-
-            //cout << "Trying to process instr_id: " << ooo_cpu[i].instr_unique_id << " fetch_stall: " << +ooo_cpu[i].fetch_stall;
-            //cout << " stall_cycle: " << stall_cycle[i] << " current: " << current_core_cycle[i] << endl;
-
-            // core might be stalled due to page fault or branch misprediction
-            if (stall_cycle[i] <= current_core_cycle[i]) {
-
-                // retire
-                if ((ooo_cpu[i].ROB.entry[ooo_cpu[i].ROB.head].executed == COMPLETED) && (ooo_cpu[i].ROB.entry[ooo_cpu[i].ROB.head].event_cycle <= current_core_cycle[i]))
-                    ooo_cpu[i].retire_rob();
-
-                // complete 
-                ooo_cpu[i].update_rob();
-
-                // schedule
-                uint32_t schedule_index = ooo_cpu[i].ROB.next_schedule;
-                if ((ooo_cpu[i].ROB.entry[schedule_index].scheduled == 0) && (ooo_cpu[i].ROB.entry[schedule_index].event_cycle <= current_core_cycle[i]))
-                    ooo_cpu[i].schedule_instruction();
-                // execute
-                ooo_cpu[i].execute_instruction();
-
-                ooo_cpu[i].update_rob();
-
-                // memory operation
-                ooo_cpu[i].schedule_memory_instruction();
-                ooo_cpu[i].execute_memory_instruction();
-
-                ooo_cpu[i].update_rob();
-
-                // decode
-                if (ooo_cpu[i].DECODE_BUFFER.occupancy > 0)
-                {
-                    ooo_cpu[i].decode_and_dispatch();
-                }
-
-                // fetch
-                ooo_cpu[i].fetch_instruction();
-
-                // read from trace
-                if ((ooo_cpu[i].IFETCH_BUFFER.occupancy < ooo_cpu[i].IFETCH_BUFFER.SIZE) && (ooo_cpu[i].fetch_stall == 0))
-                {
-                    ooo_cpu[i].read_from_trace();
-                }
-            }
+            if (core_threads.enabled == 0)
+                ooo_cpu[i].operate();
 
             // heartbeat information
             if (show_heartbeat && (ooo_cpu[i].num_retired >= ooo_cpu[i].next_print_instruction)) {
@@ -911,10 +1066,55 @@ int main(int argc, char** argv)
         }
 
         // TODO: should it be backward?
-        uncore.DRAM.operate();
-        uncore.LLC.operate();
+        if (core_threads.enabled == 0) {
+            uncore.DRAM.operate();
+            uncore.LLC.operate();
+        }
+
+        // fast-forward all cores to the cycle before the next one in which any core, cache or DRAM channel can change state
+        // cores advance in lockstep, so current_core_cycle[0] is the cycle that was just simulated
+        if (skip_idle_cycles && run_simulation) {
+            uint64_t current = current_core_cycle[0],
+                next = uncore.DRAM.next_event_cycle(current);
+
+            for (int i=0; (i<NUM_CPUS) && (next > current + 1); i++) {
+                // heartbeat, warmup and completion checks still due
+                if ((show_heartbeat && (ooo_cpu[i].num_retired >= ooo_cpu[i].next_print_instruction)) ||
+                    ((warmup_complete[i] == 0) && (ooo_cpu[i].num_retired > warmup_instructions)) ||
+                    (all_warmup_complete == NUM_CPUS) ||
+                    ((all_warmup_complete > NUM_CPUS) && (simulation_complete[i] == 0) && (ooo_cpu[i].num_retired >= (ooo_cpu[i].begin_sim_instr + ooo_cpu[i].simulation_instructions))))
+                    next = current + 1;
+
+                if (ooo_cpu[i].ROB.entry[ooo_cpu[i].ROB.head].ip)
+                    next = next_event(next, ooo_cpu[i].ROB.entry[ooo_cpu[i].ROB.head].event_cycle + DEADLOCK_CYCLE, current);
+
+                uint64_t core_event = ooo_cpu[i].next_event_cycle(current);
+                if (core_event < next)
+                    next = core_event;
+            }
+
+            if (next > current + 1) {
+                uint64_t llc_event = uncore.LLC.next_event_cycle(current);
+                if (llc_event < next)
+                    next = llc_event;
+            }
+
+            // requests still waiting for room in the LLC are retried every cycle
+            for (int i=0; (i<NUM_CPUS) && core_threads.enabled; i++)
+                if (core_threads.llc_port[i].pending.size())
+                    next = current + 1;
+
+            // nothing pending anywhere, leave it to the deadlock check
+            if ((next != UINT64_MAX) && (next > current + 1)) {
+                skipped_cycles += next - 1 - current;
+                for (int i=0; i<NUM_CPUS; i++)
+                    current_core_cycle[i] = next - 1;
+            }
+        }
     }
 
+    core_threads.stop();
+
     uint64_t elapsed_second = (uint64_t)(time(NULL) - start_time),
         elapsed_minute = elapsed_second / 60,
         elapsed_hour = elapsed_minute / 60;
@@ -922,6 +1122,8 @@ int main(int argc, char** argv)
     elapsed_second -= (elapsed_hour*3600 + elapsed_minute*60);
 
     cout << endl << "ChampSim completed all CPUs" << endl;
+    if (skip_idle_cycles)
+        cout << "Skipped idle cycles: " << skipped_cycles << endl;
     if (NUM_CPUS > 1) {
         cout << endl << "Total Simulation Statistics (not including warmup)" << endl;
         for (uint32_t i=0; i<NUM_CPUS; i++) {
@@ -967,5 +1169,8 @@ int main(int argc, char** argv)
     print_branch_stats();
     #endif
 
+    if (batch.result_path.size())
+        write_batch_result(batch.result_path.c_str());
+
     return 0;
 }
@@ -0,0 +1,202 @@
+#include "ooo_cpu.h"
+
+// MODULE REGISTRY
+// one entry per module of module_list.h, the generic hooks called by the core and the caches forward to the selected entry
+
+#define BRANCH_PREDICTOR_ENTRY(name) { #name, &O3_CPU::name##_initialize_branch_predictor, &O3_CPU::name##_predict_branch, &O3_CPU::name##_last_branch_result },
+#define L1I_PREFETCHER_ENTRY(name) { #name, &O3_CPU::name##_l1i_prefetcher_initialize, &O3_CPU::name##_l1i_prefetcher_branch_operate, \
+    &O3_CPU::name##_l1i_prefetcher_cache_operate, &O3_CPU::name##_l1i_prefetcher_cycle_operate, &O3_CPU::name##_l1i_prefetcher_cache_fill, \
+    &O3_CPU::name##_l1i_prefetcher_final_stats },
+#define L1D_PREFETCHER_ENTRY(name) { #name, &CACHE::name##_l1d_prefetcher_initialize, &CACHE::name##_l1d_prefetcher_operate, \
+    &CACHE::name##_l1d_prefetcher_cache_fill, &CACHE::name##_l1d_prefetcher_final_stats },
+#define L2C_PREFETCHER_ENTRY(name) { #name, &CACHE::name##_l2c_prefetcher_initialize, &CACHE::name##_l2c_prefetcher_operate, \
+    &CACHE::name##_l2c_prefetcher_cache_fill, &CACHE::name##_l2c_prefetcher_final_stats },
+#define LLC_PREFETCHER_ENTRY(name) { #name, &CACHE::name##_llc_prefetcher_initialize, &CACHE::name##_llc_prefetcher_operate, \
+    &CACHE::name##_llc_prefetcher_cache_fill, &CACHE::name##_llc_prefetcher_final_stats },
+#define LLC_REPLACEMENT_ENTRY(name) { #name, &CACHE::name##_llc_initialize_replacement, &CACHE::name##_llc_find_victim, \
+    &CACHE::name##_llc_update_replacement_state, &CACHE::name##_llc_replacement_final_stats },
+
+const BRANCH_PREDICTOR_MODULE branch_predictor_modules[] = { BRANCH_PREDICTOR_LIST(BRANCH_PREDICTOR_ENTRY) };
+const L1I_PREFETCHER_MODULE l1i_prefetcher_modules[] = { L1I_PREFETCHER_LIST(L1I_PREFETCHER_ENTRY) };
+const L1D_PREFETCHER_MODULE l1d_prefetcher_modules[] = { L1D_PREFETCHER_LIST(L1D_PREFETCHER_ENTRY) };
+const PREFETCHER_MODULE l2c_prefetcher_modules[] = { L2C_PREFETCHER_LIST(L2C_PREFETCHER_ENTRY) };
+const PREFETCHER_MODULE llc_prefetcher_modules[] = { LLC_PREFETCHER_LIST(LLC_PREFETCHER_ENTRY) };
+const REPLACEMENT_MODULE llc_replacement_modules[] = { LLC_REPLACEMENT_LIST(LLC_REPLACEMENT_ENTRY) };
+
+template <class T, size_t N>
+const T *find_module(const T (&modules)[N], const char *kind, const char *name)
+{
+    for (size_t i=0; i<N; i++) {
+        if (strcmp(modules[i].name, name) == 0)
+            return &modules[i];
+    }
+
+    cerr << "[MODULES] unknown " << kind << " " << name << ", available:";
+    for (size_t i=0; i<N; i++)
+        cerr << " " << modules[i].name;
+    cerr << endl;
+    assert(0);
+
+    return NULL;
+}
+
+const BRANCH_PREDICTOR_MODULE *find_branch_predictor(const char *name)
+{
+    return find_module(branch_predictor_modules, "branch predictor", name);
+}
+
+const L1I_PREFETCHER_MODULE *find_l1i_prefetcher(const char *name)
+{
+    return find_module(l1i_prefetcher_modules, "L1I prefetcher", name);
+}
+
+const L1D_PREFETCHER_MODULE *find_l1d_prefetcher(const char *name)
+{
+    return find_module(l1d_prefetcher_modules, "L1D prefetcher", name);
+}
+
+const PREFETCHER_MODULE *find_l2c_prefetcher(const char *name)
+{
+    return find_module(l2c_prefetcher_modules, "L2C prefetcher", name);
+}
+
+const PREFETCHER_MODULE *find_llc_prefetcher(const char *name)
+{
+    return find_module(llc_prefetcher_modules, "LLC prefetcher", name);
+}
+
+const REPLACEMENT_MODULE *find_llc_replacement(const char *name)
+{
+    return find_module(llc_replacement_modules, "LLC replacement policy", name);
+}
+
+// branch predictor
+void O3_CPU::initialize_branch_predictor()
+{
+    (this->*branch_predictor_module->initialize)();
+}
+
+uint8_t O3_CPU::predict_branch(uint64_t ip)
+{
+    return (this->*branch_predictor_module->predict)(ip);
+}
+
+void O3_CPU::last_branch_result(uint64_t ip, uint8_t taken)
+{
+    (this->*branch_predictor_module->last_result)(ip, taken);
+}
+
+// L1I prefetcher
+void O3_CPU::l1i_prefetcher_initialize()
+{
+    (this->*l1i_prefetcher_module->initialize)();
+}
+
+void O3_CPU::l1i_prefetcher_branch_operate(uint64_t ip, uint8_t branch_type, uint64_t branch_target)
+{
+    (this->*l1i_prefetcher_module->branch_operate)(ip, branch_type, branch_target);
+}
+
+void O3_CPU::l1i_prefetcher_cache_operate(uint64_t v_addr, uint8_t cache_hit, uint8_t prefetch_hit)
+{
+    (this->*l1i_prefetcher_module->cache_operate)(v_addr, cache_hit, prefetch_hit);
+}
+
+void O3_CPU::l1i_prefetcher_cycle_operate()
+{
+    (this->*l1i_prefetcher_module->cycle_operate)();
+}
+
+void O3_CPU::l1i_prefetcher_cache_fill(uint64_t v_addr, uint32_t set, uint32_t way, uint8_t prefetch, uint64_t evicted_v_addr)
+{
+    (this->*l1i_prefetcher_module->cache_fill)(v_addr, set, way, prefetch, evicted_v_addr);
+}
+
+void O3_CPU::l1i_prefetcher_final_stats()
+{
+    (this->*l1i_prefetcher_module->final_stats)();
+}
+
+// L1D prefetcher
+void CACHE::l1d_prefetcher_initialize()
+{
+    (this->*l1d_prefetcher_module->initialize)();
+}
+
+void CACHE::l1d_prefetcher_operate(uint64_t addr, uint64_t ip, uint8_t cache_hit, uint8_t type)
+{
+    (this->*l1d_prefetcher_module->operate)(addr, ip, cache_hit, type);
+}
+
+void CACHE::l1d_prefetcher_cache_fill(uint64_t addr, uint32_t set, uint32_t way, uint8_t prefetch, uint64_t evicted_addr, uint32_t metadata_in)
+{
+    (this->*l1d_prefetcher_module->cache_fill)(addr, set, way, prefetch, evicted_addr, metadata_in);
+}
+
+void CACHE::l1d_prefetcher_final_stats()
+{
+    (this->*l1d_prefetcher_module->final_stats)();
+}
+
+// L2C prefetcher
+void CACHE::l2c_prefetcher_initialize()
+{
+    (this->*l2c_prefetcher_module->initialize)();
+}
+
+uint32_t CACHE::l2c_prefetcher_operate(uint64_t addr, uint64_t ip, uint8_t cache_hit, uint8_t type, uint32_t metadata_in)
+{
+    return (this->*l2c_prefetcher_module->operate)(addr, ip, cache_hit, type, metadata_in);
+}
+
+uint32_t CACHE::l2c_prefetcher_cache_fill(uint64_t addr, uint32_t set, uint32_t way, uint8_t prefetch, uint64_t evicted_addr, uint32_t metadata_in)
+{
+    return (this->*l2c_prefetcher_module->cache_fill)(addr, set, way, prefetch, evicted_addr, metadata_in);
+}
+
+void CACHE::l2c_prefetcher_final_stats()
+{
+    (this->*l2c_prefetcher_module->final_stats)();
+}
+
+// LLC prefetcher
+void CACHE::llc_prefetcher_initialize()
+{
+    (this->*llc_prefetcher_module->initialize)();
+}
+
+uint32_t CACHE::llc_prefetcher_operate(uint64_t addr, uint64_t ip, uint8_t cache_hit, uint8_t type, uint32_t metadata_in)
+{
+    return (this->*llc_prefetcher_module->operate)(addr, ip, cache_hit, type, metadata_in);
+}
+
+uint32_t CACHE::llc_prefetcher_cache_fill(uint64_t addr, uint32_t set, uint32_t way, uint8_t prefetch, uint64_t evicted_addr, uint32_t metadata_in)
+{
+    return (this->*llc_prefetcher_module->cache_fill)(addr, set, way, prefetch, evicted_addr, metadata_in);
+}
+
+void CACHE::llc_prefetcher_final_stats()
+{
+    (this->*llc_prefetcher_module->final_stats)();
+}
+
+// LLC replacement
+void CACHE::llc_initialize_replacement()
+{
+    (this->*llc_replacement_module->initialize)();
+}
+
+uint32_t CACHE::llc_find_victim(uint32_t cpu, uint64_t instr_id, uint32_t set, const BLOCK *current_set, uint64_t ip, uint64_t full_addr, uint32_t type)
+{
+    return (this->*llc_replacement_module->find_victim)(cpu, instr_id, set, current_set, ip, full_addr, type);
+}
+
+void CACHE::llc_update_replacement_state(uint32_t cpu, uint32_t set, uint32_t way, uint64_t full_addr, uint64_t ip, uint64_t victim_addr, uint32_t type, uint8_t hit)
+{
+    (this->*llc_replacement_module->update_replacement_state)(cpu, set, way, full_addr, ip, victim_addr, type, hit);
+}
+
+void CACHE::llc_replacement_final_stats()
+{
+    (this->*llc_replacement_module->final_stats)();
+}
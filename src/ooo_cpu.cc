@@ -1,6 +1,8 @@
 #include "ooo_cpu.h"
 #include "set.h"
 
+#include <algorithm>
+
 // out-of-order core
 O3_CPU ooo_cpu[NUM_CPUS];
 uint64_t current_core_cycle[NUM_CPUS], stall_cycle[NUM_CPUS];
@@ -11,391 +13,474 @@ void O3_CPU::initialize_core()
 
 }
 
-void O3_CPU::read_from_trace()
+void O3_CPU::decode_cloudsuite_instr(const cloudsuite_instr *trace_instr, ooo_model_instr *arch_instr)
 {
-    // actual processors do not work like this but for easier implementation,
-    // we read instruction traces and virtually add them in the ROB
-    // note that these traces are not yet translated and fetched 
+    // copy the instruction into the performance model's instruction format
+    int num_reg_ops = 0, num_mem_ops = 0;
 
-    uint8_t continue_reading = 1;
-    uint32_t num_reads = 0;
-    instrs_to_read_this_cycle = FETCH_WIDTH;
+    arch_instr->ip = trace_instr->ip;
+    arch_instr->is_branch = trace_instr->is_branch;
+    arch_instr->branch_taken = trace_instr->branch_taken;
 
-    // first, read PIN trace
-    while (continue_reading) {
+    arch_instr->asid[0] = trace_instr->asid[0];
+    arch_instr->asid[1] = trace_instr->asid[1];
 
-        size_t instr_size = knob_cloudsuite ? sizeof(cloudsuite_instr) : sizeof(input_instr);
+    for (uint32_t i=0; i<MAX_INSTR_DESTINATIONS; i++) {
+        arch_instr->destination_registers[i] = trace_instr->destination_registers[i];
+        arch_instr->destination_memory[i] = trace_instr->destination_memory[i];
+        arch_instr->destination_virtual_address[i] = trace_instr->destination_memory[i];
 
-        if (knob_cloudsuite) {
-            if (!fread(&current_cloudsuite_instr, instr_size, 1, trace_file)) {
-                // reached end of file for this trace
-                cout << "*** Reached end of trace for Core: " << cpu << " Repeating trace: " << trace_string << endl;
+        if (arch_instr->destination_registers[i])
+            num_reg_ops++;
+        if (arch_instr->destination_memory[i])
+            num_mem_ops++;
+    }
 
-                // close the trace file and re-open it
-                pclose(trace_file);
-                trace_file = popen(gunzip_command, "r");
-                if (trace_file == NULL) {
-                    cerr << endl << "*** CANNOT REOPEN TRACE FILE: " << trace_string << " ***" << endl;
-                    assert(0);
-                }
-            }
-            else { // successfully read the trace
+    for (int i=0; i<NUM_INSTR_SOURCES; i++) {
+        arch_instr->source_registers[i] = trace_instr->source_registers[i];
+        arch_instr->source_memory[i] = trace_instr->source_memory[i];
+        arch_instr->source_virtual_address[i] = trace_instr->source_memory[i];
 
-             // copy the instruction into the performance model's instruction format
-                ooo_model_instr arch_instr;
-                int num_reg_ops = 0, num_mem_ops = 0;
+        if (arch_instr->source_registers[i])
+            num_reg_ops++;
+        if (arch_instr->source_memory[i])
+            num_mem_ops++;
+    }
 
-                arch_instr.instr_id = instr_unique_id;
-                arch_instr.ip = current_cloudsuite_instr.ip;
-                arch_instr.is_branch = current_cloudsuite_instr.is_branch;
-                arch_instr.branch_taken = current_cloudsuite_instr.branch_taken;
+    arch_instr->num_reg_ops = num_reg_ops;
+    arch_instr->num_mem_ops = num_mem_ops;
+    if (num_mem_ops > 0)
+        arch_instr->is_memory = 1;
+}
 
-                arch_instr.asid[0] = current_cloudsuite_instr.asid[0];
-                arch_instr.asid[1] = current_cloudsuite_instr.asid[1];
+void O3_CPU::decode_input_instr(const input_instr *trace_instr, uint64_t next_ip, ooo_model_instr *arch_instr)
+{
+    // copy the instruction into the performance model's instruction format
+    int num_reg_ops = 0, num_mem_ops = 0;
 
-                for (uint32_t i=0; i<MAX_INSTR_DESTINATIONS; i++) {
-                    arch_instr.destination_registers[i] = current_cloudsuite_instr.destination_registers[i];
-                    arch_instr.destination_memory[i] = current_cloudsuite_instr.destination_memory[i];
-                    arch_instr.destination_virtual_address[i] = current_cloudsuite_instr.destination_memory[i];
-
-                    if (arch_instr.destination_registers[i])
-                        num_reg_ops++;
-                    if (arch_instr.destination_memory[i]) {
-                        num_mem_ops++;
-
-                        // update STA, this structure is required to execute store instructions properly without deadlock
-                        if (num_mem_ops > 0) {
-                            #ifdef SANITY_CHECK
-                            if (STA[STA_tail] < UINT64_MAX) {
-                                if (STA_head != STA_tail)
-                                    assert(0);
-                            }
-                            #endif
-                            STA[STA_tail] = instr_unique_id;
-                            STA_tail++;
-
-                            if (STA_tail == STA_SIZE)
-                                STA_tail = 0;
-                        }
-                    }
-                }
+    arch_instr->ip = trace_instr->ip;
+    arch_instr->is_branch = trace_instr->is_branch;
+    arch_instr->branch_taken = trace_instr->branch_taken;
 
-                for (int i=0; i<NUM_INSTR_SOURCES; i++) {
-                    arch_instr.source_registers[i] = current_cloudsuite_instr.source_registers[i];
-                    arch_instr.source_memory[i] = current_cloudsuite_instr.source_memory[i];
-                    arch_instr.source_virtual_address[i] = current_cloudsuite_instr.source_memory[i];
+    arch_instr->asid[0] = cpu;
+    arch_instr->asid[1] = cpu;
 
-                    if (arch_instr.source_registers[i])
-                        num_reg_ops++;
-                    if (arch_instr.source_memory[i])
-                        num_mem_ops++;
-                }
+    bool reads_sp = false;
+    bool writes_sp = false;
+    bool reads_flags = false;
+    bool reads_ip = false;
+    bool writes_ip = false;
+    bool reads_other = false;
 
-                arch_instr.num_reg_ops = num_reg_ops;
-                arch_instr.num_mem_ops = num_mem_ops;
-                if (num_mem_ops > 0)
-                    arch_instr.is_memory = 1;
+    for (uint32_t i=0; i<MAX_INSTR_DESTINATIONS; i++) {
+        arch_instr->destination_registers[i] = trace_instr->destination_registers[i];
+        arch_instr->destination_memory[i] = trace_instr->destination_memory[i];
+        arch_instr->destination_virtual_address[i] = trace_instr->destination_memory[i];
 
-                // add this instruction to the IFETCH_BUFFER
-                if (IFETCH_BUFFER.occupancy < IFETCH_BUFFER.SIZE) {
-                    uint32_t ifetch_buffer_index = add_to_ifetch_buffer(&arch_instr);
-                    num_reads++;
+        switch (arch_instr->destination_registers[i])
+        {
+        case 0:
+            break;
+        case REG_STACK_POINTER:
+            writes_sp = true;
+            break;
+        case REG_INSTRUCTION_POINTER:
+            writes_ip = true;
+            break;
+        default:
+            break;
+        }
 
-                    // handle branch prediction
-                    if (IFETCH_BUFFER.entry[ifetch_buffer_index].is_branch) {
-                        DP(if (warmup_complete[cpu]) {
-                            cout << "[BRANCH] instr_id: " << instr_unique_id << " ip: " << hex << arch_instr.ip << dec << " taken: " << +arch_instr.branch_taken << endl;
-                        });
+        /*
+        if((arch_instr->is_branch) && (arch_instr->destination_registers[i] > 24) && (arch_instr->destination_registers[i] < 28))
+          {
+        arch_instr->destination_registers[i] = 0;
+          }
+        */
 
-                        num_branch++;
-
-                        // handle branch prediction & branch predictor update
-                        uint8_t branch_prediction = predict_branch(IFETCH_BUFFER.entry[ifetch_buffer_index].ip);
-
-                        if (IFETCH_BUFFER.entry[ifetch_buffer_index].branch_taken != branch_prediction)
-                        {
-                            branch_mispredictions++;
-                            total_rob_occupancy_at_branch_mispredict += ROB.occupancy;
-                            if (warmup_complete[cpu])
-                            {
-                                fetch_stall = 1;
-                                instrs_to_read_this_cycle = 0;
-                                IFETCH_BUFFER.entry[ifetch_buffer_index].branch_mispredicted = 1;
-                            }
-                        }
-                        else
-                        {
-                            // correct prediction
-                            if (branch_prediction == 1)
-                            {
-                                // if correctly predicted taken, then we can't fetch anymore instructions this cycle
-                                instrs_to_read_this_cycle = 0;
-                            }
-                        }
+        if (arch_instr->destination_registers[i])
+            num_reg_ops++;
+        if (arch_instr->destination_memory[i])
+            num_mem_ops++;
+    }
 
-                        last_branch_result(IFETCH_BUFFER.entry[ifetch_buffer_index].ip, IFETCH_BUFFER.entry[ifetch_buffer_index].branch_taken);
-                    }
+    for (int i=0; i<NUM_INSTR_SOURCES; i++) {
+        arch_instr->source_registers[i] = trace_instr->source_registers[i];
+        arch_instr->source_memory[i] = trace_instr->source_memory[i];
+        arch_instr->source_virtual_address[i] = trace_instr->source_memory[i];
 
-                    if ((num_reads >= instrs_to_read_this_cycle) || (IFETCH_BUFFER.occupancy == IFETCH_BUFFER.SIZE))
-                        continue_reading = 0;
-                }
-                instr_unique_id++;
+        switch (arch_instr->source_registers[i])
+        {
+        case 0:
+            break;
+        case REG_STACK_POINTER:
+            reads_sp = true;
+            break;
+        case REG_FLAGS:
+            reads_flags = true;
+            break;
+        case REG_INSTRUCTION_POINTER:
+            reads_ip = true;
+            break;
+        default:
+            reads_other = true;
+            break;
+        }
+
+        /*
+        if((!arch_instr->is_branch) && (arch_instr->source_registers[i] > 25) && (arch_instr->source_registers[i] < 28))
+          {
+        arch_instr->source_registers[i] = 0;
+          }
+        */
+
+        if (arch_instr->source_registers[i])
+            num_reg_ops++;
+        if (arch_instr->source_memory[i])
+            num_mem_ops++;
+    }
+
+    arch_instr->num_reg_ops = num_reg_ops;
+    arch_instr->num_mem_ops = num_mem_ops;
+    if (num_mem_ops > 0)
+        arch_instr->is_memory = 1;
+
+    // determine what kind of branch this is, if any
+    if (!reads_sp && !reads_flags && writes_ip && !reads_other)
+    {
+        // direct jump
+        arch_instr->is_branch = 1;
+        arch_instr->branch_taken = 1;
+        arch_instr->branch_type = BRANCH_DIRECT_JUMP;
+    }
+    else if (!reads_sp && !reads_flags && writes_ip && reads_other)
+    {
+        // indirect branch
+        arch_instr->is_branch = 1;
+        arch_instr->branch_taken = 1;
+        arch_instr->branch_type = BRANCH_INDIRECT;
+    }
+    else if (!reads_sp && reads_ip && !writes_sp && writes_ip && reads_flags && !reads_other)
+    {
+        // conditional branch
+        arch_instr->is_branch = 1;
+        arch_instr->branch_taken = arch_instr->branch_taken; // don't change this
+        arch_instr->branch_type = BRANCH_CONDITIONAL;
+    }
+    else if (reads_sp && reads_ip && writes_sp && writes_ip && !reads_flags && !reads_other)
+    {
+        // direct call
+        arch_instr->is_branch = 1;
+        arch_instr->branch_taken = 1;
+        arch_instr->branch_type = BRANCH_DIRECT_CALL;
+    }
+    else if (reads_sp && reads_ip && writes_sp && writes_ip && !reads_flags && reads_other)
+    {
+        // indirect call
+        arch_instr->is_branch = 1;
+        arch_instr->branch_taken = 1;
+        arch_instr->branch_type = BRANCH_INDIRECT_CALL;
+    }
+    else if (reads_sp && !reads_ip && writes_sp && writes_ip)
+    {
+        // return
+        arch_instr->is_branch = 1;
+        arch_instr->branch_taken = 1;
+        arch_instr->branch_type = BRANCH_RETURN;
+    }
+    else if (writes_ip)
+    {
+        // some other branch type that doesn't fit the above categories
+        arch_instr->is_branch = 1;
+        arch_instr->branch_taken = arch_instr->branch_taken; // don't change this
+        arch_instr->branch_type = BRANCH_OTHER;
+    }
+
+    if ((arch_instr->is_branch == 1) && (arch_instr->branch_taken == 1))
+    {
+        arch_instr->branch_target = next_ip;
+    }
+}
+
+int O3_CPU::next_trace_instr(ooo_model_instr *arch_instr)
+{
+    // later passes over the trace come straight out of the decoded instruction cache
+    if (decoded_trace.replaying)
+        return decoded_trace.replay(arch_instr);
+
+    if (knob_cloudsuite) {
+        // records are used in place, either in the decode ring or in the mapped trace
+        const cloudsuite_instr *trace_instr = (const cloudsuite_instr *)trace_reader.next_record();
+        if (trace_instr == NULL) {
+            if (decoded_trace.end_pass(NULL, 0))
+                trace_reader.close(); // everything is cached, the trace is not read again
+            return 0;
+        }
+
+        decode_cloudsuite_instr(trace_instr, arch_instr);
+        decoded_trace.record(arch_instr);
+    }
+    else {
+        const input_instr *trace_read_instr = (const input_instr *)trace_reader.next_record();
+        if (trace_read_instr == NULL) {
+            // the branch target of the last instruction is the first instruction of the next pass,
+            // so it is only decoded when the pass repeats
+            if (decoded_trace.begin && (decoded_trace.num_instr > 0)) {
+                ooo_model_instr wrap_instr;
+                decode_input_instr(&next_instr, decoded_trace.begin[0].ip, &wrap_instr);
+                if (decoded_trace.end_pass(&wrap_instr, 1))
+                    trace_reader.close();
             }
+            return 0;
+        }
+
+        if (instr_unique_id == 0)
+        {
+            current_instr = next_instr = *trace_read_instr;
         }
         else
         {
-            input_instr trace_read_instr;
-            if (!fread(&trace_read_instr, instr_size, 1, trace_file))
-            {
-                // reached end of file for this trace
-                cout << "*** Reached end of trace for Core: " << cpu << " Repeating trace: " << trace_string << endl;
+            current_instr = next_instr;
+            next_instr = *trace_read_instr;
+        }
 
-                // close the trace file and re-open it
-                pclose(trace_file);
-                trace_file = popen(gunzip_command, "r");
-                if (trace_file == NULL) {
-                    cerr << endl << "*** CANNOT REOPEN TRACE FILE: " << trace_string << " ***" << endl;
-                    assert(0);
-                }
-            }
-            else
-            { // successfully read the trace
+        decode_input_instr(&current_instr, next_instr.ip, arch_instr);
+
+        // the very first instruction is decoded twice, once without its successor
+        if (instr_unique_id > 0)
+            decoded_trace.record(arch_instr);
+    }
+
+    return 1;
+}
+
+void O3_CPU::read_from_trace()
+{
+    // actual processors do not work like this but for easier implementation,
+    // we read instruction traces and virtually add them in the ROB
+    // note that these traces are not yet translated and fetched 
+
+    uint8_t continue_reading = 1;
+    uint32_t num_reads = 0;
+    instrs_to_read_this_cycle = FETCH_WIDTH;
+
+    // first, read PIN trace
+    while (continue_reading) {
+
+        ooo_model_instr arch_instr;
+        if (!next_trace_instr(&arch_instr)) {
+            // reached end of file for this trace, the reader has already rewound it
+            cout << "*** Reached end of trace for Core: " << cpu << " Repeating trace: " << trace_string << endl;
+            continue;
+        }
+
+        // successfully read the trace
+        arch_instr.instr_id = instr_unique_id;
+
+        add_to_sta(&arch_instr);
 
-                if (instr_unique_id == 0)
+        if (!knob_cloudsuite)
+            total_branch_types[arch_instr.branch_type]++;
+
+        // add this instruction to the IFETCH_BUFFER
+        if (IFETCH_BUFFER.occupancy < IFETCH_BUFFER.SIZE) {
+            uint32_t ifetch_buffer_index = add_to_ifetch_buffer(&arch_instr);
+            num_reads++;
+
+            // handle branch prediction
+            if (IFETCH_BUFFER.entry[ifetch_buffer_index].is_branch) {
+                uint8_t branch_prediction = handle_branch(&IFETCH_BUFFER.entry[ifetch_buffer_index]);
+
+                if (IFETCH_BUFFER.entry[ifetch_buffer_index].branch_taken != branch_prediction)
                 {
-                    current_instr = next_instr = trace_read_instr;
+                    if (warmup_complete[cpu])
+                    {
+                        fetch_stall = 1;
+                        instrs_to_read_this_cycle = 0;
+                        IFETCH_BUFFER.entry[ifetch_buffer_index].branch_mispredicted = 1;
+                    }
                 }
                 else
                 {
-                    current_instr = next_instr;
-                    next_instr = trace_read_instr;
+                    // correct prediction
+                    if (branch_prediction == 1)
+                    {
+                        // if correctly predicted taken, then we can't fetch anymore instructions this cycle
+                        instrs_to_read_this_cycle = 0;
+                    }
                 }
+            }
 
-                // copy the instruction into the performance model's instruction format
-                ooo_model_instr arch_instr;
-                int num_reg_ops = 0, num_mem_ops = 0;
-
-                arch_instr.instr_id = instr_unique_id;
-                arch_instr.ip = current_instr.ip;
-                arch_instr.is_branch = current_instr.is_branch;
-                arch_instr.branch_taken = current_instr.branch_taken;
+            if ((num_reads >= instrs_to_read_this_cycle) || (IFETCH_BUFFER.occupancy == IFETCH_BUFFER.SIZE))
+                continue_reading = 0;
+        }
+        instr_unique_id++;
+    }
 
-                arch_instr.asid[0] = cpu;
-                arch_instr.asid[1] = cpu;
+    //instrs_to_fetch_this_cycle = num_reads;
+}
 
-                bool reads_sp = false;
-                bool writes_sp = false;
-                bool reads_flags = false;
-                bool reads_ip = false;
-                bool writes_ip = false;
-                bool reads_other = false;
+// update STA, this structure is required to execute store instructions properly without deadlock
+void O3_CPU::add_to_sta(ooo_model_instr *arch_instr)
+{
+    for (uint32_t i=0; i<MAX_INSTR_DESTINATIONS; i++) {
+        if (arch_instr->destination_memory[i]) {
+            #ifdef SANITY_CHECK
+            if (STA[STA_tail] < UINT64_MAX) {
+                if (STA_head != STA_tail)
+                    assert(0);
+            }
+            #endif
+            STA[STA_tail] = arch_instr->instr_id;
+            STA_tail++;
 
-                for (uint32_t i=0; i<MAX_INSTR_DESTINATIONS; i++) {
-                    arch_instr.destination_registers[i] = current_instr.destination_registers[i];
-                    arch_instr.destination_memory[i] = current_instr.destination_memory[i];
-                    arch_instr.destination_virtual_address[i] = current_instr.destination_memory[i];
+            if (STA_tail == STA_SIZE)
+                STA_tail = 0;
+        }
+    }
+}
 
-                    switch (arch_instr.destination_registers[i])
-                    {
-                    case 0:
-                        break;
-                    case REG_STACK_POINTER:
-                        writes_sp = true;
-                        break;
-                    case REG_INSTRUCTION_POINTER:
-                        writes_ip = true;
-                        break;
-                    default:
-                        break;
-                    }
+// predicts a branch, trains the predictor with its outcome and returns the prediction
+uint8_t O3_CPU::handle_branch(ooo_model_instr *arch_instr)
+{
+    DP(if (warmup_complete[cpu]) {
+        cout << "[BRANCH] instr_id: " << arch_instr->instr_id << " ip: " << hex << arch_instr->ip << dec << " taken: " << +arch_instr->branch_taken << endl;
+    });
 
-                    /*
-                    if((arch_instr.is_branch) && (arch_instr.destination_registers[i] > 24) && (arch_instr.destination_registers[i] < 28))
-                      {
-                    arch_instr.destination_registers[i] = 0;
-                      }
-                    */
-
-                    if (arch_instr.destination_registers[i])
-                        num_reg_ops++;
-                    if (arch_instr.destination_memory[i]) {
-                        num_mem_ops++;
-
-                        // update STA, this structure is required to execute store instructions properly without deadlock
-                        if (num_mem_ops > 0) {
-                            #ifdef SANITY_CHECK
-                            if (STA[STA_tail] < UINT64_MAX) {
-                                if (STA_head != STA_tail)
-                                    assert(0);
-                            }
-                            #endif
-                            STA[STA_tail] = instr_unique_id;
-                            STA_tail++;
-
-                            if (STA_tail == STA_SIZE)
-                                STA_tail = 0;
-                        }
-                    }
-                }
+    num_branch++;
 
-                for (int i=0; i<NUM_INSTR_SOURCES; i++) {
-                    arch_instr.source_registers[i] = current_instr.source_registers[i];
-                    arch_instr.source_memory[i] = current_instr.source_memory[i];
-                    arch_instr.source_virtual_address[i] = current_instr.source_memory[i];
+    // handle branch prediction & branch predictor update
+    uint8_t branch_prediction = predict_branch(arch_instr->ip);
 
-                    switch (arch_instr.source_registers[i])
-                    {
-                    case 0:
-                        break;
-                    case REG_STACK_POINTER:
-                        reads_sp = true;
-                        break;
-                    case REG_FLAGS:
-                        reads_flags = true;
-                        break;
-                    case REG_INSTRUCTION_POINTER:
-                        reads_ip = true;
-                        break;
-                    default:
-                        reads_other = true;
-                        break;
-                    }
+    if (!knob_cloudsuite) {
+        uint64_t predicted_branch_target = arch_instr->branch_target;
+        if (branch_prediction == 0)
+        {
+            predicted_branch_target = 0;
+        }
+        // call code prefetcher every time the branch predictor is used
+        l1i_prefetcher_branch_operate(arch_instr->ip, arch_instr->branch_type, predicted_branch_target);
+    }
 
-                    /*
-                    if((!arch_instr.is_branch) && (arch_instr.source_registers[i] > 25) && (arch_instr.source_registers[i] < 28))
-                      {
-                    arch_instr.source_registers[i] = 0;
-                      }
-                    */
-
-                    if (arch_instr.source_registers[i])
-                        num_reg_ops++;
-                    if (arch_instr.source_memory[i])
-                        num_mem_ops++;
-                }
+    if (arch_instr->branch_taken != branch_prediction)
+    {
+        branch_mispredictions++;
+        // with the FTQ the branch is predicted ahead of fetch, read_from_ftq() counts the occupancy once fetch reaches it
+        if (ftq.SIZE == 0)
+            total_rob_occupancy_at_branch_mispredict += ROB.occupancy;
+    }
 
-                arch_instr.num_reg_ops = num_reg_ops;
-                arch_instr.num_mem_ops = num_mem_ops;
-                if (num_mem_ops > 0)
-                    arch_instr.is_memory = 1;
+    last_branch_result(arch_instr->ip, arch_instr->branch_taken);
 
-                // determine what kind of branch this is, if any
-                if (!reads_sp && !reads_flags && writes_ip && !reads_other)
-                {
-                    // direct jump
-                    arch_instr.is_branch = 1;
-                    arch_instr.branch_taken = 1;
-                    arch_instr.branch_type = BRANCH_DIRECT_JUMP;
-                }
-                else if (!reads_sp && !reads_flags && writes_ip && reads_other)
-                {
-                    // indirect branch
-                    arch_instr.is_branch = 1;
-                    arch_instr.branch_taken = 1;
-                    arch_instr.branch_type = BRANCH_INDIRECT;
-                }
-                else if (!reads_sp && reads_ip && !writes_sp && writes_ip && reads_flags && !reads_other)
-                {
-                    // conditional branch
-                    arch_instr.is_branch = 1;
-                    arch_instr.branch_taken = arch_instr.branch_taken; // don't change this
-                    arch_instr.branch_type = BRANCH_CONDITIONAL;
-                }
-                else if (reads_sp && reads_ip && writes_sp && writes_ip && !reads_flags && !reads_other)
-                {
-                    // direct call
-                    arch_instr.is_branch = 1;
-                    arch_instr.branch_taken = 1;
-                    arch_instr.branch_type = BRANCH_DIRECT_CALL;
-                }
-                else if (reads_sp && reads_ip && writes_sp && writes_ip && !reads_flags && reads_other)
-                {
-                    // indirect call
-                    arch_instr.is_branch = 1;
-                    arch_instr.branch_taken = 1;
-                    arch_instr.branch_type = BRANCH_INDIRECT_CALL;
-                }
-                else if (reads_sp && !reads_ip && writes_sp && writes_ip)
-                {
-                    // return
-                    arch_instr.is_branch = 1;
-                    arch_instr.branch_taken = 1;
-                    arch_instr.branch_type = BRANCH_RETURN;
-                }
-                else if (writes_ip)
-                {
-                    // some other branch type that doesn't fit the above categories
-                    arch_instr.is_branch = 1;
-                    arch_instr.branch_taken = arch_instr.branch_taken; // don't change this
-                    arch_instr.branch_type = BRANCH_OTHER;
-                }
+    return branch_prediction;
+}
 
-                total_branch_types[arch_instr.branch_type]++;
+void FETCH_TARGET_QUEUE::initialize(uint32_t size, ARENA &arena)
+{
+    SIZE = size;
+    if (SIZE)
+        block = arena.allocate<FTQ_BLOCK>(SIZE);
+}
 
-                if ((arch_instr.is_branch == 1) && (arch_instr.branch_taken == 1))
-                {
-                    arch_instr.branch_target = next_instr.ip;
-                }
+// decoupled front end: predicts the next fetch block and queues it in the FTQ, one block per cycle
+void O3_CPU::run_ahead()
+{
+    // on the correct path of a trace there is nothing to run ahead on past a mispredicted branch
+    if (ftq.stalled || (ftq.occupancy == ftq.SIZE))
+        return;
 
-                // add this instruction to the IFETCH_BUFFER
-                if (IFETCH_BUFFER.occupancy < IFETCH_BUFFER.SIZE) {
-                    uint32_t ifetch_buffer_index = add_to_ifetch_buffer(&arch_instr);
-                    num_reads++;
+    FTQ_BLOCK *block = &ftq.block[ftq.tail];
+    block->num_instr = 0;
+    block->next_fetch = 0;
+    block->taken = 0;
+    block->prefetched = 0;
+
+    while (block->num_instr < FETCH_WIDTH) {
+        if (!ftq.has_pending) {
+            ooo_model_instr arch_instr;
+            if (!next_trace_instr(&arch_instr)) {
+                // reached end of file for this trace, the reader has already rewound it
+                cout << "*** Reached end of trace for Core: " << cpu << " Repeating trace: " << trace_string << endl;
+                continue;
+            }
 
-                    // handle branch prediction
-                    if (IFETCH_BUFFER.entry[ifetch_buffer_index].is_branch) {
+            arch_instr.instr_id = instr_unique_id;
+            instr_unique_id++;
 
-                        DP(if (warmup_complete[cpu]) {
-                            cout << "[BRANCH] instr_id: " << instr_unique_id << " ip: " << hex << arch_instr.ip << dec << " taken: " << +arch_instr.branch_taken << endl;
-                        });
+            ftq.pending = arch_instr;
+            ftq.has_pending = 1;
+        }
 
-                        num_branch++;
+        // a block does not cross a cache line, the instruction starts the next one
+        if (block->num_instr && ((ftq.pending.ip >> LOG2_BLOCK_SIZE) != (block->ip >> LOG2_BLOCK_SIZE)))
+            break;
 
-                        // handle branch prediction & branch predictor update
-                        uint8_t branch_prediction = predict_branch(IFETCH_BUFFER.entry[ifetch_buffer_index].ip);
-                        uint64_t predicted_branch_target = IFETCH_BUFFER.entry[ifetch_buffer_index].branch_target;
-                        if (branch_prediction == 0)
-                        {
-                            predicted_branch_target = 0;
-                        }
-                        // call code prefetcher every time the branch predictor is used
-                        l1i_prefetcher_branch_operate(IFETCH_BUFFER.entry[ifetch_buffer_index].ip,
-                            IFETCH_BUFFER.entry[ifetch_buffer_index].branch_type,
-                            predicted_branch_target);
-
-                        if (IFETCH_BUFFER.entry[ifetch_buffer_index].branch_taken != branch_prediction)
-                        {
-                            branch_mispredictions++;
-                            total_rob_occupancy_at_branch_mispredict += ROB.occupancy;
-                            if (warmup_complete[cpu])
-                            {
-                                fetch_stall = 1;
-                                instrs_to_read_this_cycle = 0;
-                                IFETCH_BUFFER.entry[ifetch_buffer_index].branch_mispredicted = 1;
-                            }
-                        }
-                        else
-                        {
-                            // correct prediction
-                            if (branch_prediction == 1)
-                            {
-                                // if correctly predicted taken, then we can't fetch anymore instructions this cycle
-                                instrs_to_read_this_cycle = 0;
-                            }
-                        }
+        ooo_model_instr *arch_instr = &block->instr[block->num_instr];
+        *arch_instr = ftq.pending;
+        ftq.has_pending = 0;
+        if (block->num_instr == 0)
+            block->ip = arch_instr->ip;
+        block->num_instr++;
 
-                        last_branch_result(IFETCH_BUFFER.entry[ifetch_buffer_index].ip, IFETCH_BUFFER.entry[ifetch_buffer_index].branch_taken);
-                    }
+        if (arch_instr->is_branch) {
+            uint8_t branch_prediction = handle_branch(arch_instr);
 
-                    if ((num_reads >= instrs_to_read_this_cycle) || (IFETCH_BUFFER.occupancy == IFETCH_BUFFER.SIZE))
-                        continue_reading = 0;
+            if (arch_instr->branch_taken != branch_prediction) {
+                if (warmup_complete[cpu]) {
+                    arch_instr->branch_mispredicted = 1;
+                    ftq.stalled = 1;
+                    break;
                 }
-                instr_unique_id++;
+            }
+            else if (branch_prediction == 1) {
+                block->taken = 1;
+                break;
             }
         }
     }
 
-    //instrs_to_fetch_this_cycle = num_reads;
+    ftq.tail++;
+    if (ftq.tail == ftq.SIZE)
+        ftq.tail = 0;
+    ftq.occupancy++;
+}
+
+// decoupled front end: moves up to FETCH_WIDTH predicted instructions from the FTQ into the IFETCH_BUFFER
+void O3_CPU::read_from_ftq()
+{
+    uint32_t num_reads = 0;
+    instrs_to_read_this_cycle = FETCH_WIDTH;
+
+    while (ftq.occupancy && (num_reads < instrs_to_read_this_cycle) && (IFETCH_BUFFER.occupancy < IFETCH_BUFFER.SIZE)) {
+        FTQ_BLOCK *block = &ftq.block[ftq.head];
+        ooo_model_instr *arch_instr = &block->instr[block->next_fetch];
+        block->next_fetch++;
+
+        add_to_sta(arch_instr);
+
+        if (!knob_cloudsuite)
+            total_branch_types[arch_instr->branch_type]++;
+
+        add_to_ifetch_buffer(arch_instr);
+        num_reads++;
+
+        // the branch was predicted when its block was queued, a misprediction now stops fetch until it resolves
+        if (arch_instr->branch_mispredicted) {
+            total_rob_occupancy_at_branch_mispredict += ROB.occupancy;
+            fetch_stall = 1;
+            instrs_to_read_this_cycle = 0;
+        }
+
+        if (block->next_fetch == block->num_instr) {
+            if (block->taken)
+                instrs_to_read_this_cycle = 0;
+
+            ftq.head++;
+            if (ftq.head == ftq.SIZE)
+                ftq.head = 0;
+            ftq.occupancy--;
+        }
+    }
 }
 
 uint32_t O3_CPU::add_to_rob(ooo_model_instr *arch_instr)
@@ -412,6 +497,18 @@ uint32_t O3_CPU::add_to_rob(ooo_model_instr *arch_instr)
     ROB.entry[index] = *arch_instr;
     ROB.entry[index].event_cycle = current_core_cycle[cpu];
 
+    if (ROB.entry[index].is_memory)
+        rob_memory.set(index);
+
+    // chain the stores to each address, youngest first, for the RAW check of add_load_queue()
+    for (uint32_t i=0; i<MAX_INSTR_DESTINATIONS; i++) {
+        if (ROB.entry[index].destination_memory[i]) {
+            uint64_t *youngest = youngest_store.find(ROB.entry[index].destination_memory[i]);
+            older_store[index][i] = youngest ? *youngest : UINT64_MAX;
+            youngest_store.insert(ROB.entry[index].destination_memory[i], ROB_REF(index, ROB.entry[index].instr_id));
+        }
+    }
+
     ROB.occupancy++;
     ROB.tail++;
     if (ROB.tail >= ROB.SIZE)
@@ -477,6 +574,9 @@ uint32_t O3_CPU::add_to_ifetch_buffer(ooo_model_instr *arch_instr)
     IFETCH_BUFFER.entry[index].fetched = 0;
     // end magic
 
+    ifetch_line.add(IFETCH_BUFFER.entry[index].ip, index);
+    ifetch_page.add(IFETCH_BUFFER.entry[index].ip, index);
+
     IFETCH_BUFFER.occupancy++;
     IFETCH_BUFFER.tail++;
 
@@ -488,6 +588,45 @@ uint32_t O3_CPU::add_to_ifetch_buffer(ooo_model_instr *arch_instr)
     return index;
 }
 
+// oldest entry of the group that covers ip, IFETCH_BUFFER_SIZE if there is none
+uint32_t IFETCH_GROUPS::first(uint64_t ip)
+{
+    uint64_t *ends = group.find(ip >> shift);
+
+    return ends ? (uint32_t)(*ends >> 32) : IFETCH_BUFFER_SIZE;
+}
+
+void IFETCH_GROUPS::add(uint64_t ip, uint32_t index)
+{
+    uint64_t *ends = group.find(ip >> shift);
+
+    next[index] = IFETCH_BUFFER_SIZE;
+    if (ends) {
+        next[(uint32_t)*ends] = index;
+        *ends = (*ends & ~(uint64_t)UINT32_MAX) | index;
+    }
+    else
+        group.insert(ip >> shift, ((uint64_t)index << 32) | index);
+}
+
+// entries leave the IFETCH_BUFFER from its head, which is always the oldest of its group
+void IFETCH_GROUPS::remove_oldest(uint64_t ip, uint32_t index)
+{
+    uint64_t *ends = group.find(ip >> shift);
+
+    #ifdef SANITY_CHECK
+    if ((ends == NULL) || ((uint32_t)(*ends >> 32) != index)) {
+        cerr << "[IFETCH_GROUPS] " << __func__ << " index: " << index << " is not the oldest of its group" << endl;
+        assert(0);
+    }
+    #endif
+
+    if ((uint32_t)*ends == index)
+        group.erase(ip >> shift);
+    else
+        *ends = ((uint64_t)next[index] << 32) | (uint32_t)*ends;
+}
+
 uint32_t O3_CPU::add_to_decode_buffer(ooo_model_instr *arch_instr)
 {
     uint32_t index = DECODE_BUFFER.tail;
@@ -512,46 +651,29 @@ uint32_t O3_CPU::add_to_decode_buffer(ooo_model_instr *arch_instr)
     return index;
 }
 
-uint32_t O3_CPU::check_rob(uint64_t instr_id)
+// the youngest store older than rob_index that writes address, ROB.SIZE if there is none
+uint32_t O3_CPU::older_store_index(uint32_t rob_index, uint64_t address)
 {
-    if ((ROB.head == ROB.tail) && ROB.occupancy == 0)
-        return ROB.SIZE;
-
-    if (ROB.head < ROB.tail) {
-        for (uint32_t i=ROB.head; i<ROB.tail; i++) {
-            if (ROB.entry[i].instr_id == instr_id) {
-                DP(if (warmup_complete[ROB.cpu]) {
-                    cout << "[ROB] " << __func__ << " same instr_id: " << ROB.entry[i].instr_id;
-                    cout << " rob_index: " << i << endl;
-                });
-                return i;
-            }
-        }
-    }
-    else {
-        for (uint32_t i=ROB.head; i<ROB.SIZE; i++) {
-            if (ROB.entry[i].instr_id == instr_id) {
-                DP(if (warmup_complete[cpu]) {
-                    cout << "[ROB] " << __func__ << " same instr_id: " << ROB.entry[i].instr_id;
-                    cout << " rob_index: " << i << endl;
-                });
-                return i;
-            }
-        }
-        for (uint32_t i=0; i<ROB.tail; i++) {
-            if (ROB.entry[i].instr_id == instr_id) {
-                DP(if (warmup_complete[cpu]) {
-                    cout << "[ROB] " << __func__ << " same instr_id: " << ROB.entry[i].instr_id;
-                    cout << " rob_index: " << i << endl;
-                });
-                return i;
-            }
-        }
-    }
+    uint64_t *youngest = youngest_store.find(address);
+    uint64_t store = youngest ? *youngest : UINT64_MAX;
+    uint32_t age = rob_age(rob_index);
 
-    cerr << "[ROB_ERROR] " << __func__ << " does not have any matching index! ";
-    cerr << " instr_id: " << instr_id << endl;
-    assert(0);
+    while (store != UINT64_MAX) {
+        uint32_t prior = store & 0xFFFF;
+
+        // the store has retired, and so have all older ones
+        if ((ROB.entry[prior].instr_id != (store >> 16)) || (ROB.entry[prior].ip == 0))
+            break;
+
+        if (rob_age(prior) < age)
+            return prior;
+
+        // younger than rob_index, follow the chain of this address
+        uint32_t i = 0;
+        while (ROB.entry[prior].destination_memory[i] != address)
+            i++;
+        store = older_store[prior][i];
+    }
 
     return ROB.SIZE;
 }
@@ -566,6 +688,9 @@ void O3_CPU::fetch_instruction()
     {
         fetch_stall = 0;
         fetch_resume_cycle = 0;
+
+        // the mispredicted branch has resolved, the branch predictor can run ahead again
+        ftq.stalled = 0;
     }
 
     if (IFETCH_BUFFER.occupancy == 0)
@@ -613,9 +738,9 @@ void O3_CPU::fetch_instruction()
             if (rq_index != -2)
             {
                 // successfully sent to the ITLB, so mark all instructions in the IFETCH_BUFFER that match this ip as translated INFLIGHT
-                for (uint32_t j=0; j<IFETCH_BUFFER.SIZE; j++)
+                for (uint32_t j=ifetch_page.first(IFETCH_BUFFER.entry[index].ip); j<IFETCH_BUFFER_SIZE; j=ifetch_page.next[j])
                 {
-                    if ((((IFETCH_BUFFER.entry[j].ip)>>LOG2_PAGE_SIZE) == ((IFETCH_BUFFER.entry[index].ip)>>LOG2_PAGE_SIZE)) && (IFETCH_BUFFER.entry[j].translated == 0))
+                    if (IFETCH_BUFFER.entry[j].translated == 0)
                     {
                         IFETCH_BUFFER.entry[j].translated = INFLIGHT;
                         IFETCH_BUFFER.entry[j].fetched = 0;
@@ -648,7 +773,7 @@ void O3_CPU::fetch_instruction()
 
             /*
             // invoke code prefetcher -- THIS HAS BEEN MOVED TO cache.cc !!!
-            int hit_way = L1I.check_hit(&fetch_packet);
+            int hit_way = L1I.check_hit(&fetch_packet, L1I.get_set(fetch_packet.address));
             uint8_t prefetch_hit = 0;
             if(hit_way != -1)
               {
@@ -662,13 +787,10 @@ void O3_CPU::fetch_instruction()
             if (rq_index != -2)
             {
                 // mark all instructions from this cache line as having been fetched
-                for (uint32_t j=0; j<IFETCH_BUFFER.SIZE; j++)
+                for (uint32_t j=ifetch_line.first(IFETCH_BUFFER.entry[index].ip); j<IFETCH_BUFFER_SIZE; j=ifetch_line.next[j])
                 {
-                    if (((IFETCH_BUFFER.entry[j].ip)>>6) == ((IFETCH_BUFFER.entry[index].ip)>>6))
-                    {
-                        IFETCH_BUFFER.entry[j].translated = COMPLETED;
-                        IFETCH_BUFFER.entry[j].fetched = INFLIGHT;
-                    }
+                    IFETCH_BUFFER.entry[j].translated = COMPLETED;
+                    IFETCH_BUFFER.entry[j].fetched = INFLIGHT;
                 }
             }
         }
@@ -706,6 +828,9 @@ void O3_CPU::fetch_instruction()
                 uint32_t decode_index = add_to_decode_buffer(&IFETCH_BUFFER.entry[IFETCH_BUFFER.head]);
                 DECODE_BUFFER.entry[decode_index].event_cycle = 0;
 
+                ifetch_line.remove_oldest(IFETCH_BUFFER.entry[IFETCH_BUFFER.head].ip, IFETCH_BUFFER.head);
+                ifetch_page.remove_oldest(IFETCH_BUFFER.entry[IFETCH_BUFFER.head].ip, IFETCH_BUFFER.head);
+
                 ooo_model_instr empty_entry;
                 IFETCH_BUFFER.entry[IFETCH_BUFFER.head] = empty_entry;
 
@@ -893,6 +1018,7 @@ void O3_CPU::do_scheduling(uint32_t rob_index)
     ROB.entry[rob_index].reg_ready = 1; // reg_ready will be reset to 0 if there is RAW dependency 
 
     reg_dependency(rob_index);
+    add_reg_writer(rob_index);
     ROB.next_schedule = (rob_index == (ROB.SIZE - 1)) ? 0 : (rob_index + 1);
 
     if (ROB.entry[rob_index].is_memory)
@@ -946,34 +1072,44 @@ void O3_CPU::reg_dependency(uint32_t rob_index)
     });
 
     // check RAW dependency
-    int prior = rob_index - 1;
-    if (prior < 0)
-        prior = ROB.SIZE - 1;
-
-    if (rob_index != ROB.head) {
-        if ((int)ROB.head <= prior) {
-            for (int i=prior; i>=(int)ROB.head; i--) if (ROB.entry[i].executed != COMPLETED) {
-                for (uint32_t j=0; j<NUM_INSTR_SOURCES; j++) {
-                    if (ROB.entry[rob_index].source_registers[j] && (ROB.entry[rob_index].reg_RAW_checked[j] == 0))
-                        reg_RAW_dependency(i, rob_index, j);
-                }
-            }
-        }
-        else {
-            for (int i=prior; i>=0; i--) if (ROB.entry[i].executed != COMPLETED) {
-                for (uint32_t j=0; j<NUM_INSTR_SOURCES; j++) {
-                    if (ROB.entry[rob_index].source_registers[j] && (ROB.entry[rob_index].reg_RAW_checked[j] == 0))
-                        reg_RAW_dependency(i, rob_index, j);
-                }
-            }
-            for (int i=ROB.SIZE-1; i>=(int)ROB.head; i--) if (ROB.entry[i].executed != COMPLETED) {
-                for (uint32_t j=0; j<NUM_INSTR_SOURCES; j++) {
-                    if (ROB.entry[rob_index].source_registers[j] && (ROB.entry[rob_index].reg_RAW_checked[j] == 0))
-                        reg_RAW_dependency(i, rob_index, j);
-                }
-            }
+    // the producer of a source is its youngest older writer that has not executed, scheduling is in order
+    // so every writer in reg_writers is older, and the oldest of the producers ends up as producer_id
+    uint32_t oldest_prior = ROB.SIZE;
+    for (uint32_t j=0; j<NUM_INSTR_SOURCES; j++) {
+        uint8_t reg = ROB.entry[rob_index].source_registers[j];
+        if (reg && (ROB.entry[rob_index].reg_RAW_checked[j] == 0) && reg_writers[reg].size()) {
+            uint32_t prior = reg_writers[reg].back();
+            reg_RAW_dependency(prior, rob_index, j);
+
+            if ((oldest_prior == ROB.SIZE) || (rob_age(prior) < rob_age(oldest_prior)))
+                oldest_prior = prior;
         }
     }
+
+    if (oldest_prior != ROB.SIZE)
+        ROB.entry[rob_index].producer_id = ROB.entry[oldest_prior].instr_id;
+}
+
+void O3_CPU::add_reg_writer(uint32_t rob_index)
+{
+    for (uint32_t i=0; i<MAX_INSTR_DESTINATIONS; i++) {
+        uint8_t reg = ROB.entry[rob_index].destination_registers[i];
+        if (reg && (reg_writers[reg].empty() || (reg_writers[reg].back() != rob_index)))
+            reg_writers[reg].push_back(rob_index);
+    }
+}
+
+void O3_CPU::remove_reg_writer(uint32_t rob_index)
+{
+    for (uint32_t i=0; i<MAX_INSTR_DESTINATIONS; i++) {
+        uint8_t reg = ROB.entry[rob_index].destination_registers[i];
+        if (reg == 0)
+            continue;
+
+        vector<uint32_t>::iterator writer = find(reg_writers[reg].begin(), reg_writers[reg].end(), rob_index);
+        if (writer != reg_writers[reg].end())
+            reg_writers[reg].erase(writer);
+    }
 }
 
 void O3_CPU::reg_RAW_dependency(uint32_t prior, uint32_t current, uint32_t source_index)
@@ -1071,6 +1207,7 @@ void O3_CPU::do_execution(uint32_t rob_index)
   //cout << "do_execution() rob_index: " << rob_index << " cycle: " << current_core_cycle[cpu] << endl;
 
     ROB.entry[rob_index].executed = INFLIGHT;
+    rob_inflight.set(rob_index);
 
     // ADD LATENCY
     if (ROB.entry[rob_index].event_cycle < current_core_cycle[cpu])
@@ -1093,42 +1230,34 @@ void O3_CPU::schedule_memory_instruction()
         return;
 
     // execution is out-of-order but we have an in-order scheduling algorithm to detect all RAW dependencies
+    // only memory instructions take part, so the scan skips straight from one to the next
     uint32_t limit = ROB.next_schedule;
     num_searched = 0;
     if (ROB.head < limit) {
-        for (uint32_t i=ROB.head; i<limit; i++) {
-
-            if (ROB.entry[i].is_memory == 0)
-                continue;
+        for (uint32_t i=rob_memory.next(ROB.head, limit); i<limit; i=rob_memory.next(i+1, limit)) {
 
             if ((ROB.entry[i].fetched != COMPLETED) || (ROB.entry[i].event_cycle > current_core_cycle[cpu]) || (num_searched >= SCHEDULER_SIZE))
                 break;
 
-            if (ROB.entry[i].is_memory && ROB.entry[i].reg_ready && (ROB.entry[i].scheduled == INFLIGHT))
+            if (ROB.entry[i].reg_ready && (ROB.entry[i].scheduled == INFLIGHT))
                 do_memory_scheduling(i);
         }
     }
     else {
-        for (uint32_t i=ROB.head; i<ROB.SIZE; i++) {
-
-            if (ROB.entry[i].is_memory == 0)
-                continue;
+        for (uint32_t i=rob_memory.next(ROB.head, ROB.SIZE); i<ROB.SIZE; i=rob_memory.next(i+1, ROB.SIZE)) {
 
             if ((ROB.entry[i].fetched != COMPLETED) || (ROB.entry[i].event_cycle > current_core_cycle[cpu]) || (num_searched >= SCHEDULER_SIZE))
                 break;
 
-            if (ROB.entry[i].is_memory && ROB.entry[i].reg_ready && (ROB.entry[i].scheduled == INFLIGHT))
+            if (ROB.entry[i].reg_ready && (ROB.entry[i].scheduled == INFLIGHT))
                 do_memory_scheduling(i);
         }
-        for (uint32_t i=0; i<limit; i++) {
-
-            if (ROB.entry[i].is_memory == 0)
-                continue;
+        for (uint32_t i=rob_memory.next(0, limit); i<limit; i=rob_memory.next(i+1, limit)) {
 
             if ((ROB.entry[i].fetched != COMPLETED) || (ROB.entry[i].event_cycle > current_core_cycle[cpu]) || (num_searched >= SCHEDULER_SIZE))
                 break;
 
-            if (ROB.entry[i].is_memory && ROB.entry[i].reg_ready && (ROB.entry[i].scheduled == INFLIGHT))
+            if (ROB.entry[i].reg_ready && (ROB.entry[i].scheduled == INFLIGHT))
                 do_memory_scheduling(i);
         }
     }
@@ -1145,8 +1274,10 @@ void O3_CPU::do_memory_scheduling(uint32_t rob_index)
     uint32_t not_available = check_and_add_lsq(rob_index);
     if (not_available == 0) {
         ROB.entry[rob_index].scheduled = COMPLETED;
-        if (ROB.entry[rob_index].executed == 0) // it could be already set to COMPLETED due to store-to-load forwarding
+        if (ROB.entry[rob_index].executed == 0) { // it could be already set to COMPLETED due to store-to-load forwarding
             ROB.entry[rob_index].executed  = INFLIGHT;
+            rob_inflight.set(rob_index);
+        }
 
         DP(if (warmup_complete[cpu]) {
             cout << "[ROB] " << __func__ << " instr_id: " << ROB.entry[rob_index].instr_id << " rob_index: " << rob_index;
@@ -1245,34 +1376,9 @@ void O3_CPU::add_load_queue(uint32_t rob_index, uint32_t data_index)
     LQ.occupancy++;
 
     // check RAW dependency
-    int prior = rob_index - 1;
-    if (prior < 0)
-        prior = ROB.SIZE - 1;
-
-    if (rob_index != ROB.head) {
-        if ((int)ROB.head <= prior) {
-            for (int i=prior; i>=(int)ROB.head; i--) {
-                if (LQ.entry[lq_index].producer_id != UINT64_MAX)
-                    break;
-
-                mem_RAW_dependency(i, rob_index, data_index, lq_index);
-            }
-        }
-        else {
-            for (int i=prior; i>=0; i--) {
-                if (LQ.entry[lq_index].producer_id != UINT64_MAX)
-                    break;
-
-                mem_RAW_dependency(i, rob_index, data_index, lq_index);
-            }
-            for (int i=ROB.SIZE-1; i>=(int)ROB.head; i--) {
-                if (LQ.entry[lq_index].producer_id != UINT64_MAX)
-                    break;
-
-                mem_RAW_dependency(i, rob_index, data_index, lq_index);
-            }
-        }
-    }
+    uint32_t prior = older_store_index(rob_index, LQ.entry[lq_index].virtual_address);
+    if (prior != ROB.SIZE)
+        mem_RAW_dependency(prior, rob_index, data_index, lq_index);
 
     // check
     // 1) if store-to-load forwarding is possible
@@ -1744,6 +1850,8 @@ void O3_CPU::complete_execution(uint32_t rob_index)
         if ((ROB.entry[rob_index].executed == INFLIGHT) && (ROB.entry[rob_index].event_cycle <= current_core_cycle[cpu])) {
 
             ROB.entry[rob_index].executed = COMPLETED;
+            rob_inflight.clear(rob_index);
+            remove_reg_writer(rob_index);
             inflight_reg_executions--;
             completed_executions++;
 
@@ -1767,6 +1875,8 @@ void O3_CPU::complete_execution(uint32_t rob_index)
             if ((ROB.entry[rob_index].executed == INFLIGHT) && (ROB.entry[rob_index].event_cycle <= current_core_cycle[cpu])) {
 
                 ROB.entry[rob_index].executed = COMPLETED;
+                rob_inflight.clear(rob_index);
+                remove_reg_writer(rob_index);
                 inflight_mem_executions--;
                 completed_executions++;
 
@@ -1832,6 +1942,60 @@ void O3_CPU::reg_RAW_release(uint32_t rob_index)
     }
 }
 
+// one cycle of the pipeline and the private caches
+void O3_CPU::operate()
+{
+    // proceed one cycle
+    current_core_cycle[cpu]++;
+
+    //cout << "Trying to process instr_id: " << instr_unique_id << " fetch_stall: " << +fetch_stall;
+    //cout << " stall_cycle: " << stall_cycle[cpu] << " current: " << current_core_cycle[cpu] << endl;
+
+    // core might be stalled due to page fault or branch misprediction
+    if (stall_cycle[cpu] > current_core_cycle[cpu])
+        return;
+
+    // retire
+    if ((ROB.entry[ROB.head].executed == COMPLETED) && (ROB.entry[ROB.head].event_cycle <= current_core_cycle[cpu]))
+        retire_rob();
+
+    // complete
+    update_rob();
+
+    // schedule
+    uint32_t schedule_index = ROB.next_schedule;
+    if ((ROB.entry[schedule_index].scheduled == 0) && (ROB.entry[schedule_index].event_cycle <= current_core_cycle[cpu]))
+        schedule_instruction();
+    // execute
+    execute_instruction();
+
+    update_rob();
+
+    // memory operation
+    schedule_memory_instruction();
+    execute_memory_instruction();
+
+    update_rob();
+
+    // decode
+    if (DECODE_BUFFER.occupancy > 0)
+        decode_and_dispatch();
+
+    // fetch
+    fetch_instruction();
+
+    // read from trace, or from the fetch target queue when the branch predictor runs ahead of fetch
+    if ((IFETCH_BUFFER.occupancy < IFETCH_BUFFER.SIZE) && (fetch_stall == 0)) {
+        if (ftq.SIZE)
+            read_from_ftq();
+        else
+            read_from_trace();
+    }
+
+    if (ftq.SIZE)
+        run_ahead();
+}
+
 void O3_CPU::operate_cache()
 {
     ITLB.operate();
@@ -1859,16 +2023,16 @@ void O3_CPU::update_rob()
     if (L1D.PROCESSED.occupancy && (L1D.PROCESSED.entry[L1D.PROCESSED.head].event_cycle <= current_core_cycle[cpu]))
         complete_data_fetch(&L1D.PROCESSED, 0);
 
-    // update ROB entries with completed executions
+    // update ROB entries with completed executions, in ROB order over the ones still executing
     if ((inflight_reg_executions > 0) || (inflight_mem_executions > 0)) {
         if (ROB.head < ROB.tail) {
-            for (uint32_t i=ROB.head; i<ROB.tail; i++)
+            for (uint32_t i=rob_inflight.next(ROB.head, ROB.tail); i<ROB.tail; i=rob_inflight.next(i+1, ROB.tail))
                 complete_execution(i);
         }
         else {
-            for (uint32_t i=ROB.head; i<ROB.SIZE; i++)
+            for (uint32_t i=rob_inflight.next(ROB.head, ROB.SIZE); i<ROB.SIZE; i=rob_inflight.next(i+1, ROB.SIZE))
                 complete_execution(i);
-            for (uint32_t i=0; i<ROB.tail; i++)
+            for (uint32_t i=rob_inflight.next(0, ROB.tail); i<ROB.tail; i=rob_inflight.next(i+1, ROB.tail))
                 complete_execution(i);
         }
     }
@@ -1887,17 +2051,14 @@ void O3_CPU::complete_instr_fetch(PACKET_QUEUE *queue, uint8_t is_it_tlb)
         uint64_t instruction_physical_address = (queue->entry[index].instruction_pa << LOG2_PAGE_SIZE) | (complete_ip & ((1 << LOG2_PAGE_SIZE) - 1));
 
         // mark the appropriate instructions in the IFETCH_BUFFER as translated and ready to fetch
-        for (uint32_t j=0; j<IFETCH_BUFFER.SIZE; j++)
+        for (uint32_t j=ifetch_page.first(complete_ip); j<IFETCH_BUFFER_SIZE; j=ifetch_page.next[j])
         {
-            if (((IFETCH_BUFFER.entry[j].ip)>>LOG2_PAGE_SIZE) == ((complete_ip)>>LOG2_PAGE_SIZE))
-            {
-                IFETCH_BUFFER.entry[j].translated = COMPLETED;
-                // we did not fetch this instruction's cache line, but we did translated it
-                IFETCH_BUFFER.entry[j].fetched = 0;
-                // recalculate a physical address for this cache line based on the translated physical page address
-                uint64_t instr_pa = (queue->entry[index].instruction_pa << LOG2_PAGE_SIZE) | ((IFETCH_BUFFER.entry[j].ip) & ((1 << LOG2_PAGE_SIZE) - 1));
-                IFETCH_BUFFER.entry[j].instruction_pa = instr_pa;
-            }
+            IFETCH_BUFFER.entry[j].translated = COMPLETED;
+            // we did not fetch this instruction's cache line, but we did translated it
+            IFETCH_BUFFER.entry[j].fetched = 0;
+            // recalculate a physical address for this cache line based on the translated physical page address
+            uint64_t instr_pa = (queue->entry[index].instruction_pa << LOG2_PAGE_SIZE) | ((IFETCH_BUFFER.entry[j].ip) & ((1 << LOG2_PAGE_SIZE) - 1));
+            IFETCH_BUFFER.entry[j].instruction_pa = instr_pa;
         }
 
         // remove this entry
@@ -1906,13 +2067,10 @@ void O3_CPU::complete_instr_fetch(PACKET_QUEUE *queue, uint8_t is_it_tlb)
     else
     {
         // this is the L1I cache, so instructions are now fully fetched, so mark them as such
-        for (uint32_t j=0; j<IFETCH_BUFFER.SIZE; j++)
+        for (uint32_t j=ifetch_line.first(complete_ip); j<IFETCH_BUFFER_SIZE; j=ifetch_line.next[j])
         {
-            if (((IFETCH_BUFFER.entry[j].ip)>>6) == ((complete_ip)>>6))
-            {
-                IFETCH_BUFFER.entry[j].translated = COMPLETED;
-                IFETCH_BUFFER.entry[j].fetched = COMPLETED;
-            }
+            IFETCH_BUFFER.entry[j].translated = COMPLETED;
+            IFETCH_BUFFER.entry[j].fetched = COMPLETED;
         }
 
         // remove this entry                                                                                                                                                                        
@@ -1924,7 +2082,7 @@ void O3_CPU::complete_instr_fetch(PACKET_QUEUE *queue, uint8_t is_it_tlb)
     // old function below
 
     #ifdef SANITY_CHECK
-    if (rob_index != check_rob(queue->entry[index].instr_id))
+    if ((ROB.entry[rob_index].instr_id != queue->entry[index].instr_id) || (ROB.entry[rob_index].ip == 0))
         assert(0);
     #endif
 
@@ -1947,7 +2105,7 @@ void O3_CPU::complete_instr_fetch(PACKET_QUEUE *queue, uint8_t is_it_tlb)
 
     // check if other instructions were merged
     if (queue->entry[index].instr_merged) {
-        ITERATE_SET(i, queue->entry[index].rob_index_depend_on_me, ROB_SIZE) {
+        ITERATE_SET(i, queue->entry[index].depends().rob_index_depend_on_me, ROB_SIZE) {
             // update ROB entry
             if (is_it_tlb) {
                 ROB.entry[i].translated = COMPLETED;
@@ -1980,7 +2138,7 @@ void O3_CPU::complete_data_fetch(PACKET_QUEUE *queue, uint8_t is_it_tlb)
 
     #ifdef SANITY_CHECK
     if (queue->entry[index].type != RFO) {
-        if (rob_index != check_rob(queue->entry[index].instr_id))
+        if ((ROB.entry[rob_index].instr_id != queue->entry[index].instr_id) || (ROB.entry[rob_index].ip == 0))
             assert(0);
     }
     #endif
@@ -2083,7 +2241,7 @@ void O3_CPU::handle_o3_fetch(PACKET *current_packet, uint32_t cache_type)
     if (cache_type == 0) { // DTLB
 
         #ifdef SANITY_CHECK
-        if (rob_index != check_rob(current_packet->instr_id))
+        if ((ROB.entry[rob_index].instr_id != current_packet->instr_id) || (ROB.entry[rob_index].ip == 0))
             assert(0);
         #endif
         if (current_packet->type == RFO) {
@@ -2136,7 +2294,7 @@ void O3_CPU::handle_o3_fetch(PACKET *current_packet, uint32_t cache_type)
             handle_merged_load(current_packet);
         else { // do traditional things
             #ifdef SANITY_CHECK
-            if (rob_index != check_rob(current_packet->instr_id))
+            if ((ROB.entry[rob_index].instr_id != current_packet->instr_id) || (ROB.entry[rob_index].ip == 0))
                 assert(0);
 
             if (current_packet->store_merged)
@@ -2173,7 +2331,7 @@ void O3_CPU::handle_o3_fetch(PACKET *current_packet, uint32_t cache_type)
 void O3_CPU::handle_merged_translation(PACKET *provider)
 {
     if (provider->store_merged) {
-        ITERATE_SET(merged, provider->sq_index_depend_on_me, SQ.SIZE) {
+        ITERATE_SET(merged, provider->depends().sq_index_depend_on_me, SQ.SIZE) {
             SQ.entry[merged].translated = COMPLETED;
             SQ.entry[merged].physical_address = (provider->data_pa << LOG2_PAGE_SIZE) | (SQ.entry[merged].virtual_address & ((1 << LOG2_PAGE_SIZE) - 1)); // translated address
             SQ.entry[merged].event_cycle = current_core_cycle[cpu];
@@ -2191,7 +2349,7 @@ void O3_CPU::handle_merged_translation(PACKET *provider)
         }
     }
     if (provider->load_merged) {
-        ITERATE_SET(merged, provider->lq_index_depend_on_me, LQ.SIZE) {
+        ITERATE_SET(merged, provider->depends().lq_index_depend_on_me, LQ.SIZE) {
             LQ.entry[merged].translated = COMPLETED;
             LQ.entry[merged].physical_address = (provider->data_pa << LOG2_PAGE_SIZE) | (LQ.entry[merged].virtual_address & ((1 << LOG2_PAGE_SIZE) - 1)); // translated address
             LQ.entry[merged].event_cycle = current_core_cycle[cpu];
@@ -2217,7 +2375,7 @@ void O3_CPU::handle_merged_translation(PACKET *provider)
 
 void O3_CPU::handle_merged_load(PACKET *provider)
 {
-    ITERATE_SET(merged, provider->lq_index_depend_on_me, LQ.SIZE) {
+    ITERATE_SET(merged, provider->depends().lq_index_depend_on_me, LQ.SIZE) {
         uint32_t merged_rob_index = LQ.entry[merged].rob_index;
 
         LQ.entry[merged].fetched = COMPLETED;
@@ -2347,6 +2505,15 @@ void O3_CPU::retire_rob()
             cout << "[ROB] " << __func__ << " instr_id: " << ROB.entry[ROB.head].instr_id << " is retired" << endl;
         });
 
+        for (uint32_t i=0; i<MAX_INSTR_DESTINATIONS; i++) {
+            if (ROB.entry[ROB.head].destination_memory[i]) {
+                uint64_t *youngest = youngest_store.find(ROB.entry[ROB.head].destination_memory[i]);
+                if (youngest && (*youngest == ROB_REF(ROB.head, ROB.entry[ROB.head].instr_id)))
+                    youngest_store.erase(ROB.entry[ROB.head].destination_memory[i]);
+            }
+        }
+        rob_memory.clear(ROB.head);
+
         ooo_model_instr empty_entry;
         ROB.entry[ROB.head] = empty_entry;
 
@@ -2358,3 +2525,197 @@ void O3_CPU::retire_rob()
         num_retired++;
     }
 }
+
+// returns 1 if check_and_add_lsq() can neither add a memory operation of this instruction nor complete its scheduling
+uint8_t O3_CPU::lsq_blocked(uint32_t rob_index)
+{
+    uint32_t num_mem_ops = 0, num_added = 0;
+
+    for (uint32_t i=0; i<NUM_INSTR_SOURCES; i++) {
+        if (ROB.entry[rob_index].source_memory[i]) {
+            num_mem_ops++;
+            if (ROB.entry[rob_index].source_added[i])
+                num_added++;
+            else if (LQ.occupancy < LQ.SIZE)
+                return 0;
+        }
+    }
+
+    for (uint32_t i=0; i<MAX_INSTR_DESTINATIONS; i++) {
+        if (ROB.entry[rob_index].destination_memory[i]) {
+            num_mem_ops++;
+            if (ROB.entry[rob_index].destination_added[i])
+                num_added++;
+            else if ((SQ.occupancy < SQ.SIZE) && (STA[STA_head] == ROB.entry[rob_index].instr_id))
+                return 0;
+        }
+    }
+
+    return (num_added != num_mem_ops);
+}
+
+// earliest cycle after current at which one cycle of this core (the pipeline stages and its private caches)
+// can change anything, UINT64_MAX if nothing is pending
+// every gate below mirrors a stage called from the main loop, so that skipping up to the returned cycle is exact
+// an estimate that is too early is always safe, it merely simulates an idle cycle
+uint64_t O3_CPU::next_event_cycle(uint64_t current)
+{
+    uint64_t next = UINT64_MAX;
+
+    // the whole core is frozen while a page fault is served
+    if (stall_cycle[cpu] > current + 1)
+        return stall_cycle[cpu];
+
+    // fetch: stall recovery, translation and fetch requests, moving lines into DECODE_BUFFER and reading the trace
+    if ((IFETCH_BUFFER.occupancy < IFETCH_BUFFER.SIZE) && (fetch_stall == 0))
+        return current + 1;
+    if ((fetch_stall == 1) && (fetch_resume_cycle != 0))
+        next = next_event(next, fetch_resume_cycle, current);
+
+    // run-ahead: the branch predictor fills the FTQ, and the L1I prefetcher may still be working through it
+    if (ftq.SIZE && !ftq.stalled && (ftq.occupancy < ftq.SIZE))
+        return current + 1;
+    if (ftq.prefetcher && ftq.occupancy && (ftq.at(ftq.occupancy - 1)->prefetched == 0))
+        return current + 1;
+
+    if (IFETCH_BUFFER.occupancy) {
+        uint32_t index = IFETCH_BUFFER.head;
+        for (uint32_t i=0; i<IFETCH_BUFFER.SIZE; i++) {
+            if (IFETCH_BUFFER.entry[index].ip == 0)
+                break;
+            if ((IFETCH_BUFFER.entry[index].translated == 0) || ((IFETCH_BUFFER.entry[index].translated == COMPLETED) && (IFETCH_BUFFER.entry[index].fetched == 0)))
+                return current + 1;
+
+            index++;
+            if (index >= IFETCH_BUFFER.SIZE)
+                index = 0;
+            if (index == IFETCH_BUFFER.head)
+                break;
+        }
+
+        ooo_model_instr *head = &IFETCH_BUFFER.entry[IFETCH_BUFFER.head];
+        if (head->ip && (head->translated == COMPLETED) && (head->fetched == COMPLETED) && (DECODE_BUFFER.occupancy < DECODE_BUFFER.SIZE))
+            return current + 1;
+    }
+
+    // decode: dispatch into the ROB once the decode latency has passed, and stamp newly decoded entries
+    if (DECODE_BUFFER.occupancy) {
+        ooo_model_instr *head = &DECODE_BUFFER.entry[DECODE_BUFFER.head];
+        if (head->ip && (ROB.occupancy < ROB.SIZE)) {
+            if (!warmup_complete[cpu])
+                return current + 1;
+            if (head->event_cycle != 0)
+                next = next_event(next, head->event_cycle + 1, current);
+        }
+
+        uint32_t decode_index = DECODE_BUFFER.head;
+        for (uint32_t i=0; i<DECODE_BUFFER.SIZE; i++) {
+            if (head->ip == 0)
+                break;
+            if (DECODE_BUFFER.entry[decode_index].event_cycle == 0)
+                return current + 1;
+            if (decode_index == DECODE_BUFFER.tail)
+                break;
+            decode_index++;
+            if (decode_index >= DECODE_BUFFER.SIZE)
+                decode_index = 0;
+        }
+    }
+
+    // retire
+    if (ROB.entry[ROB.head].executed == COMPLETED)
+        next = next_event(next, ROB.entry[ROB.head].event_cycle, current);
+
+    // update_rob(): completed translations and fetches, then completed executions
+    PACKET_QUEUE *processed[4] = { &ITLB.PROCESSED, &L1I.PROCESSED, &DTLB.PROCESSED, &L1D.PROCESSED };
+    for (uint32_t i=0; i<4; i++)
+        if (processed[i]->occupancy)
+            next = next_event(next, processed[i]->entry[processed[i]->head].event_cycle, current);
+
+    if ((inflight_reg_executions > 0) || (inflight_mem_executions > 0)) {
+        for (uint32_t index=rob_inflight.next(0, ROB.SIZE); index<ROB.SIZE; index=rob_inflight.next(index+1, ROB.SIZE)) {
+            if ((ROB.entry[index].is_memory == 0) || (ROB.entry[index].num_mem_ops == 0))
+                next = next_event(next, ROB.entry[index].event_cycle, current);
+        }
+    }
+
+    if (next == current + 1)
+        return next;
+
+    // schedule_instruction(): an in-order scan from the head that stops at the first entry that is not ready yet
+    uint32_t schedule_index = ROB.next_schedule;
+    if ((ROB.entry[schedule_index].scheduled == 0) && ROB.occupancy) {
+        uint64_t ready_cycle = ROB.entry[schedule_index].event_cycle;
+        uint32_t index = ROB.head, limit = ROB.next_fetch[1], num_scanned = 0;
+        do {
+            if ((ROB.entry[index].fetched != COMPLETED) || (num_scanned >= SCHEDULER_SIZE))
+                break;
+            if (ROB.entry[index].event_cycle > ready_cycle)
+                ready_cycle = ROB.entry[index].event_cycle;
+            if (ROB.entry[index].scheduled == 0) {
+                next = next_event(next, ready_cycle, current);
+                break;
+            }
+            num_scanned++;
+
+            index++;
+            if (index == ROB.SIZE)
+                index = 0;
+        } while (index != limit);
+    }
+
+    // execute_instruction()
+    if (RTE0[RTE0_head] < ROB_SIZE)
+        next = next_event(next, ROB.entry[RTE0[RTE0_head]].event_cycle, current);
+    if (RTE1[RTE1_head] < ROB_SIZE)
+        next = next_event(next, ROB.entry[RTE1[RTE1_head]].event_cycle, current);
+
+    // schedule_memory_instruction(): instructions stuck on a full LQ/SQ (or behind an older store address) stay put
+    // a wrapped scan restarts at index 0 even if the first part stopped early, carrying over the number of
+    // instructions searched; the second part assumes the smallest such count (the one of the next cycle), which can only be early
+    if (ROB.occupancy) {
+        uint32_t limit = ROB.next_schedule, num_scanned = 0, num_carried = 0;
+        uint32_t part_begin[2] = { ROB.head, 0 },
+            part_end[2] = { (ROB.head < limit) ? limit : ROB.SIZE, (ROB.head < limit) ? 0 : limit };
+
+        for (uint32_t part=0; part<2; part++) {
+            uint64_t ready_cycle = 0;
+            num_scanned = num_carried;
+            for (uint32_t i=rob_memory.next(part_begin[part], part_end[part]); i<part_end[part]; i=rob_memory.next(i+1, part_end[part])) {
+                if ((ROB.entry[i].fetched != COMPLETED) || (num_scanned >= SCHEDULER_SIZE))
+                    break;
+                if (ROB.entry[i].event_cycle > ready_cycle)
+                    ready_cycle = ROB.entry[i].event_cycle;
+                if (ROB.entry[i].reg_ready && (ROB.entry[i].scheduled == INFLIGHT)) {
+                    if (lsq_blocked(i) == 0) {
+                        next = next_event(next, ready_cycle, current);
+                        break;
+                    }
+                    if (ready_cycle <= current + 1)
+                        num_carried++;
+                    num_scanned++;
+                }
+            }
+        }
+    }
+
+    // operate_lsq()
+    if (RTS0[RTS0_head] < SQ_SIZE)
+        next = next_event(next, SQ.entry[RTS0[RTS0_head]].event_cycle, current);
+    if (RTS1[RTS1_head] < SQ_SIZE)
+        next = next_event(next, SQ.entry[RTS1[RTS1_head]].event_cycle, current);
+    if (RTL0[RTL0_head] < LQ_SIZE)
+        next = next_event(next, LQ.entry[RTL0[RTL0_head]].event_cycle, current);
+    if (RTL1[RTL1_head] < LQ_SIZE)
+        next = next_event(next, LQ.entry[RTL1[RTL1_head]].event_cycle, current);
+
+    // operate_cache(), l1i_prefetcher_cycle_operate() is assumed to stay idle while nothing else happens
+    CACHE *cache[6] = { &ITLB, &DTLB, &STLB, &L1I, &L1D, &L2C };
+    for (uint32_t i=0; i<6; i++) {
+        uint64_t cache_event = cache[i]->next_event_cycle(current);
+        if (cache_event < next)
+            next = cache_event;
+    }
+
+    return next;
+}
@@ -0,0 +1,128 @@
+#include "page_table.h"
+
+// VA => frame, PA => frame and the unique cache lines touched by each core
+ADDRESS_TABLE page_table(1, 16), inverse_table(1, 16), unique_cl[NUM_CPUS];
+PAGE_FRAMES page_frames;
+
+void ADDRESS_TABLE::allocate(uint32_t log2_size)
+{
+    uint64_t *old_key = key, *old_value = value, old_size = key ? size() : 0;
+
+    key = new uint64_t[1ULL << log2_size];
+    value = has_value ? new uint64_t[1ULL << log2_size] : NULL;
+    for (uint64_t i=0; i<(1ULL << log2_size); i++)
+        key[i] = ADDRESS_TABLE_EMPTY;
+    mask = (1ULL << log2_size) - 1;
+    shift = 64 - log2_size;
+
+    // rehash what was there before growing
+    occupancy = 0;
+    for (uint64_t i=0; i<old_size; i++) {
+        if (old_key[i] != ADDRESS_TABLE_EMPTY)
+            insert(old_key[i], has_value ? old_value[i] : 0);
+    }
+
+    delete[] old_key;
+    delete[] old_value;
+}
+
+// returns the value stored with k, or the key slot itself for a set, NULL if k is absent
+uint64_t *ADDRESS_TABLE::find(uint64_t k)
+{
+    for (uint64_t s = slot(k); key[s] != ADDRESS_TABLE_EMPTY; s = (s + 1) & mask) {
+        if (key[s] == k)
+            return has_value ? &value[s] : &key[s];
+    }
+
+    return NULL;
+}
+
+// returns 1 if k was not in the table yet, otherwise only its value is updated
+uint8_t ADDRESS_TABLE::insert(uint64_t k, uint64_t v)
+{
+    #ifdef SANITY_CHECK
+    if (k == ADDRESS_TABLE_EMPTY)
+        assert(0);
+    #endif
+
+    // keep the load factor at or below 1/2
+    if (2*(occupancy+1) > size())
+        allocate(65 - shift);
+
+    uint64_t s = slot(k);
+    while (key[s] != ADDRESS_TABLE_EMPTY) {
+        if (key[s] == k) {
+            if (has_value)
+                value[s] = v;
+            return 0;
+        }
+        s = (s + 1) & mask;
+    }
+
+    key[s] = k;
+    if (has_value)
+        value[s] = v;
+    occupancy++;
+
+    return 1;
+}
+
+void ADDRESS_TABLE::erase(uint64_t k)
+{
+    uint64_t hole = slot(k);
+    while (key[hole] != k) {
+        if (key[hole] == ADDRESS_TABLE_EMPTY)
+            return;
+        hole = (hole + 1) & mask;
+    }
+
+    // shift back the entries whose probe sequence passes through the hole
+    for (uint64_t s = (hole + 1) & mask; key[s] != ADDRESS_TABLE_EMPTY; s = (s + 1) & mask) {
+        uint64_t home = slot(key[s]);
+        if (((s - home) & mask) >= ((s - hole) & mask)) {
+            key[hole] = key[s];
+            if (has_value)
+                value[hole] = value[s];
+            hole = s;
+        }
+    }
+
+    key[hole] = ADDRESS_TABLE_EMPTY;
+    occupancy--;
+}
+
+uint64_t PAGE_FRAMES::allocate(uint64_t vpage, uint64_t ppage)
+{
+    frame.push_back(PAGE_FRAME(vpage, ppage));
+
+    return frame.size() - 1;
+}
+
+// the first frame not referenced since the hand last passed it, amortized O(1) as every referenced bit it clears was set by a translation
+uint64_t PAGE_FRAMES::find_victim()
+{
+    #ifdef SANITY_CHECK
+    if (frame.size() == 0)
+        assert(0);
+    #endif
+
+    while (1) {
+        uint64_t victim = clock_hand;
+        clock_hand++;
+        if (clock_hand == frame.size())
+            clock_hand = 0;
+
+        if (frame[victim].referenced == 0)
+            return victim;
+
+        frame[victim].referenced = 0;
+    }
+}
+
+// called for every line the LLC receives from DRAM or fills from a writeback, which every cached line of a page went through
+void PAGE_FRAMES::mark_resident(uint64_t address)
+{
+    uint64_t *index = inverse_table.find(address >> (LOG2_PAGE_SIZE - LOG2_BLOCK_SIZE));
+    if (index)
+        frame[*index].resident |= 1ULL << (address & ((1 << (LOG2_PAGE_SIZE - LOG2_BLOCK_SIZE)) - 1));
+}
@@ -0,0 +1,514 @@
+#include "trace_reader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+void TRACE_READER::open(const char *name, uint32_t size, uint8_t use_thread)
+{
+    trace_string = name;
+    record_size = size;
+    threaded = use_thread;
+
+    // a path without an extension, or ending in '.', is a raw trace
+    size_t last_dot = trace_string.rfind('.'), last_slash = trace_string.rfind('/');
+    if ((last_dot != string::npos) && (last_slash != string::npos) && (last_dot < last_slash))
+        last_dot = string::npos;
+    char extension = ((last_dot == string::npos) || (last_dot + 1 == trace_string.size())) ? 0 : trace_string[last_dot + 1];
+    const char *decomp_program = NULL;
+    if (extension == 'g') { // gzip format
+        format = TRACE_FORMAT_GZIP;
+        decomp_program = "gzip";
+    }
+    else if (extension == 'x') { // xz
+        format = TRACE_FORMAT_XZ;
+        decomp_program = "xz";
+    }
+    else // anything else is taken to be an already decompressed trace
+        format = TRACE_FORMAT_RAW;
+
+    // remote traces are streamed through wget and decompressed out of process
+    if (trace_string.substr(0, 4) == "http") {
+        if (format == TRACE_FORMAT_RAW) {
+            cout << "ChampSim does not support remote traces other than gz or xz compression!" << endl;
+            assert(0);
+        }
+        format = TRACE_FORMAT_PIPE;
+        sprintf(pipe_command, "wget -qO- %s | %s -dc", name, decomp_program);
+    }
+
+    if (format == TRACE_FORMAT_RAW) {
+        map_trace();
+
+        if ((map_size >= COMPACT_TRACE_HEADER_SIZE) && (memcmp(map_begin, COMPACT_TRACE_MAGIC, 8) == 0)) {
+            uint32_t compact_record_size;
+            memcpy(&compact_record_size, map_begin + 8, sizeof(compact_record_size));
+            if (compact_record_size != record_size) {
+                cerr << endl << "*** COMPACT TRACE " << trace_string << " HOLDS " << compact_record_size;
+                cerr << "B RECORDS BUT " << record_size << "B ARE EXPECTED, CHECK -cloudsuite ***" << endl;
+                assert(0);
+            }
+            format = TRACE_FORMAT_COMPACT;
+        }
+        else {
+            // no decoding to do, so neither the ring nor the decoder thread is needed
+            if (map_size < record_size) {
+                cerr << endl << "*** TRACE FILE HAS NO COMPLETE RECORD: " << trace_string << " ***" << endl;
+                assert(0);
+            }
+            map_end = map_begin + (map_size / record_size) * record_size; // a trailing partial record is ignored
+            threaded = 0;
+            return;
+        }
+    }
+
+    for (uint32_t i=0; i<TRACE_RING_BATCHES; i++)
+        ring[i].data = new char[TRACE_BATCH_RECORDS*record_size];
+
+    open_stream();
+
+    if (threaded)
+        decoder = thread(&TRACE_READER::decoder_loop, this);
+}
+
+void TRACE_READER::close()
+{
+    if (decoder.joinable()) {
+        {
+            lock_guard<mutex> lock(ring_lock);
+            stop_decoder = 1;
+        }
+        ring_not_full.notify_one();
+        decoder.join();
+    }
+
+    close_stream();
+    unmap_trace();
+
+    for (uint32_t i=0; i<TRACE_RING_BATCHES; i++) {
+        delete[] ring[i].data;
+        ring[i].data = NULL;
+    }
+
+    delete[] xz_input;
+    xz_input = NULL;
+}
+
+void TRACE_READER::open_stream()
+{
+    if (format == TRACE_FORMAT_GZIP) {
+        gz_file = gzopen(trace_string.c_str(), "rb");
+        if (gz_file == NULL) {
+            cerr << endl << "*** CANNOT OPEN TRACE FILE: " << trace_string << " ***" << endl;
+            assert(0);
+        }
+        gzbuffer(gz_file, 1<<17);
+    }
+    else if (format == TRACE_FORMAT_XZ) {
+        raw_file = fopen(trace_string.c_str(), "rb");
+        if (raw_file == NULL) {
+            cerr << endl << "*** CANNOT OPEN TRACE FILE: " << trace_string << " ***" << endl;
+            assert(0);
+        }
+
+        if (xz_input == NULL)
+            xz_input = new uint8_t[TRACE_XZ_INPUT_SIZE];
+
+        lzma_stream init = LZMA_STREAM_INIT;
+        xz_stream = init;
+        if (lzma_stream_decoder(&xz_stream, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK) {
+            cerr << endl << "*** CANNOT INITIALIZE XZ DECODER: " << trace_string << " ***" << endl;
+            assert(0);
+        }
+        xz_done = 0;
+    }
+    else if (format == TRACE_FORMAT_COMPACT) {
+        map_cursor = map_begin + COMPACT_TRACE_HEADER_SIZE;
+        compact_state.reset();
+    }
+    else {
+        raw_file = popen(pipe_command, "r");
+        if (raw_file == NULL) {
+            cerr << endl << "*** CANNOT OPEN TRACE FILE: " << trace_string << " ***" << endl;
+            assert(0);
+        }
+    }
+}
+
+void TRACE_READER::close_stream()
+{
+    if (gz_file) {
+        gzclose(gz_file);
+        gz_file = NULL;
+    }
+
+    if (raw_file) {
+        if (format == TRACE_FORMAT_PIPE)
+            pclose(raw_file);
+        else {
+            lzma_end(&xz_stream);
+            fclose(raw_file);
+        }
+        raw_file = NULL;
+    }
+}
+
+void TRACE_READER::map_trace()
+{
+    int fd = ::open(trace_string.c_str(), O_RDONLY);
+    if (fd < 0) {
+        cerr << endl << "*** CANNOT OPEN TRACE FILE: " << trace_string << " ***" << endl;
+        assert(0);
+    }
+
+    struct stat trace_stat;
+    if (fstat(fd, &trace_stat) < 0) {
+        ::close(fd);
+        cerr << endl << "*** CANNOT OPEN TRACE FILE: " << trace_string << " ***" << endl;
+        assert(0);
+    }
+    map_size = trace_stat.st_size;
+    if (map_size == 0) {
+        cerr << endl << "*** TRACE FILE IS EMPTY: " << trace_string << " ***" << endl;
+        assert(0);
+    }
+
+    // a shared read-only mapping lets parallel runs of the same trace share the page cache
+    void *addr = mmap(NULL, map_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        cerr << endl << "*** CANNOT MAP TRACE FILE: " << trace_string << " ***" << endl;
+        assert(0);
+    }
+
+    // hints only, failures are harmless
+    madvise(addr, map_size, MADV_SEQUENTIAL);
+    madvise(addr, map_size, MADV_WILLNEED);
+#ifdef MADV_HUGEPAGE
+    madvise(addr, map_size, MADV_HUGEPAGE);
+#endif
+
+    map_begin = (char *)addr;
+    map_cursor = map_begin;
+    map_end = map_begin + map_size;
+}
+
+void TRACE_READER::unmap_trace()
+{
+    if (map_begin) {
+        munmap(map_begin, map_size);
+        map_begin = NULL;
+        map_end = NULL;
+        map_cursor = NULL;
+        map_size = 0;
+    }
+}
+
+size_t TRACE_READER::read_stream(char *dst, size_t bytes)
+{
+    size_t total = 0;
+
+    if (format == TRACE_FORMAT_GZIP) {
+        while (total < bytes) {
+            int ret = gzread(gz_file, dst + total, bytes - total);
+            if (ret < 0) {
+                int errnum;
+                cerr << endl << "*** GZIP ERROR: " << gzerror(gz_file, &errnum) << " in " << trace_string << " ***" << endl;
+                assert(0);
+            }
+            if (ret == 0)
+                break;
+            total += ret;
+        }
+    }
+    else if (format == TRACE_FORMAT_XZ) {
+        xz_stream.next_out = (uint8_t *)dst;
+        xz_stream.avail_out = bytes;
+
+        while (xz_stream.avail_out && !xz_done) {
+            if ((xz_stream.avail_in == 0) && !feof(raw_file)) {
+                xz_stream.next_in = xz_input;
+                xz_stream.avail_in = fread(xz_input, 1, TRACE_XZ_INPUT_SIZE, raw_file);
+            }
+
+            lzma_ret ret = lzma_code(&xz_stream, feof(raw_file) ? LZMA_FINISH : LZMA_RUN);
+            if (ret == LZMA_STREAM_END)
+                xz_done = 1;
+            else if (ret != LZMA_OK) {
+                cerr << endl << "*** XZ ERROR: " << ret << " in " << trace_string << " ***" << endl;
+                assert(0);
+            }
+        }
+
+        total = bytes - xz_stream.avail_out;
+    }
+    else if (format == TRACE_FORMAT_COMPACT)
+        total = read_compact(dst, bytes);
+    else {
+        while (total < bytes) {
+            size_t ret = fread(dst + total, 1, bytes - total, raw_file);
+            if (ret == 0)
+                break;
+            total += ret;
+        }
+    }
+
+    return total;
+}
+
+size_t TRACE_READER::read_compact(char *dst, size_t bytes)
+{
+    const uint8_t *p = (const uint8_t *)map_cursor, *end = (const uint8_t *)map_end;
+    size_t total = 0;
+
+    while ((total + record_size <= bytes) && (p != end)) {
+        if (record_size == sizeof(cloudsuite_instr))
+            p = decode_compact_record(p, end, (cloudsuite_instr *)(dst + total), &compact_state);
+        else
+            p = decode_compact_record(p, end, (input_instr *)(dst + total), &compact_state);
+
+        if (p == NULL) {
+            cerr << endl << "*** TRUNCATED COMPACT TRACE RECORD IN " << trace_string << " ***" << endl;
+            assert(0);
+        }
+        total += record_size;
+    }
+    map_cursor = (char *)p;
+
+    return total;
+}
+
+void TRACE_READER::decode_batch(TRACE_BATCH *batch)
+{
+    batch->count = read_stream(batch->data, TRACE_BATCH_RECORDS*record_size) / record_size;
+    batch->eof = (batch->count < TRACE_BATCH_RECORDS);
+
+    // rewind right away so that the next pass is decoded ahead as well
+    if (batch->eof) {
+        close_stream();
+        open_stream();
+    }
+}
+
+void TRACE_READER::decoder_loop()
+{
+    unique_lock<mutex> lock(ring_lock);
+    while (1) {
+        ring_not_full.wait(lock, [this] { return stop_decoder || (ring_occupancy < TRACE_RING_BATCHES); });
+        if (stop_decoder)
+            return;
+
+        TRACE_BATCH *batch = &ring[ring_tail];
+        lock.unlock();
+        decode_batch(batch);
+        lock.lock();
+
+        ring_tail++;
+        if (ring_tail == TRACE_RING_BATCHES)
+            ring_tail = 0;
+        ring_occupancy++;
+        ring_not_empty.notify_one();
+    }
+}
+
+void TRACE_READER::acquire_batch()
+{
+    if (threaded) {
+        unique_lock<mutex> lock(ring_lock);
+        ring_not_empty.wait(lock, [this] { return ring_occupancy > 0; });
+    }
+    else {
+        decode_batch(&ring[ring_tail]);
+
+        ring_tail++;
+        if (ring_tail == TRACE_RING_BATCHES)
+            ring_tail = 0;
+        ring_occupancy++;
+    }
+
+    current = &ring[ring_head];
+    read_index = 0;
+}
+
+void TRACE_READER::release_batch()
+{
+    current = NULL;
+
+    {
+        lock_guard<mutex> lock(ring_lock);
+        ring_head++;
+        if (ring_head == TRACE_RING_BATCHES)
+            ring_head = 0;
+        ring_occupancy--;
+    }
+
+    if (threaded)
+        ring_not_full.notify_one();
+}
+
+const char *TRACE_READER::next_record()
+{
+    if (format == TRACE_FORMAT_RAW) {
+        if (map_cursor == map_end) {
+            // start the next pass over the trace
+            map_cursor = map_begin;
+            return NULL;
+        }
+
+        const char *record = map_cursor;
+        map_cursor += record_size;
+
+        return record;
+    }
+
+    while ((current == NULL) || (read_index == current->count)) {
+        if (current) {
+            // this batch is drained, report the end of the pass if it was the last one
+            uint32_t eof = current->eof;
+            release_batch();
+            if (eof)
+                return NULL;
+        }
+        else
+            acquire_batch();
+    }
+
+    const char *record = current->data + (size_t)read_index*record_size;
+    read_index++;
+
+    return record;
+}
+
+int TRACE_READER::read(void *dst)
+{
+    const char *record = next_record();
+    if (record == NULL)
+        return 0;
+
+    memcpy(dst, record, record_size);
+
+    return 1;
+}
+
+void DECODED_TRACE_CACHE::initialize(uint32_t cpu_num, uint64_t size_mb)
+{
+    cpu = cpu_num;
+    capacity = (size_mb << 20) / sizeof(DECODED_INSTR);
+    if (capacity == 0)
+        return;
+
+    // untouched pages of the arena are never backed, so a generous limit costs nothing
+    begin = (DECODED_INSTR *)malloc(capacity * sizeof(DECODED_INSTR));
+    if (begin == NULL) {
+        cerr << "[DECODED_TRACE_CACHE] cannot allocate " << size_mb << " MB" << endl;
+        assert(0);
+    }
+    recording = 1;
+}
+
+void DECODED_TRACE_CACHE::abandon()
+{
+    cout << "*** Decoded instruction cache of Core: " << cpu << " is full (" << num_instr << " instructions), trace is decoded on every pass" << endl;
+
+    free(begin);
+    begin = NULL;
+    num_instr = 0;
+    recording = 0;
+}
+
+void DECODED_TRACE_CACHE::record(const ooo_model_instr *arch_instr)
+{
+    if (recording == 0)
+        return;
+
+    if (num_instr == capacity) {
+        abandon();
+        return;
+    }
+
+    DECODED_INSTR *decoded = &begin[num_instr++];
+    decoded->ip = arch_instr->ip;
+    decoded->branch_target = arch_instr->branch_target;
+    for (uint32_t i=0; i<NUM_INSTR_DESTINATIONS_SPARC; i++) {
+        decoded->destination_memory[i] = arch_instr->destination_memory[i];
+        decoded->destination_registers[i] = arch_instr->destination_registers[i];
+    }
+    for (uint32_t i=0; i<NUM_INSTR_SOURCES; i++) {
+        decoded->source_memory[i] = arch_instr->source_memory[i];
+        decoded->source_registers[i] = arch_instr->source_registers[i];
+    }
+    decoded->asid[0] = arch_instr->asid[0];
+    decoded->asid[1] = arch_instr->asid[1];
+    decoded->is_branch = arch_instr->is_branch;
+    decoded->branch_taken = arch_instr->branch_taken;
+    decoded->branch_type = arch_instr->branch_type;
+    decoded->num_reg_ops = arch_instr->num_reg_ops;
+    decoded->num_mem_ops = arch_instr->num_mem_ops;
+}
+
+int DECODED_TRACE_CACHE::end_pass(const ooo_model_instr *wrap_instr, uint8_t has_wrap)
+{
+    if (recording == 0)
+        return 0;
+
+    // the instruction decoded at the pass boundary opens every replayed pass
+    pass_start = 0;
+    if (has_wrap) {
+        record(wrap_instr);
+        if (recording == 0)
+            return 0;
+        pass_start = num_instr - 1;
+    }
+
+    if (num_instr == 0) {
+        recording = 0;
+        return 0;
+    }
+
+    cout << "*** Core: " << cpu << " replays its trace from the decoded instruction cache (" << num_instr << " instructions, ";
+    cout << ((num_instr * sizeof(DECODED_INSTR)) >> 20) << " MB)" << endl;
+
+    recording = 0;
+    replaying = 1;
+    replay_index = pass_start;
+    num_replayed = 0;
+
+    return 1;
+}
+
+int DECODED_TRACE_CACHE::replay(ooo_model_instr *arch_instr)
+{
+    if (num_replayed == num_instr) {
+        num_replayed = 0;
+        return 0;
+    }
+
+    const DECODED_INSTR *decoded = &begin[replay_index];
+    replay_index++;
+    if (replay_index == num_instr)
+        replay_index = 0;
+    num_replayed++;
+
+    arch_instr->ip = decoded->ip;
+    arch_instr->branch_target = decoded->branch_target;
+    for (uint32_t i=0; i<NUM_INSTR_DESTINATIONS_SPARC; i++) {
+        arch_instr->destination_memory[i] = decoded->destination_memory[i];
+        arch_instr->destination_virtual_address[i] = decoded->destination_memory[i];
+        arch_instr->destination_registers[i] = decoded->destination_registers[i];
+    }
+    for (uint32_t i=0; i<NUM_INSTR_SOURCES; i++) {
+        arch_instr->source_memory[i] = decoded->source_memory[i];
+        arch_instr->source_virtual_address[i] = decoded->source_memory[i];
+        arch_instr->source_registers[i] = decoded->source_registers[i];
+    }
+    arch_instr->asid[0] = decoded->asid[0];
+    arch_instr->asid[1] = decoded->asid[1];
+    arch_instr->is_branch = decoded->is_branch;
+    arch_instr->branch_taken = decoded->branch_taken;
+    arch_instr->branch_type = decoded->branch_type;
+    arch_instr->num_reg_ops = decoded->num_reg_ops;
+    arch_instr->num_mem_ops = decoded->num_mem_ops;
+    arch_instr->is_memory = (decoded->num_mem_ops > 0);
+
+    return 1;
+}
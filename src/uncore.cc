@@ -7,3 +7,87 @@ UNCORE uncore;
 UNCORE::UNCORE() {
 
 }
+
+int UNCORE_PORT::buffer(uint8_t type, PACKET *packet)
+{
+    PORT_REQUEST request;
+    request.type = type;
+    request.cycle = current_core_cycle[cpu];
+    request.packet = *packet;
+
+    pending.push_back(request);
+    num_pending[type]++;
+
+    return -1;
+}
+
+int UNCORE_PORT::add_rq(PACKET *packet)
+{
+    return buffer(1, packet);
+}
+
+int UNCORE_PORT::add_wq(PACKET *packet)
+{
+    return buffer(2, packet);
+}
+
+int UNCORE_PORT::add_pq(PACKET *packet)
+{
+    return buffer(3, packet);
+}
+
+void UNCORE_PORT::increment_WQ_FULL(uint64_t address)
+{
+    PACKET packet;
+    packet.address = address;
+    buffer(PORT_WQ_FULL, &packet);
+}
+
+void UNCORE_PORT::return_data(PACKET *packet)
+{
+    // the LLC returns data straight to the L2C
+    cerr << "[UNCORE_PORT] " << __func__ << " is not expected to be called" << endl;
+    assert(0);
+}
+
+void UNCORE_PORT::operate()
+{
+
+}
+
+uint32_t UNCORE_PORT::get_occupancy(uint8_t queue_type, uint64_t address)
+{
+    if (queue_type < PORT_WQ_FULL)
+        return target->get_occupancy(queue_type, address) + num_pending[queue_type];
+
+    return 0;
+}
+
+uint32_t UNCORE_PORT::get_size(uint8_t queue_type, uint64_t address)
+{
+    return target->get_size(queue_type, address);
+}
+
+// hand every request issued up to cycle to the LLC, in issue order
+// a request that finds its queue full (other cores filled it in the meantime) is retried on the next cycle
+void UNCORE_PORT::drain(uint64_t cycle)
+{
+    while (pending.size() && (pending.front().cycle <= cycle)) {
+        PORT_REQUEST *request = &pending.front();
+        PACKET *packet = &request->packet;
+
+        if (request->type == PORT_WQ_FULL)
+            target->increment_WQ_FULL(packet->address);
+        else if (target->get_occupancy(request->type, packet->address) >= target->get_size(request->type, packet->address))
+            break;
+        else if (request->type == 1)
+            target->add_rq(packet);
+        else if (request->type == 2)
+            target->add_wq(packet);
+        else
+            target->add_pq(packet);
+
+        num_pending[request->type]--;
+        pending.pop_front();
+    }
+}